@@ -0,0 +1,194 @@
+/*
+ *  This file is part of rmlint.
+ *
+ *  rmlint is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  rmlint is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with rmlint.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *
+ *  - Christopher <sahib> Pahl 2010-2020 (https://github.com/sahib)
+ *  - Daniel <SeeSpotRun> T.   2014-2020 (https://github.com/SeeSpotRun)
+ *
+ * Hosted on http://github.com/sahib/rmlint
+ *
+ */
+
+#include <string.h>
+
+#include "arena.h"
+
+/* what malloc() guarantees anyway; enough for every struct we keep here */
+#define RM_ARENA_ALIGN (16)
+#define RM_ARENA_SLAB_SIZE (256 * 1024)
+
+/* objects moved between a thread's cache and the arena per lock */
+#define RM_ARENA_BATCH (64)
+
+#define RM_ARENA_ROUND(size) \
+    (((size) + RM_ARENA_ALIGN - 1) / RM_ARENA_ALIGN * RM_ARENA_ALIGN)
+
+/* each slab starts with the link to the previous one */
+#define RM_ARENA_SLAB_HEADER RM_ARENA_ROUND(sizeof(gpointer))
+
+/* free objects one thread holds back for one arena */
+typedef struct RmArenaCache {
+    /* RmArena.id, never reused, so caches of cleared arenas are never matched */
+    guint arena_id;
+
+    /* linked through their first bytes, like RmArena.idle */
+    gpointer idle;
+    guint n_idle;
+
+    struct RmArenaCache *next;
+} RmArenaCache;
+
+static void rm_arena_cache_list_free(RmArenaCache *cache) {
+    /* objects still cached belong to slabs and go with rm_arena_clear() */
+    while(cache) {
+        RmArenaCache *next = cache->next;
+        g_slice_free(RmArenaCache, cache);
+        cache = next;
+    }
+}
+
+static GPrivate rm_arena_cache_key =
+    G_PRIVATE_INIT((GDestroyNotify)rm_arena_cache_list_free);
+
+static gint rm_arena_last_id = 0;
+
+static RmArenaCache *rm_arena_cache_get(RmArena *arena) {
+    RmArenaCache *head = g_private_get(&rm_arena_cache_key);
+    for(RmArenaCache *cache = head; cache; cache = cache->next) {
+        if(cache->arena_id == arena->id) {
+            return cache;
+        }
+    }
+
+    RmArenaCache *cache = g_slice_new0(RmArenaCache);
+    cache->arena_id = arena->id;
+    cache->next = head;
+    g_private_set(&rm_arena_cache_key, cache);
+    return cache;
+}
+
+void rm_arena_init(RmArena *arena, gsize block_size) {
+    memset(arena, 0, sizeof(RmArena));
+    g_mutex_init(&arena->lock);
+    arena->id = g_atomic_int_add(&rm_arena_last_id, 1) + 1;
+    arena->block_size = RM_ARENA_ROUND(MAX(block_size, sizeof(gpointer)));
+}
+
+/* move up to RM_ARENA_BATCH objects from the arena into cache */
+static void rm_arena_refill(RmArena *arena, RmArenaCache *cache) {
+    g_mutex_lock(&arena->lock);
+    {
+        while(arena->idle && cache->n_idle < RM_ARENA_BATCH) {
+            gpointer block = arena->idle;
+            arena->idle = *(gpointer *)block;
+            *(gpointer *)block = cache->idle;
+            cache->idle = block;
+            cache->n_idle++;
+        }
+
+        while(cache->n_idle < RM_ARENA_BATCH) {
+            if(arena->slab_left < arena->block_size) {
+                gsize slab_size =
+                    MAX(RM_ARENA_SLAB_SIZE, RM_ARENA_SLAB_HEADER + arena->block_size);
+                guint8 *slab = g_malloc(slab_size);
+                *(gpointer *)slab = arena->slabs;
+                arena->slabs = slab;
+
+                /* the rest of the previous slab is wasted */
+                arena->slab = slab + RM_ARENA_SLAB_HEADER;
+                arena->slab_left = slab_size - RM_ARENA_SLAB_HEADER;
+                arena->n_slabs++;
+                arena->slab_bytes += slab_size;
+            }
+            gpointer block = arena->slab;
+            arena->slab += arena->block_size;
+            arena->slab_left -= arena->block_size;
+            arena->n_blocks++;
+
+            *(gpointer *)block = cache->idle;
+            cache->idle = block;
+            cache->n_idle++;
+        }
+    }
+    g_mutex_unlock(&arena->lock);
+}
+
+/* hand RM_ARENA_BATCH objects of an overfull cache back to the arena */
+static void rm_arena_drain(RmArena *arena, RmArenaCache *cache) {
+    gpointer first = cache->idle;
+    gpointer last = first;
+    for(guint i = 1; i < RM_ARENA_BATCH; i++) {
+        last = *(gpointer *)last;
+    }
+    cache->idle = *(gpointer *)last;
+    cache->n_idle -= RM_ARENA_BATCH;
+
+    g_mutex_lock(&arena->lock);
+    {
+        *(gpointer *)last = arena->idle;
+        arena->idle = first;
+    }
+    g_mutex_unlock(&arena->lock);
+}
+
+gpointer rm_arena_alloc0(RmArena *arena) {
+    RmArenaCache *cache = rm_arena_cache_get(arena);
+    if(cache->n_idle == 0) {
+        rm_arena_refill(arena, cache);
+    }
+
+    gpointer block = cache->idle;
+    cache->idle = *(gpointer *)block;
+    cache->n_idle--;
+
+    memset(block, 0, arena->block_size);
+    return block;
+}
+
+void rm_arena_free(RmArena *arena, gpointer block) {
+    RmArenaCache *cache = rm_arena_cache_get(arena);
+    *(gpointer *)block = cache->idle;
+    cache->idle = block;
+    cache->n_idle++;
+
+    if(cache->n_idle >= 2 * RM_ARENA_BATCH) {
+        rm_arena_drain(arena, cache);
+    }
+}
+
+void rm_arena_clear(RmArena *arena) {
+    while(arena->slabs) {
+        gpointer slab = arena->slabs;
+        arena->slabs = *(gpointer *)slab;
+        g_free(slab);
+    }
+    arena->idle = NULL;
+    arena->slab = NULL;
+    arena->slab_left = 0;
+
+    g_mutex_clear(&arena->lock);
+}
+
+void rm_arena_stats(RmArena *arena, RmArenaStats *stats) {
+    g_mutex_lock(&arena->lock);
+    {
+        stats->n_blocks = arena->n_blocks;
+        stats->n_slabs = arena->n_slabs;
+        stats->slab_bytes = arena->slab_bytes;
+    }
+    g_mutex_unlock(&arena->lock);
+}
@@ -0,0 +1,119 @@
+/*
+ *  This file is part of rmlint.
+ *
+ *  rmlint is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  rmlint is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with rmlint.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *
+ *  - Christopher <sahib> Pahl 2010-2020 (https://github.com/sahib)
+ *  - Daniel <SeeSpotRun> T.   2014-2020 (https://github.com/SeeSpotRun)
+ *
+ * Hosted on http://github.com/sahib/rmlint
+ *
+ */
+
+#ifndef RM_ARENA_H
+#define RM_ARENA_H
+
+#include <glib.h>
+#include "config.h"
+
+/**
+ * @file arena.h
+ * @brief Arena for many small objects of one size.
+ *
+ * Objects are carved out of large slabs; freed objects go to an idle list
+ * and are handed out again by the next rm_arena_alloc0().  All slabs are
+ * given back in one go by rm_arena_clear(), which also invalidates every
+ * object that was not freed yet.  That makes tearing down millions of
+ * RmFiles at exit a matter of a few free() calls.
+ *
+ * The arena is safe to share between threads.  Each thread keeps a small
+ * cache of free objects per arena, so the lock is only taken to move a
+ * batch of objects between that cache and the arena.  Objects cached by a
+ * thread that exits are not reused, but are released by rm_arena_clear().
+ *
+ * Typical workflow:
+ *
+ *     RmArena arena;
+ *     rm_arena_init(&arena, sizeof(RmFile));
+ *     RmFile *file = rm_arena_alloc0(&arena);
+ *     ...
+ *     rm_arena_free(&arena, file);
+ *     ...
+ *     rm_arena_clear(&arena);
+ **/
+
+typedef struct RmArena {
+    GMutex lock;
+
+    /* identifies the arena in per-thread caches */
+    guint id;
+
+    /* size of each object, rounded up to a multiple of the alignment */
+    gsize block_size;
+
+    /* freed objects, linked through their first bytes */
+    gpointer idle;
+
+    /* all slabs, linked through their first bytes */
+    gpointer slabs;
+
+    /* unused rest of the newest slab */
+    guint8 *slab;
+    gsize slab_left;
+
+    /* statistics for rm_arena_stats() */
+    guint64 n_blocks;
+    guint64 n_slabs;
+    guint64 slab_bytes;
+} RmArena;
+
+typedef struct RmArenaStats {
+    /* objects carved out of slabs so far; reused objects are not counted */
+    guint64 n_blocks;
+
+    /* heap allocations the arena made instead, and their size */
+    guint64 n_slabs;
+    guint64 slab_bytes;
+} RmArenaStats;
+
+/**
+ * @brief Set up an empty arena handing out objects of block_size bytes.
+ **/
+void rm_arena_init(RmArena *arena, gsize block_size);
+
+/**
+ * @brief Hand out a zeroed object.
+ **/
+gpointer rm_arena_alloc0(RmArena *arena);
+
+/**
+ * @brief Give an object back for reuse by later allocations.
+ **/
+void rm_arena_free(RmArena *arena, gpointer block);
+
+/**
+ * @brief Free all slabs; objects still in use become invalid.
+ *
+ * The arena needs rm_arena_init() before it can be used again.
+ **/
+void rm_arena_clear(RmArena *arena);
+
+/**
+ * @brief Get statistics about an arena.
+ **/
+void rm_arena_stats(RmArena *arena, RmArenaStats *stats);
+
+#endif /* end of include guard */
@@ -154,6 +154,10 @@ typedef struct RmCfg {
     /* total number of bytes we are allowed to use (target only) */
     RmOff total_mem;
 
+    /* if set, paranoid digests keep their data in a scratch file in this
+     * directory instead of in memory */
+    char *paranoid_spill_dir;
+
     /* length of read buffers */
     RmOff read_buf_len;
 
@@ -188,6 +192,31 @@ typedef struct RmCfg {
     /* don't use sse accelerations */
     bool no_sse;
 
+    /* compare the files of each duplicate group byte by byte once it is found */
+    gboolean verify;
+
+    /* don't read via io_uring even if the kernel supports it */
+    bool no_io_uring;
+
+    /* read with O_DIRECT (or drop read data) to keep the page cache clean */
+    bool use_direct_io;
+
+    /* mmap() files at least this big instead of reading them; 0 to disable */
+    RmOff mmap_threshold;
+
+    /* hash this many pages spread over each large file before reading it
+     * in order; less than 2 to disable */
+    gint sample_pages;
+
+    /* treat files whose extent maps are identical (reflinks) like hardlinks,
+     * so that only one of them is read */
+    gboolean cluster_reflinks;
+
+    /* stop reading files this many seconds after startup or after reading
+     * this many bytes, and output what was found so far; 0 for no limit */
+    gdouble time_budget;
+    RmOff read_budget;
+
 } RmCfg;
 
 /**
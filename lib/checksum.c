@@ -31,9 +31,11 @@
 
 #include <glib.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <fcntl.h>
+#include <signal.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -41,18 +43,22 @@
 #include "checksum.h"
 
 #include "checksums/blake2/blake2.h"
+#include "checksums/blockcmp.h"
 #include "checksums/highwayhash.h"
 #include "checksums/metrohash.h"
 #include "checksums/murmur3.h"
+#include "checksums/sha/sha.h"
 #include "checksums/sha3/sha3.h"
+#include "checksums/simd.h"
+/* the pools below need the size of the xxHash states */
+#define XXH_STATIC_LINKING_ONLY
+#include "checksums/xxhash/xxh3_dispatch.h"
 #include "checksums/xxhash/xxhash.h"
 
 #include "utilities.h"
 
 #define _RM_CHECKSUM_DEBUG 0
 
-static int RM_DIGEST_USE_SSE = 0;
-
 //////////////////////////////////
 //    BUFFER IMPLEMENTATION     //
 //////////////////////////////////
@@ -118,18 +124,471 @@ RmBuffer *rm_buffer_new(RmSemaphore *sem, gsize buf_size) {
     return self;
 }
 
+/* Max. number of unused data blocks kept around by a RmBufferPool */
+#define RM_BUFFER_POOL_MAX_IDLE (256)
+
+struct RmBufferPool {
+    gsize buf_size;
+    gsize alignment;
+
+    /* recycled data blocks */
+    GPtrArray *idle;
+    GMutex lock;
+
+    /* one for the owner plus one per buffer in use */
+    gint ref_count;
+};
+
+RmBufferPool *rm_buffer_pool_new(gsize buf_size, gsize alignment) {
+    g_assert(alignment >= sizeof(gpointer) && (alignment & (alignment - 1)) == 0);
+
+    RmBufferPool *self = g_slice_new0(RmBufferPool);
+    self->buf_size = buf_size;
+    self->alignment = alignment;
+    self->idle = g_ptr_array_new_with_free_func(free);
+    self->ref_count = 1;
+    g_mutex_init(&self->lock);
+    return self;
+}
+
+void rm_buffer_pool_unref(RmBufferPool *pool) {
+    if(!g_atomic_int_dec_and_test(&pool->ref_count)) {
+        return;
+    }
+
+    g_ptr_array_free(pool->idle, TRUE);
+    g_mutex_clear(&pool->lock);
+    g_slice_free(RmBufferPool, pool);
+}
+
+static unsigned char *rm_buffer_pool_take(RmBufferPool *pool) {
+    gpointer data = NULL;
+    g_mutex_lock(&pool->lock);
+    {
+        if(pool->idle->len > 0) {
+            data = g_ptr_array_remove_index_fast(pool->idle, pool->idle->len - 1);
+        }
+    }
+    g_mutex_unlock(&pool->lock);
+
+    if(data == NULL && posix_memalign(&data, pool->alignment, pool->buf_size) != 0) {
+        /* same as what g_slice_alloc() would do */
+        g_error("posix_memalign(%" G_GSIZE_FORMAT ") failed", pool->buf_size);
+    }
+
+    g_atomic_int_inc(&pool->ref_count);
+    return data;
+}
+
+static void rm_buffer_pool_give(RmBufferPool *pool, unsigned char *data) {
+    g_mutex_lock(&pool->lock);
+    {
+        if(pool->idle->len < RM_BUFFER_POOL_MAX_IDLE) {
+            g_ptr_array_add(pool->idle, data);
+            data = NULL;
+        }
+    }
+    g_mutex_unlock(&pool->lock);
+
+    free(data);
+    rm_buffer_pool_unref(pool);
+}
+
+RmBuffer *rm_buffer_new_from_pool(RmSemaphore *sem, RmBufferPool *pool) {
+    /* See the explanation in rm_buffer_new */
+    if(sem != NULL) {
+        rm_semaphore_acquire(sem);
+    }
+
+    RmBuffer *self = g_slice_new0(RmBuffer);
+    self->data = rm_buffer_pool_take(pool);
+    self->buf_size = pool->buf_size;
+    self->pool = pool;
+    return self;
+}
+
+struct RmBufferMapping {
+    /* set while the slot in rm_buffer_mappings is taken */
+    gint in_use;
+
+    gpointer addr;
+    gsize len;
+
+    /* one for the owner plus one per buffer */
+    gint ref_count;
+
+    /* the digest fed from the mapping; see rm_buffer_sigbus_handler() */
+    RmDigest *digest;
+};
+
+/* Mappings live in a static table rather than on the heap, so that the SIGBUS
+ * handler can look through them without ever touching freed memory */
+#define RM_BUFFER_MAX_MAPPINGS (256)
+
+static RmBufferMapping rm_buffer_mappings[RM_BUFFER_MAX_MAPPINGS];
+static gsize rm_buffer_page_size = 0;
+static struct sigaction rm_buffer_sigbus_default;
+
+/* A file that shrinks while it is mapped raises SIGBUS on access to the pages
+ * past its new end.  If that happens in one of our mappings, map zeros over
+ * the page (so that whichever thread is hashing it can carry on) and mark the
+ * digest as truncated.  Anything else gets the previous disposition. */
+static void rm_buffer_sigbus_handler(_UNUSED int signum, siginfo_t *info,
+                                     _UNUSED void *context) {
+    guint8 *addr = info->si_addr;
+    for(guint i = 0; i < RM_BUFFER_MAX_MAPPINGS; ++i) {
+        RmBufferMapping *mapping = &rm_buffer_mappings[i];
+        guint8 *start = __atomic_load_n(&mapping->addr, __ATOMIC_ACQUIRE);
+        if(!start || addr < start || addr >= start + mapping->len) {
+            continue;
+        }
+
+        guint8 *page = addr - (uintptr_t)addr % rm_buffer_page_size;
+        if(mmap(page, rm_buffer_page_size, PROT_READ,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) != MAP_FAILED) {
+            mapping->digest->truncated = TRUE;
+            return;
+        }
+        break;
+    }
+
+    /* not ours (or no fix possible); the access faults again and gets the
+     * previous disposition, i.e. usually a crash */
+    sigaction(SIGBUS, &rm_buffer_sigbus_default, NULL);
+}
+
+static gpointer rm_buffer_sigbus_install(_UNUSED gpointer data) {
+    rm_buffer_page_size = sysconf(_SC_PAGESIZE);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_SIGINFO;
+    sa.sa_sigaction = rm_buffer_sigbus_handler;
+    sigaction(SIGBUS, &sa, &rm_buffer_sigbus_default);
+    return NULL;
+}
+
+RmBufferMapping *rm_buffer_mapping_new(gpointer addr, gsize len, RmDigest *digest) {
+    static GOnce sigbus_once = G_ONCE_INIT;
+    g_once(&sigbus_once, rm_buffer_sigbus_install, NULL);
+
+    for(guint i = 0; i < RM_BUFFER_MAX_MAPPINGS; ++i) {
+        RmBufferMapping *self = &rm_buffer_mappings[i];
+        if(g_atomic_int_compare_and_exchange(&self->in_use, FALSE, TRUE)) {
+            self->len = len;
+            self->ref_count = 1;
+            self->digest = digest;
+            /* publishes the slot to rm_buffer_sigbus_handler() */
+            __atomic_store_n(&self->addr, addr, __ATOMIC_RELEASE);
+            return self;
+        }
+    }
+    return NULL;
+}
+
+void rm_buffer_mapping_unref(RmBufferMapping *mapping) {
+    if(!g_atomic_int_dec_and_test(&mapping->ref_count)) {
+        return;
+    }
+
+    /* withdraw from rm_buffer_sigbus_handler() before the range can be reused */
+    gpointer addr = mapping->addr;
+    __atomic_store_n(&mapping->addr, NULL, __ATOMIC_RELEASE);
+    if(munmap(addr, mapping->len) == -1) {
+        rm_log_perror("munmap failed");
+    }
+    g_atomic_int_set(&mapping->in_use, FALSE);
+}
+
+RmBuffer *rm_buffer_new_mapped(RmSemaphore *sem, RmBufferMapping *mapping, gsize offset,
+                               gsize len) {
+    g_assert(offset + len <= mapping->len);
+
+    /* See the explanation in rm_buffer_new; the data needs no memory but
+     * we still don't want to queue up unlimited work for the hashpipe */
+    if(sem != NULL) {
+        rm_semaphore_acquire(sem);
+    }
+
+    g_atomic_int_inc(&mapping->ref_count);
+
+    RmBuffer *self = g_slice_new0(RmBuffer);
+    self->data = (unsigned char *)mapping->addr + offset;
+    self->buf_size = len;
+    self->len = len;
+    self->mapping = mapping;
+    return self;
+}
+
+/* backs all buffers from rm_buffer_new_zeros(); never written, so its pages
+ * all map the kernel's zero page */
+static unsigned char rm_buffer_zero_block[RM_BUFFER_ZEROS_LEN];
+
+RmBuffer *rm_buffer_new_zeros(RmSemaphore *sem, gsize len) {
+    g_assert(len <= RM_BUFFER_ZEROS_LEN);
+
+    /* See the explanation in rm_buffer_new */
+    if(sem != NULL) {
+        rm_semaphore_acquire(sem);
+    }
+
+    RmBuffer *self = g_slice_new0(RmBuffer);
+    self->data = rm_buffer_zero_block;
+    self->buf_size = len;
+    self->len = len;
+    self->zeros = TRUE;
+    return self;
+}
+
+RmBuffer *rm_buffer_new_leaf(RmSemaphore *sem, RmDigestLeaf *leaf) {
+    /* See the explanation in rm_buffer_new; the placeholder counts as a buffer
+     * so that it can be freed like any other */
+    if(sem != NULL) {
+        rm_semaphore_acquire(sem);
+    }
+
+    RmBuffer *self = g_slice_new0(RmBuffer);
+    self->len = leaf->len;
+    self->leaf = leaf;
+    return self;
+}
+
+/* The spill file grows (and is mapped) in segments of this size */
+#define RM_SPILL_SEGMENT_SIZE (64 * 1024 * 1024)
+
+struct RmSpill {
+    /* unlinked scratch file */
+    int fd;
+
+    /* every slot holds one buffer; the slot size is taken from the first
+     * buffer, since all buffers of a run have the same size */
+    gsize slot_size;
+    gsize slots_per_segment;
+    gsize segment_size;
+
+    /* mmap()ed segments of the file, in order */
+    GPtrArray *segments;
+
+    /* released slots, for reuse */
+    GArray *idle;
+
+    /* slots that were ever handed out, and those currently in use */
+    guint64 n_slots;
+    guint64 n_used;
+
+    /* the file could not be grown any further */
+    gboolean full;
+
+    /* set by rm_digest_paranoid_spill_close(); the last slot frees the spill */
+    gboolean closed;
+
+    GMutex lock;
+};
+
+/* where paranoid digests spill their buffers to, if anywhere */
+static RmSpill *rm_spill = NULL;
+
+static void rm_spill_destroy(RmSpill *spill) {
+    for(guint i = 0; i < spill->segments->len; i++) {
+        if(munmap(g_ptr_array_index(spill->segments, i), spill->segment_size) == -1) {
+            rm_log_perror("munmap failed");
+        }
+    }
+    g_ptr_array_free(spill->segments, TRUE);
+    g_array_free(spill->idle, TRUE);
+    close(spill->fd);
+    g_mutex_clear(&spill->lock);
+    g_slice_free(RmSpill, spill);
+}
+
+/* map one more segment; spill->lock must be held */
+static gboolean rm_spill_grow(RmSpill *spill) {
+    off_t offset = (off_t)spill->segments->len * spill->segment_size;
+
+#if HAVE_POSIX_FALLOCATE
+    /* reserve the disk space now: running out of it while writing to the
+     * mapping would get us killed by SIGBUS */
+    int err = posix_fallocate(spill->fd, offset, spill->segment_size);
+    if(err != 0) {
+        rm_log_warning_line(_("Paranoid spill file is full, keeping data in memory: %s"),
+                            g_strerror(err));
+        return FALSE;
+    }
+#endif
+
+    gpointer addr = mmap(NULL, spill->segment_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                         spill->fd, offset);
+    if(addr == MAP_FAILED) {
+        rm_log_perror("mmap of paranoid spill file failed");
+        return FALSE;
+    }
+
+    g_ptr_array_add(spill->segments, addr);
+    return TRUE;
+}
+
+/* Take a free slot for a buffer of buf_size bytes; returns its data, or NULL
+ * if the buffer can't be spilled */
+static unsigned char *rm_spill_take(RmSpill *spill, gsize buf_size, guint64 *slot) {
+    unsigned char *data = NULL;
+    g_mutex_lock(&spill->lock);
+    {
+        if(spill->slot_size == 0) {
+            gsize page_size = sysconf(_SC_PAGESIZE);
+            spill->slot_size = buf_size;
+            spill->slots_per_segment = MAX(1, RM_SPILL_SEGMENT_SIZE / buf_size);
+            /* mmap() offsets must be page aligned */
+            spill->segment_size =
+                (spill->slots_per_segment * buf_size + page_size - 1) / page_size * page_size;
+        }
+
+        gboolean found = FALSE;
+        if(buf_size > spill->slot_size) {
+            /* does not fit */
+        } else if(spill->idle->len > 0) {
+            *slot = g_array_index(spill->idle, guint64, spill->idle->len - 1);
+            g_array_set_size(spill->idle, spill->idle->len - 1);
+            found = TRUE;
+        } else if(spill->n_slots == spill->segments->len * spill->slots_per_segment &&
+                  (spill->full || !rm_spill_grow(spill))) {
+            /* only warn once */
+            spill->full = TRUE;
+        } else {
+            *slot = spill->n_slots++;
+            found = TRUE;
+        }
+
+        if(found) {
+            unsigned char *segment =
+                g_ptr_array_index(spill->segments, *slot / spill->slots_per_segment);
+            data = segment + (*slot % spill->slots_per_segment) * spill->slot_size;
+            spill->n_used++;
+        }
+    }
+    g_mutex_unlock(&spill->lock);
+    return data;
+}
+
+static void rm_spill_give(RmSpill *spill, guint64 slot) {
+    gboolean destroy = FALSE;
+    g_mutex_lock(&spill->lock);
+    {
+        g_array_append_val(spill->idle, slot);
+        destroy = (--spill->n_used == 0 && spill->closed);
+    }
+    g_mutex_unlock(&spill->lock);
+
+    if(destroy) {
+        rm_spill_destroy(spill);
+    }
+}
+
+gboolean rm_digest_paranoid_spill_open(const char *dir) {
+    g_assert(rm_spill == NULL);
+
+#if HAVE_POSIX_FALLOCATE
+    char *path = g_build_filename(dir, ".rmlint-spill-XXXXXX", NULL);
+    int fd = g_mkstemp_full(path, O_RDWR, 0600);
+    if(fd == -1) {
+        rm_log_warning_line(_("Can't create paranoid spill file in %s: %s"), dir,
+                            g_strerror(errno));
+        g_free(path);
+        return FALSE;
+    }
+
+    /* nobody else needs to see it, and it should vanish when we do */
+    unlink(path);
+    g_free(path);
+
+    RmSpill *spill = g_slice_new0(RmSpill);
+    spill->fd = fd;
+    spill->segments = g_ptr_array_new();
+    spill->idle = g_array_new(FALSE, FALSE, sizeof(guint64));
+    g_mutex_init(&spill->lock);
+
+    g_atomic_pointer_set(&rm_spill, spill);
+    return TRUE;
+#else
+    rm_log_warning_line(_("Can't spill paranoid data to %s: not supported on this platform"),
+                        dir);
+    return FALSE;
+#endif
+}
+
+guint64 rm_digest_paranoid_spill_close(void) {
+    RmSpill *spill = g_atomic_pointer_get(&rm_spill);
+    if(spill == NULL) {
+        return 0;
+    }
+    g_atomic_pointer_set(&rm_spill, NULL);
+
+    guint64 size = 0;
+    gboolean destroy = FALSE;
+    g_mutex_lock(&spill->lock);
+    {
+        size = (guint64)spill->segments->len * spill->segment_size;
+        spill->closed = TRUE;
+        destroy = (spill->n_used == 0);
+    }
+    g_mutex_unlock(&spill->lock);
+
+    if(destroy) {
+        rm_spill_destroy(spill);
+    }
+    return size;
+}
+
+/* release the data of buf, but not buf itself */
+static void rm_buffer_free_data(RmBuffer *buf) {
+    if(buf->leaf || buf->zeros) {
+        /* no data of its own */
+    } else if(buf->spill) {
+        rm_spill_give(buf->spill, buf->spill_slot);
+    } else if(buf->mapping) {
+        rm_buffer_mapping_unref(buf->mapping);
+    } else if(buf->pool) {
+        rm_buffer_pool_give(buf->pool, buf->data);
+    } else {
+        g_slice_free1(buf->buf_size, buf->data);
+    }
+}
+
+/* Move the data of buf into a slot of spill; leaves buf as it is if the spill
+ * has no room for it */
+static void rm_buffer_spill(RmBuffer *buf, RmSpill *spill) {
+    if(buf->leaf || buf->spill || buf->mapping || buf->zeros) {
+        return;
+    }
+
+    guint64 slot = 0;
+    unsigned char *data = rm_spill_take(spill, buf->buf_size, &slot);
+    if(data == NULL) {
+        return;
+    }
+
+    memcpy(data, buf->data, buf->len);
+    rm_buffer_free_data(buf);
+
+    buf->data = data;
+    buf->pool = NULL;
+    buf->spill = spill;
+    buf->spill_slot = slot;
+}
+
 void rm_buffer_free(RmSemaphore *sem, RmBuffer *buf) {
     /*  See the explanation in rm_buffer_new */
     if(sem != NULL) {
         rm_semaphore_release(sem);
     }
 
-    g_slice_free1(buf->buf_size, buf->data);
+    rm_buffer_free_data(buf);
     g_slice_free(RmBuffer, buf);
 }
 
 static gboolean rm_buffer_equal(RmBuffer *a, RmBuffer *b) {
-    return (a->len == b->len && memcmp(a->data, b->data, a->len) == 0);
+    /* same data happens for zeros (see rm_buffer_new_zeros()) */
+    return (a->len == b->len && (a->data == b->data || memcmp(a->data, b->data, a->len) == 0));
 }
 
 ///////////////////////////////////////
@@ -143,6 +602,8 @@ typedef void (*RmDigestUpdateFunc)(gpointer state, const unsigned char *data, si
 typedef gpointer (*RmDigestCopyFunc)(gpointer state);
 typedef void (*RmDigestStealFunc)(gpointer state, guint8 *result);
 typedef guint (*RmDigestLenFunc)(gpointer state);
+typedef const char *(*RmDigestKernelFunc)(void);
+typedef void (*RmDigestInitFunc)(gpointer state);
 
 typedef struct RmDigestInterface {
     const char *name;           // hash name
@@ -150,25 +611,20 @@ typedef struct RmDigestInterface {
     RmDigestLenFunc len;        // return length of the output checksum in bytes
     RmDigestNewFunc new;        // returns new digest->state
     RmDigestFreeFunc free;      // frees state allocated by new()
+    gsize state_size;           // if set, state is flat and kept inline (instead of new/free/copy)
+    RmDigestInitFunc init;      // initialises an inline state
     RmDigestUpdateFunc update;  // hashes data into state
     RmDigestCopyFunc copy;      // allocates and returns a copy of passed state
     RmDigestStealFunc steal;    // writes checksum (as binary) to *result
+    RmDigestKernelFunc kernel;  // name of the SIMD kernel in use (NULL: portable only)
 } RmDigestInterface;
 
 ///////////////////////////
 //   xxhash interface    //
 ///////////////////////////
 
-static XXH64_state_t *rm_digest_xxhash_new(void) {
-    XXH64_state_t *state = XXH64_createState();
+static void rm_digest_xxhash_init(XXH64_state_t *state) {
     XXH64_reset(state, 0);
-    return state;
-}
-
-static XXH64_state_t *rm_digest_xxhash_copy(XXH64_state_t *state) {
-    XXH64_state_t *copy = XXH64_createState();
-    memcpy(copy, state, sizeof(XXH64_state_t));
-    return copy;
 }
 
 static void rm_digest_xxhash_steal(gpointer state, guint8 *result) {
@@ -179,12 +635,52 @@ static const RmDigestInterface xxhash_interface = {
     .name = "xxhash",
     .bits = 64,
     .len = NULL,
-    .new = (RmDigestNewFunc)rm_digest_xxhash_new,
-    .free = (RmDigestFreeFunc)XXH64_freeState,
+    .state_size = sizeof(XXH64_state_t),
+    .init = (RmDigestInitFunc)rm_digest_xxhash_init,
     .update = (RmDigestUpdateFunc)XXH64_update,
-    .copy = (RmDigestCopyFunc)rm_digest_xxhash_copy,
     .steal = rm_digest_xxhash_steal};
 
+///////////////////////////
+//    xxh3 interfaces    //
+///////////////////////////
+
+/* XXH3 shares its state between the 64 and 128 bit variants; the checksums
+ * are written in xxHash's canonical (big endian) form, as printed by xxhsum */
+
+static void rm_digest_xxh3_init(XXH3_state_t *state) {
+    XXH3_INITSTATE(state);
+    XXH3_64bits_reset(state);
+}
+
+static void rm_digest_xxh3_64_steal(XXH3_state_t *state, guint8 *result) {
+    /* XXH3 digest functions leave the state untouched */
+    XXH64_canonicalFromHash((XXH64_canonical_t *)result, XXH3_64bits_digest(state));
+}
+
+static void rm_digest_xxh3_128_steal(XXH3_state_t *state, guint8 *result) {
+    XXH128_canonicalFromHash((XXH128_canonical_t *)result, XXH3_128bits_digest(state));
+}
+
+static const RmDigestInterface xxh3_64_interface = {
+    .name = "xxh3",
+    .bits = 64,
+    .len = NULL,
+    .state_size = sizeof(XXH3_state_t),
+    .init = (RmDigestInitFunc)rm_digest_xxh3_init,
+    .update = (RmDigestUpdateFunc)XXH3_64bits_update_dispatch,
+    .steal = (RmDigestStealFunc)rm_digest_xxh3_64_steal,
+    .kernel = XXH3_dispatch_name};
+
+static const RmDigestInterface xxh3_128_interface = {
+    .name = "xxh3-128",
+    .bits = 128,
+    .len = NULL,
+    .state_size = sizeof(XXH3_state_t),
+    .init = (RmDigestInitFunc)rm_digest_xxh3_init,
+    .update = (RmDigestUpdateFunc)XXH3_128bits_update_dispatch,
+    .steal = (RmDigestStealFunc)rm_digest_xxh3_128_steal,
+    .kernel = XXH3_dispatch_name};
+
 ///////////////////////////
 //        murmur         //
 ///////////////////////////
@@ -247,11 +743,15 @@ static const RmDigestInterface metro256_interface = {
 /* also define crc-optimised metro variants metrocrc and metrocrc256*/
 
 static Metro128State *rm_digest_metrocrc_new(void) {
-    return metrohash128_1_new(g_atomic_int_get(&RM_DIGEST_USE_SSE));
+    return metrohash128_1_new(rm_simd_has_crc32());
 }
 
 static Metro256State *rm_digest_metrocrc256_new(void) {
-    return metrohash256_new(g_atomic_int_get(&RM_DIGEST_USE_SSE));
+    return metrohash256_new(rm_simd_has_crc32());
+}
+
+static const char *rm_digest_metrocrc_kernel(void) {
+    return rm_simd_has_crc32() ? "sse4.2" : rm_simd_level_name(RM_SIMD_NONE);
 }
 
 static const RmDigestInterface metrocrc_interface = {
@@ -262,7 +762,8 @@ static const RmDigestInterface metrocrc_interface = {
     .free = (RmDigestFreeFunc)metrohash128_free, /* <-same */
     .update = (RmDigestUpdateFunc)metrohash128crc_1_update,
     .copy = (RmDigestCopyFunc)metrohash128_copy, /* <-same */
-    .steal = (RmDigestStealFunc)metrohash128crc_1_steal};
+    .steal = (RmDigestStealFunc)metrohash128crc_1_steal,
+    .kernel = rm_digest_metrocrc_kernel};
 
 static const RmDigestInterface metrocrc256_interface = {
     .name = "metrocrc256",
@@ -272,7 +773,8 @@ static const RmDigestInterface metrocrc256_interface = {
     .free = (RmDigestFreeFunc)metrohash256_free, /* <-same */
     .update = (RmDigestUpdateFunc)metrohash256crc_update,
     .copy = (RmDigestCopyFunc)metrohash256_copy, /* <-same */
-    .steal = (RmDigestStealFunc)metrohash256crc_steal};
+    .steal = (RmDigestStealFunc)metrohash256crc_steal,
+    .kernel = rm_digest_metrocrc_kernel};
 
 #endif
 
@@ -388,15 +890,9 @@ static const RmDigestInterface cumulative_interface = {
 //     highway hash      //
 ///////////////////////////
 
-static HighwayHashCat *rm_digest_highway_new(void) {
-    HighwayHashCat *state = g_slice_new(HighwayHashCat);
+static void rm_digest_highway_init(HighwayHashCat *state) {
     static const uint64_t key[4] = {1, 2, 3, 4};
     HighwayHashCatStart(key, state);
-    return state;
-}
-
-static void rm_digest_highway_free(HighwayHashCat *state) {
-    g_slice_free(HighwayHashCat, state);
 }
 
 static void rm_digest_highway_update(HighwayHashCat *state, const unsigned char *data,
@@ -404,10 +900,6 @@ static void rm_digest_highway_update(HighwayHashCat *state, const unsigned char
     HighwayHashCatAppend((const uint8_t *)data, size, state);
 }
 
-static HighwayHashCat *rm_digest_highway_copy(HighwayHashCat *state) {
-    return g_slice_copy(sizeof(HighwayHashCat), state);
-}
-
 static void rm_digest_highway64_steal(HighwayHashCat *state, guint8 *result) {
     /* HighwayHashCatFinish functions are non-destructive so steal funcs don't
      * need to make a copy */
@@ -418,31 +910,31 @@ static const RmDigestInterface highway64_interface = {
     .name = "highway64",
     .bits = 64,
     .len = NULL,
-    .new = (RmDigestNewFunc)rm_digest_highway_new,
-    .free = (RmDigestFreeFunc)rm_digest_highway_free,
+    .state_size = sizeof(HighwayHashCat),
+    .init = (RmDigestInitFunc)rm_digest_highway_init,
     .update = (RmDigestUpdateFunc)rm_digest_highway_update,
-    .copy = (RmDigestCopyFunc)rm_digest_highway_copy,
-    .steal = (RmDigestStealFunc)rm_digest_highway64_steal};
+    .steal = (RmDigestStealFunc)rm_digest_highway64_steal,
+    .kernel = HighwayHashKernelName};
 
 static const RmDigestInterface highway128_interface = {
     .name = "highway128",
     .bits = 128,
     .len = NULL,
-    .new = (RmDigestNewFunc)rm_digest_highway_new,
-    .free = (RmDigestFreeFunc)rm_digest_highway_free,
+    .state_size = sizeof(HighwayHashCat),
+    .init = (RmDigestInitFunc)rm_digest_highway_init,
     .update = (RmDigestUpdateFunc)rm_digest_highway_update,
-    .copy = (RmDigestCopyFunc)rm_digest_highway_copy,
-    .steal = (RmDigestStealFunc)HighwayHashCatFinish128};
+    .steal = (RmDigestStealFunc)HighwayHashCatFinish128,
+    .kernel = HighwayHashKernelName};
 
 static const RmDigestInterface highway256_interface = {
     .name = "highway256",
     .bits = 256,
     .len = NULL,
-    .new = (RmDigestNewFunc)rm_digest_highway_new,
-    .free = (RmDigestFreeFunc)rm_digest_highway_free,
+    .state_size = sizeof(HighwayHashCat),
+    .init = (RmDigestInitFunc)rm_digest_highway_init,
     .update = (RmDigestUpdateFunc)rm_digest_highway_update,
-    .copy = (RmDigestCopyFunc)rm_digest_highway_copy,
-    .steal = (RmDigestStealFunc)HighwayHashCatFinish256};
+    .steal = (RmDigestStealFunc)HighwayHashCatFinish256,
+    .kernel = HighwayHashKernelName};
 
 ///////////////////////////
 //      glib hashes      //
@@ -476,30 +968,6 @@ static void rm_digest_md5_steal(GChecksum *state, guint8 *result) {
 }
 RM_DIGEST_DEFINE_GLIB(md5, 128);
 
-/* sha1 */
-static GChecksum *rm_digest_sha1_new(void) {
-    return g_checksum_new(G_CHECKSUM_SHA1);
-}
-
-static void rm_digest_sha1_steal(GChecksum *state, guint8 *result) {
-    gsize len = 20;
-    rm_digest_glib_steal(state, result, &len);
-}
-
-RM_DIGEST_DEFINE_GLIB(sha1, 160);
-
-/* sha256 */
-static GChecksum *rm_digest_sha256_new(void) {
-    return g_checksum_new(G_CHECKSUM_SHA256);
-}
-
-static void rm_digest_sha256_steal(GChecksum *state, guint8 *result) {
-    gsize len = 32;
-    rm_digest_glib_steal(state, result, &len);
-}
-
-RM_DIGEST_DEFINE_GLIB(sha256, 256);
-
 #if HAVE_SHA512
 
 /* sha512 */
@@ -516,51 +984,48 @@ RM_DIGEST_DEFINE_GLIB(sha512, 512);
 #endif
 
 ///////////////////////////
-//      sha3 hashes      //
+//   sha1/sha256 hashes  //
 ///////////////////////////
 
-static sha3_context *rm_digest_sha3_256_new(void) {
-    sha3_context *state = g_slice_new(sha3_context);
-    sha3_Init256(state);
-    return state;
-}
-
-static sha3_context *rm_digest_sha3_384_new(void) {
-    sha3_context *state = g_slice_new(sha3_context);
-    sha3_Init384(state);
-    return state;
-}
-
-static sha3_context *rm_digest_sha3_512_new(void) {
-    sha3_context *state = g_slice_new(sha3_context);
-    sha3_Init512(state);
-    return state;
-}
+/* native implementations, so that SHA-NI / ARMv8 crypto can be used */
 
-static void rm_digest_sha3_free(sha3_context *state) {
-    g_slice_free(sha3_context, state);
-}
+static const RmDigestInterface sha1_interface = {
+    .name = "sha1",
+    .bits = 160,
+    .len = NULL,
+    .state_size = sizeof(sha1_state),
+    .init = (RmDigestInitFunc)sha1_init,
+    .update = (RmDigestUpdateFunc)sha1_update,
+    .steal = (RmDigestStealFunc)sha1_final,
+    .kernel = sha_kernel_name};
+
+static const RmDigestInterface sha256_interface = {
+    .name = "sha256",
+    .bits = 256,
+    .len = NULL,
+    .state_size = sizeof(sha256_state),
+    .init = (RmDigestInitFunc)sha256_init,
+    .update = (RmDigestUpdateFunc)sha256_update,
+    .steal = (RmDigestStealFunc)sha256_final,
+    .kernel = sha_kernel_name};
 
-static sha3_context *rm_digest_sha3_copy(sha3_context *state) {
-    return g_slice_copy(sizeof(sha3_context), state);
-}
+///////////////////////////
+//      sha3 hashes      //
+///////////////////////////
 
 static void rm_digest_sha3_256_steal(sha3_context *state, guint8 *result) {
-    sha3_context *copy = g_slice_copy(sizeof(sha3_context), state);
-    memcpy(result, sha3_Finalize(copy), 256 / 8);
-    rm_digest_sha3_free(copy);
+    sha3_context copy = *state;
+    memcpy(result, sha3_Finalize(&copy), 256 / 8);
 }
 
 static void rm_digest_sha3_384_steal(sha3_context *state, guint8 *result) {
-    sha3_context *copy = g_slice_copy(sizeof(sha3_context), state);
-    memcpy(result, sha3_Finalize(copy), 384 / 8);
-    rm_digest_sha3_free(copy);
+    sha3_context copy = *state;
+    memcpy(result, sha3_Finalize(&copy), 384 / 8);
 }
 
 static void rm_digest_sha3_512_steal(sha3_context *state, guint8 *result) {
-    sha3_context *copy = g_slice_copy(sizeof(sha3_context), state);
-    memcpy(result, sha3_Finalize(copy), 512 / 8);
-    rm_digest_sha3_free(copy);
+    sha3_context copy = *state;
+    memcpy(result, sha3_Finalize(&copy), 512 / 8);
 }
 
 #define RM_DIGEST_DEFINE_SHA3(BITS)                            \
@@ -568,10 +1033,9 @@ static void rm_digest_sha3_512_steal(sha3_context *state, guint8 *result) {
         .name = ("sha3-" #BITS),                               \
         .bits = BITS, \
         .len = NULL, \
-        .new = (RmDigestNewFunc)rm_digest_sha3_##BITS##_new,   \
-        .free = (RmDigestFreeFunc)rm_digest_sha3_free,         \
+        .state_size = sizeof(sha3_context),                    \
+        .init = (RmDigestInitFunc)sha3_Init##BITS,             \
         .update = (RmDigestUpdateFunc)sha3_Update,             \
-        .copy = (RmDigestCopyFunc)rm_digest_sha3_copy,         \
         .steal = (RmDigestStealFunc)rm_digest_sha3_##BITS##_steal};
 
 RM_DIGEST_DEFINE_SHA3(256)
@@ -584,42 +1048,252 @@ RM_DIGEST_DEFINE_SHA3(512)
 
 
 
-#define CREATE_BLAKE_INTERFACE(ALGO, ALGO_BIG)                                  \
+#define CREATE_BLAKE_INTERFACE(ALGO, ALGO_BIG, KERNEL)                          \
                                                                                 \
-    static ALGO##_state *rm_digest_##ALGO##_new(void) {                         \
-        ALGO##_state *state = g_slice_new(ALGO##_state);                        \
+    static void rm_digest_##ALGO##_init(ALGO##_state *state) {                  \
         ALGO##_init(state, ALGO_BIG##_OUTBYTES);                                \
-        return state;                                                           \
-    }                                                                           \
-                                                                                \
-    static void rm_digest_##ALGO##_free(ALGO##_state *state) {                  \
-        g_slice_free(ALGO##_state, state);                                      \
-    }                                                                           \
-                                                                                \
-    static ALGO##_state *rm_digest_##ALGO##_copy(ALGO##_state *state) {         \
-        return g_slice_copy(sizeof(ALGO##_state), state);                       \
     }                                                                           \
                                                                                 \
     static void rm_digest_##ALGO##_steal(ALGO##_state *state, guint8 *result) { \
-        ALGO##_state *copy = rm_digest_##ALGO##_copy(state);                    \
-        ALGO##_final(copy, result, ALGO_BIG##_OUTBYTES);                        \
-        rm_digest_##ALGO##_free(copy);                                          \
+        ALGO##_state copy = *state;                                             \
+        ALGO##_final(&copy, result, ALGO_BIG##_OUTBYTES);                       \
     }                                                                           \
                                                                                 \
     static const RmDigestInterface ALGO##_interface = {                         \
         .name = #ALGO,                                                          \
         .bits = 8 * ALGO_BIG##_OUTBYTES,                                        \
         .len = NULL,                                                            \
-        .new = (RmDigestNewFunc)rm_digest_##ALGO##_new,                         \
-        .free = (RmDigestFreeFunc)rm_digest_##ALGO##_free,                      \
+        .state_size = sizeof(ALGO##_state),                                     \
+        .init = (RmDigestInitFunc)rm_digest_##ALGO##_init,                      \
         .update = (RmDigestUpdateFunc)ALGO##_update,                            \
-        .copy = (RmDigestCopyFunc)rm_digest_##ALGO##_copy,                      \
-        .steal = (RmDigestStealFunc)rm_digest_##ALGO##_steal};
+        .steal = (RmDigestStealFunc)rm_digest_##ALGO##_steal,                   \
+        .kernel = KERNEL##_kernel_name};
+
+CREATE_BLAKE_INTERFACE(blake2b, BLAKE2B, blake2b);
+CREATE_BLAKE_INTERFACE(blake2bp, BLAKE2B, blake2b);
+CREATE_BLAKE_INTERFACE(blake2s, BLAKE2S, blake2s);
+CREATE_BLAKE_INTERFACE(blake2sp, BLAKE2S, blake2s);
+
+///////////////////////////
+//   blake2b tree hash   //
+///////////////////////////
+
+/* The checksum is blake2b(leaf hashes | length), where each leaf hash is the
+ * blake2b of RM_DIGEST_TREE_LEAF_SIZE bytes of data (or less for the last).
+ * Leaves can be hashed independently of each other, which lets rm_hasher
+ * spread a single large file over several threads. */
+
+static void rm_digest_tree_init(RmDigestTree *state) {
+    memset(state, 0, sizeof(RmDigestTree));
+    blake2b_init(&state->root, BLAKE2B_OUTBYTES);
+    blake2b_init(&state->leaf, BLAKE2B_OUTBYTES);
+}
+
+static void rm_digest_tree_finish_leaf(RmDigestTree *state) {
+    guint8 hash[BLAKE2B_OUTBYTES];
+    blake2b_final(&state->leaf, hash, sizeof(hash));
+    blake2b_update(&state->root, hash, sizeof(hash));
+    blake2b_init(&state->leaf, BLAKE2B_OUTBYTES);
+    state->leaf_len = 0;
+}
+
+static void rm_digest_tree_update(RmDigestTree *state, const unsigned char *data,
+                                  size_t size) {
+    while(size > 0) {
+        gsize chunk = MIN(size, RM_DIGEST_TREE_LEAF_SIZE - state->leaf_len);
+        blake2b_update(&state->leaf, data, chunk);
+        state->leaf_len += chunk;
+        state->len += chunk;
+        data += chunk;
+        size -= chunk;
+
+        if(state->leaf_len == RM_DIGEST_TREE_LEAF_SIZE) {
+            rm_digest_tree_finish_leaf(state);
+        }
+    }
+}
+
+static void rm_digest_tree_hash_leaf(RmDigestLeaf *leaf, RmSemaphore *sem) {
+    blake2b_state state;
+    blake2b_init(&state, BLAKE2B_OUTBYTES);
+
+    RmBuffer *buffer = NULL;
+    while((buffer = g_queue_pop_head(&leaf->buffers))) {
+        blake2b_update(&state, buffer->data, buffer->len);
+        rm_buffer_free(sem, buffer);
+    }
+    blake2b_final(&state, leaf->hash, BLAKE2B_OUTBYTES);
+}
+
+static void rm_digest_tree_fold(RmDigestTree *state, RmDigestLeaf *leaf) {
+    /* the reader only gathers leaves at leaf boundaries */
+    g_assert(state->leaf_len == 0);
+
+    blake2b_update(&state->root, leaf->hash, BLAKE2B_OUTBYTES);
+    state->len += leaf->len;
+}
+
+static void rm_digest_tree_steal(RmDigestTree *state, guint8 *result) {
+    RmDigestTree copy = *state;
+    if(copy.leaf_len > 0) {
+        rm_digest_tree_finish_leaf(&copy);
+    }
+
+    guint64 len = GUINT64_TO_LE(copy.len);
+    blake2b_update(&copy.root, (const guint8 *)&len, sizeof(len));
+    blake2b_final(&copy.root, result, BLAKE2B_OUTBYTES);
+}
+
+static const RmDigestInterface blake2b_tree_interface = {
+    .name = "blake2b-tree",
+    .bits = 8 * BLAKE2B_OUTBYTES,
+    .len = NULL,
+    .state_size = sizeof(RmDigestTree),
+    .init = (RmDigestInitFunc)rm_digest_tree_init,
+    .update = (RmDigestUpdateFunc)rm_digest_tree_update,
+    .steal = (RmDigestStealFunc)rm_digest_tree_steal,
+    .kernel = blake2b_kernel_name};
+
+///////////////////////////
+//        blake3         //
+///////////////////////////
+
+/* BLAKE3 is a tree hash itself: a leaf is a subtree of 1024 chunks, which is
+ * added to the hasher as the chaining values of its two halves. */
+
+static void rm_digest_blake3_steal(blake3_hasher *state, guint8 *result) {
+    blake3_hasher_finalize(state, result, BLAKE3_OUT_LEN);
+}
+
+static void rm_digest_blake3_hash_leaf(RmDigestLeaf *leaf, RmSemaphore *sem) {
+    G_STATIC_ASSERT(sizeof(leaf->hash) >= 2 * BLAKE3_OUT_LEN);
+
+    blake3_hasher state;
+    blake3_hasher_init_subtree(&state, leaf->offset / BLAKE3_CHUNK_LEN);
 
-CREATE_BLAKE_INTERFACE(blake2b, BLAKE2B);
-CREATE_BLAKE_INTERFACE(blake2bp, BLAKE2B);
-CREATE_BLAKE_INTERFACE(blake2s, BLAKE2S);
-CREATE_BLAKE_INTERFACE(blake2sp, BLAKE2S);
+    RmBuffer *buffer = NULL;
+    while((buffer = g_queue_pop_head(&leaf->buffers))) {
+        blake3_hasher_update(&state, buffer->data, buffer->len);
+        rm_buffer_free(sem, buffer);
+    }
+    blake3_hasher_finalize_subtree(&state, leaf->hash);
+}
+
+static void rm_digest_blake3_fold(blake3_hasher *state, RmDigestLeaf *leaf) {
+    blake3_hasher_push_subtree(state, leaf->hash,
+                               RM_DIGEST_TREE_LEAF_SIZE / BLAKE3_CHUNK_LEN);
+}
+
+static const RmDigestInterface blake3_interface = {
+    .name = "blake3",
+    .bits = 8 * BLAKE3_OUT_LEN,
+    .len = NULL,
+    .state_size = sizeof(blake3_hasher),
+    .init = (RmDigestInitFunc)blake3_hasher_init,
+    .update = (RmDigestUpdateFunc)blake3_hasher_update,
+    .steal = (RmDigestStealFunc)rm_digest_blake3_steal,
+    .kernel = blake3_simd_name};
+
+///////////////////////////
+//     digest leaves     //
+///////////////////////////
+
+/* Leaves let rm_hasher spread a single large file over several threads:
+ * whole leaves are hashed independently of each other by
+ * rm_digest_leaf_hash() and the results are folded into the digest in order
+ * by rm_digest_leaf_fold(). */
+
+gboolean rm_digest_has_leaves(RmDigestType type) {
+    return type == RM_DIGEST_BLAKE2B_TREE || type == RM_DIGEST_BLAKE3;
+}
+
+RmDigestLeaf *rm_digest_leaf_new(RmDigest *digest) {
+    g_assert(rm_digest_has_leaves(digest->type));
+    g_assert(digest->sent % RM_DIGEST_TREE_LEAF_SIZE == 0);
+
+    RmDigestLeaf *leaf = g_slice_new0(RmDigestLeaf);
+    leaf->type = digest->type;
+    leaf->offset = digest->sent;
+    g_queue_init(&leaf->buffers);
+    g_mutex_init(&leaf->lock);
+    g_cond_init(&leaf->cond);
+    return leaf;
+}
+
+/* hash of a RM_DIGEST_BLAKE2B_TREE leaf of zeros */
+static gpointer rm_digest_tree_zero_leaf_hash(guint8 *hash) {
+    blake2b_state state;
+    blake2b_init(&state, BLAKE2B_OUTBYTES);
+    for(gsize done = 0; done < RM_DIGEST_TREE_LEAF_SIZE; done += RM_BUFFER_ZEROS_LEN) {
+        blake2b_update(&state, rm_buffer_zero_block, RM_BUFFER_ZEROS_LEN);
+    }
+    blake2b_final(&state, hash, BLAKE2B_OUTBYTES);
+    return hash;
+}
+
+RmDigestLeaf *rm_digest_leaf_new_zeros(RmDigest *digest) {
+    /* BLAKE3 chunks depend on their position; leaves of RM_DIGEST_BLAKE2B_TREE
+     * are hashed on their own */
+    if(digest->type != RM_DIGEST_BLAKE2B_TREE) {
+        return NULL;
+    }
+
+    static GOnce once = G_ONCE_INIT;
+    static guint8 zero_leaf_hash[BLAKE2B_OUTBYTES];
+    g_once(&once, (GThreadFunc)rm_digest_tree_zero_leaf_hash, zero_leaf_hash);
+
+    RmDigestLeaf *leaf = rm_digest_leaf_new(digest);
+    leaf->len = RM_DIGEST_TREE_LEAF_SIZE;
+    memcpy(leaf->hash, zero_leaf_hash, BLAKE2B_OUTBYTES);
+    leaf->done = TRUE;
+    return leaf;
+}
+
+void rm_digest_leaf_free(RmDigestLeaf *leaf) {
+    g_assert(g_queue_is_empty(&leaf->buffers));
+    g_mutex_clear(&leaf->lock);
+    g_cond_clear(&leaf->cond);
+    g_slice_free(RmDigestLeaf, leaf);
+}
+
+void rm_digest_leaf_hash(RmDigestLeaf *leaf, RmSemaphore *sem) {
+    /* only whole leaves are hashed this way */
+    g_assert(leaf->len == RM_DIGEST_TREE_LEAF_SIZE);
+
+    if(leaf->type == RM_DIGEST_BLAKE3) {
+        rm_digest_blake3_hash_leaf(leaf, sem);
+    } else {
+        rm_digest_tree_hash_leaf(leaf, sem);
+    }
+
+    g_mutex_lock(&leaf->lock);
+    {
+        leaf->done = TRUE;
+        g_cond_signal(&leaf->cond);
+    }
+    g_mutex_unlock(&leaf->lock);
+}
+
+/* add a leaf hashed by rm_digest_leaf_hash() to digest; waits for it if
+ * needed and frees it */
+static void rm_digest_leaf_fold(RmDigest *digest, RmDigestLeaf *leaf) {
+    g_assert(leaf->type == digest->type);
+
+    g_mutex_lock(&leaf->lock);
+    {
+        while(!leaf->done) {
+            g_cond_wait(&leaf->cond, &leaf->lock);
+        }
+    }
+    g_mutex_unlock(&leaf->lock);
+
+    if(leaf->type == RM_DIGEST_BLAKE3) {
+        rm_digest_blake3_fold(digest->state, leaf);
+    } else {
+        rm_digest_tree_fold(digest->state, leaf);
+    }
+    rm_digest_leaf_free(leaf);
+}
 
 ///////////////////////////
 //      ext  hash        //
@@ -722,10 +1396,62 @@ static void rm_digest_paranoid_free(RmParanoid *paranoid) {
     rm_digest_free(paranoid->shadow_hash);
     rm_digest_paranoid_release_buffers(paranoid);
     g_async_queue_unref(paranoid->incoming_twin_candidates);
-    g_slist_free(paranoid->rejects);
     g_slice_free(RmParanoid, paranoid);
 }
 
+/* twin_matches has a bit per candidate */
+G_STATIC_ASSERT(RM_PARANOID_MAX_CANDIDATES <= 32);
+G_STATIC_ASSERT(RM_PARANOID_MAX_CANDIDATES <= RM_BLOCKCMP_MAX_CANDIDATES);
+
+/* Compare buffer with the next buffer of each twin candidate in mask, in one
+ * pass, and move those that match on to their next buffer.
+ * Returns the candidates of mask that still match. */
+static guint32 rm_digest_paranoid_match(RmParanoid *paranoid, RmBuffer *buffer,
+                                        guint32 mask) {
+    const void *twin_data[RM_PARANOID_MAX_CANDIDATES];
+    guint32 same = 0;
+    for(guint i = 0; i < paranoid->n_twin_candidates; i++) {
+        GSList *twin_buffer = paranoid->twin_candidate_buffers[i];
+        if(!(mask >> i & 1)) {
+            continue;
+        } else if(!twin_buffer || ((RmBuffer *)twin_buffer->data)->len != buffer->len) {
+            mask &= ~(1u << i);
+        } else if(((RmBuffer *)twin_buffer->data)->data == buffer->data) {
+            /* both are zeros (see rm_buffer_new_zeros()) */
+            mask &= ~(1u << i);
+            same |= 1u << i;
+        } else {
+            twin_data[i] = ((RmBuffer *)twin_buffer->data)->data;
+        }
+    }
+
+    mask = same | rm_blockcmp(buffer->data, twin_data, paranoid->n_twin_candidates,
+                              buffer->len, mask);
+
+    for(guint i = 0; i < paranoid->n_twin_candidates; i++) {
+        if(mask >> i & 1) {
+            paranoid->twin_candidate_buffers[i] = paranoid->twin_candidate_buffers[i]->next;
+        }
+    }
+    return mask;
+}
+
+/* Forget the twin candidates which are known not to match, to make room for
+ * new ones */
+static void rm_digest_paranoid_forget_mismatches(RmParanoid *paranoid) {
+    guint n_kept = 0;
+    for(guint i = 0; i < paranoid->n_twin_candidates; i++) {
+        if(paranoid->twin_matches >> i & 1) {
+            paranoid->twin_candidates[n_kept] = paranoid->twin_candidates[i];
+            paranoid->twin_candidate_buffers[n_kept] = paranoid->twin_candidate_buffers[i];
+            n_kept++;
+        }
+    }
+    paranoid->n_twin_candidates = n_kept;
+    paranoid->twin_matches =
+        (n_kept == RM_PARANOID_MAX_CANDIDATES) ? G_MAXUINT32 : (1u << n_kept) - 1;
+}
+
 static void rm_digest_paranoid_buffered_update(RmParanoid *paranoid, RmBuffer *buffer) {
     /* Welcome to hell!
      * This is a somewhat crazy part of the rmlint optimisation strategy.
@@ -733,11 +1459,18 @@ static void rm_digest_paranoid_buffered_update(RmParanoid *paranoid, RmBuffer *b
      * a series of buffers) is fairly simple but it's slow because it has to compare
      * each buffer.
      * The algorithm below tries to get a head-start on the comparison by starting the
-     * buffer comparison before the last buffer has been read.
+     * buffer comparison before the last buffer has been read.  Each buffer is
+     * compared against all twin candidates in a single pass (see rm_blockcmp()).
      */
 
     rm_digest_update(paranoid->shadow_hash, buffer->data, buffer->len);
 
+    /* keep the data in the scratch file rather than on the heap */
+    RmSpill *spill = g_atomic_pointer_get(&rm_spill);
+    if(spill != NULL) {
+        rm_buffer_spill(buffer, spill);
+    }
+
     if(!paranoid->buffers) {
         /* first buffer */
         paranoid->buffers = g_slist_prepend(NULL, buffer);
@@ -746,59 +1479,68 @@ static void rm_digest_paranoid_buffered_update(RmParanoid *paranoid, RmBuffer *b
         paranoid->buffer_tail = g_slist_append(paranoid->buffer_tail, buffer)->next;
     }
 
-    if(paranoid->twin_candidate) {
-        /* do a running check that digest remains the same as its candidate twin */
-        if(rm_buffer_equal(buffer, paranoid->twin_candidate_buffer->data)) {
-            /* buffers match; move ptr to next one ready for next buffer */
-            paranoid->twin_candidate_buffer = paranoid->twin_candidate_buffer->next;
-        } else {
-            /* buffers don't match - delete candidate (new candidate might be added on
-             * next
-             * call to rm_digest_buffered_update) */
-            paranoid->twin_candidate = NULL;
-            paranoid->twin_candidate_buffer = NULL;
+    if(paranoid->twin_matches) {
+        /* do a running check that digest remains the same as its candidate twins;
+         * the ones that don't are kept as known mismatches for rm_digest_equal() */
+        paranoid->twin_matches =
+            rm_digest_paranoid_match(paranoid, buffer, paranoid->twin_matches);
 #if _RM_CHECKSUM_DEBUG
-            rm_log_debug_line("Ejected candidate match at buffer #%u",
-                              g_slist_length(paranoid->buffers));
+        rm_log_debug_line("%u twin candidates left at buffer #%u",
+                          g_bit_count(paranoid->twin_matches),
+                          g_slist_length(paranoid->buffers));
 #endif
-        }
     }
 
-    while(!paranoid->twin_candidate && (paranoid->twin_candidate = g_async_queue_try_pop(
-                                            paranoid->incoming_twin_candidates))) {
-        /* validate the new candidate by comparing the previous buffers (not
-         * including current)*/
-        RmParanoid *twin = paranoid->twin_candidate->state;
-        paranoid->twin_candidate_buffer = twin->buffers;
-        GSList *iter_self = paranoid->buffers;
-        gboolean match = TRUE;
-        while(match && iter_self) {
-            match =
-                (rm_buffer_equal(paranoid->twin_candidate_buffer->data, iter_self->data));
-            iter_self = iter_self->next;
-            paranoid->twin_candidate_buffer = paranoid->twin_candidate_buffer->next;
-        }
-        if(paranoid->twin_candidate && !match) {
-        /* reject the twin candidate, also add to rejects list to speed up
-         * rm_digest_equal() */
-#if _RM_CHECKSUM_DEBUG
-            rm_log_debug_line("Rejected twin candidate %p for %p",
-                              paranoid->twin_candidate, paranoid);
-#endif
-            if(!paranoid->shadow_hash) {
-                /* we use the rejects file to speed up rm_digest_equal */
-                paranoid->rejects =
-                    g_slist_prepend(paranoid->rejects, paranoid->twin_candidate);
+    /* take on new candidates, as far as there is room */
+    guint32 fresh = 0;
+    while(TRUE) {
+        if(paranoid->n_twin_candidates == RM_PARANOID_MAX_CANDIDATES) {
+            if(fresh) {
+                /* the rest have to wait for the next buffer */
+                break;
             }
-            paranoid->twin_candidate = NULL;
-            paranoid->twin_candidate_buffer = NULL;
-        } else {
+            rm_digest_paranoid_forget_mismatches(paranoid);
+            if(paranoid->n_twin_candidates == RM_PARANOID_MAX_CANDIDATES) {
+                break;
+            }
+        }
+
+        RmDigest *candidate = g_async_queue_try_pop(paranoid->incoming_twin_candidates);
+        if(!candidate) {
+            break;
+        }
+
+        guint i = paranoid->n_twin_candidates++;
+        paranoid->twin_candidates[i] = candidate;
+        paranoid->twin_candidate_buffers[i] = ((RmParanoid *)candidate->state)->buffers;
+        fresh |= 1u << i;
+    }
+
+    /* validate the new candidates by comparing the buffers so far (including
+     * current), all at once */
+    for(GSList *iter = paranoid->buffers; iter && fresh; iter = iter->next) {
+        fresh = rm_digest_paranoid_match(paranoid, iter->data, fresh);
+    }
+    paranoid->twin_matches |= fresh;
+
 #if _RM_CHECKSUM_DEBUG
-            rm_log_debug_line("Added twin candidate %p for %p", paranoid->twin_candidate,
-                              paranoid);
+    if(fresh) {
+        rm_log_debug_line("Added %u twin candidates for %p", g_bit_count(fresh), paranoid);
+    }
 #endif
+}
+
+/* Was other sent to paranoid as a twin candidate?
+ * Returns whether it matched, or -1 if it wasn't */
+static gint rm_digest_paranoid_known_twin(RmParanoid *paranoid, RmDigest *other) {
+    for(guint i = 0; i < paranoid->n_twin_candidates; i++) {
+        if(paranoid->twin_candidates[i] == other) {
+            /* a match must also have run out of buffers */
+            return (paranoid->twin_matches >> i & 1) &&
+                   paranoid->twin_candidate_buffers[i] == NULL;
         }
     }
+    return -1;
 }
 
 static void rm_digest_paranoid_steal(RmParanoid *paranoid, guint8 *result) {
@@ -816,7 +1558,8 @@ static const RmDigestInterface paranoid_interface = {
     .free = (RmDigestFreeFunc)rm_digest_paranoid_free,
     .update = NULL,
     .copy = (RmDigestCopyFunc)rm_digest_paranoid_copy,
-    .steal = (RmDigestStealFunc)rm_digest_paranoid_steal};
+    .steal = (RmDigestStealFunc)rm_digest_paranoid_steal,
+    .kernel = rm_blockcmp_kernel_name};
 
 ////////////////////////////////
 //   RmDigestInterface map    //
@@ -848,9 +1591,13 @@ static const RmDigestInterface *rm_digest_get_interface(RmDigestType type) {
         [RM_DIGEST_CUMULATIVE] = &cumulative_interface,
         [RM_DIGEST_PARANOID] = &paranoid_interface,
         [RM_DIGEST_XXHASH] = &xxhash_interface,
+        [RM_DIGEST_XXH3_64] = &xxh3_64_interface,
+        [RM_DIGEST_XXH3_128] = &xxh3_128_interface,
         [RM_DIGEST_HIGHWAY64] = &highway64_interface,
         [RM_DIGEST_HIGHWAY128] = &highway128_interface,
         [RM_DIGEST_HIGHWAY256] = &highway256_interface,
+        [RM_DIGEST_BLAKE2B_TREE] = &blake2b_tree_interface,
+        [RM_DIGEST_BLAKE3] = &blake3_interface,
     };
 
     g_assert(type < RM_DIGEST_SENTINEL);
@@ -876,10 +1623,112 @@ static gpointer rm_init_digest_type_table(GHashTable **code_table) {
     /* add some synonyms */
     rm_digest_table_insert(*code_table, "sha3", RM_DIGEST_SHA3_256);
     rm_digest_table_insert(*code_table, "highway", RM_DIGEST_HIGHWAY256);
+    rm_digest_table_insert(*code_table, "xxh128", RM_DIGEST_XXH3_128);
 
     return NULL;
 }
 
+///////////////////////////////////////
+//        DIGEST STATE POOLS         //
+///////////////////////////////////////
+
+/* Digests with a flat state (RmDigestInterface.state_size) are allocated as
+ * a single block: the RmDigest followed by its state.  The blocks come from
+ * one pool per digest type, which carves them out of larger slabs and
+ * recycles them when a digest is freed.  The shredder copies a digest for
+ * every file in every generation, so this saves a lot of malloc traffic.
+ * Slabs are only given back when rmlint exits. */
+
+/* a cache line, which is also what XXH3's state needs */
+#define RM_DIGEST_POOL_ALIGN (64)
+#define RM_DIGEST_POOL_SLAB_SIZE (64 * 1024)
+
+#define RM_DIGEST_POOL_ROUND(size) \
+    (((size) + RM_DIGEST_POOL_ALIGN - 1) / RM_DIGEST_POOL_ALIGN * RM_DIGEST_POOL_ALIGN)
+
+/* offset of the state within a block */
+#define RM_DIGEST_POOL_HEADER RM_DIGEST_POOL_ROUND(sizeof(RmDigest))
+
+typedef struct RmDigestPool {
+    GMutex lock;
+
+    /* recycled blocks, linked through their first bytes */
+    gpointer idle;
+
+    /* unused rest of the newest slab */
+    guint8 *slab;
+    gsize slab_left;
+
+    /* statistics for rm_digest_pool_stats() */
+    guint64 n_blocks;
+    guint64 n_slabs;
+    guint64 slab_bytes;
+} RmDigestPool;
+
+/* statically allocated GMutexes need no initialisation */
+static RmDigestPool rm_digest_pools[RM_DIGEST_SENTINEL];
+
+static RmDigest *rm_digest_pool_take(RmDigestType type) {
+    const RmDigestInterface *interface = rm_digest_get_interface(type);
+    gsize block_size = RM_DIGEST_POOL_HEADER + RM_DIGEST_POOL_ROUND(interface->state_size);
+    RmDigestPool *pool = &rm_digest_pools[type];
+    gpointer block = NULL;
+
+    g_mutex_lock(&pool->lock);
+    {
+        if(pool->idle) {
+            block = pool->idle;
+            pool->idle = *(gpointer *)block;
+        } else {
+            if(pool->slab_left < block_size) {
+                gsize slab_size = MAX(RM_DIGEST_POOL_SLAB_SIZE, block_size);
+                if(posix_memalign((gpointer *)&pool->slab, RM_DIGEST_POOL_ALIGN,
+                                  slab_size) != 0) {
+                    g_error("posix_memalign(%" G_GSIZE_FORMAT ") failed", slab_size);
+                }
+                /* the rest of the previous slab is wasted */
+                pool->slab_left = slab_size;
+                pool->n_slabs++;
+                pool->slab_bytes += slab_size;
+            }
+            block = pool->slab;
+            pool->slab += block_size;
+            pool->slab_left -= block_size;
+        }
+        pool->n_blocks++;
+    }
+    g_mutex_unlock(&pool->lock);
+
+    RmDigest *digest = block;
+    digest->state = (guint8 *)block + RM_DIGEST_POOL_HEADER;
+    return digest;
+}
+
+static void rm_digest_pool_give(RmDigest *digest) {
+    RmDigestPool *pool = &rm_digest_pools[digest->type];
+
+    g_mutex_lock(&pool->lock);
+    {
+        *(gpointer *)digest = pool->idle;
+        pool->idle = digest;
+    }
+    g_mutex_unlock(&pool->lock);
+}
+
+void rm_digest_pool_stats(RmDigestPoolStats *stats) {
+    memset(stats, 0, sizeof(RmDigestPoolStats));
+    for(RmDigestType type = 1; type < RM_DIGEST_SENTINEL; type++) {
+        RmDigestPool *pool = &rm_digest_pools[type];
+        g_mutex_lock(&pool->lock);
+        {
+            stats->n_digests += pool->n_blocks;
+            stats->n_slabs += pool->n_slabs;
+            stats->slab_bytes += pool->slab_bytes;
+        }
+        g_mutex_unlock(&pool->lock);
+    }
+}
+
 ///////////////////////////////////////
 //           RMDIGEST API            //
 ///////////////////////////////////////
@@ -906,15 +1755,34 @@ const char *rm_digest_type_to_string(RmDigestType type) {
     return interface->name;
 }
 
+const char *rm_digest_kernel_name(RmDigestType type) {
+    const RmDigestInterface *interface = rm_digest_get_interface(type);
+    if(interface->kernel == NULL) {
+        return rm_simd_level_name(RM_SIMD_NONE);
+    }
+    return interface->kernel();
+}
+
 RmDigest *rm_digest_new(RmDigestType type, RmOff seed) {
     const RmDigestInterface *interface = rm_digest_get_interface(type);
 
-    RmDigest *digest = g_slice_new0(RmDigest);
+    RmDigest *digest = NULL;
+    if(interface->state_size) {
+        digest = rm_digest_pool_take(type);
+        gpointer state = digest->state;
+        memset(digest, 0, sizeof(RmDigest));
+        digest->state = state;
+        interface->init(state);
+    } else {
+        digest = g_slice_new0(RmDigest);
+        digest->state = interface->new();
+    }
     digest->type = type;
     digest->bytes = interface->bits / 8;
-    digest->state = interface->new();
     if(seed) {
         interface->update(digest->state, (const unsigned char *)&seed, sizeof(seed));
+        /* keep leaf boundaries in line with the reader's count */
+        digest->sent = sizeof(seed);
     }
 
     return digest;
@@ -926,9 +1794,14 @@ void rm_digest_release_buffers(RmDigest *digest) {
 }
 
 void rm_digest_free(RmDigest *digest) {
+    g_assert(digest->gathering == NULL);
     const RmDigestInterface *interface = rm_digest_get_interface(digest->type);
-    interface->free(digest->state);
-    g_slice_free(RmDigest, digest);
+    if(interface->state_size) {
+        rm_digest_pool_give(digest);
+    } else {
+        interface->free(digest->state);
+        g_slice_free(RmDigest, digest);
+    }
 }
 
 void rm_digest_update(RmDigest *digest, const unsigned char *data, RmOff size) {
@@ -942,7 +1815,10 @@ void rm_digest_update(RmDigest *digest, const unsigned char *data, RmOff size) {
 void rm_digest_buffered_update(RmSemaphore *sem, RmBuffer *buffer) {
     g_assert(buffer);
     RmDigest *digest = buffer->digest;
-    if(digest->type != RM_DIGEST_PARANOID) {
+    if(buffer->leaf) {
+        rm_digest_leaf_fold(digest, buffer->leaf);
+        rm_buffer_free(sem, buffer);
+    } else if(digest->type != RM_DIGEST_PARANOID) {
         rm_digest_update(digest, buffer->data, buffer->len);
         rm_buffer_free(sem, buffer);
     } else {
@@ -954,14 +1830,23 @@ void rm_digest_buffered_update(RmSemaphore *sem, RmBuffer *buffer) {
 RmDigest *rm_digest_copy(RmDigest *digest) {
     g_assert(digest);
 
-    RmDigest *copy = g_slice_copy(sizeof(RmDigest), digest);
-
     const RmDigestInterface *interface = rm_digest_get_interface(digest->type);
-    if(interface->copy == NULL) {
+    RmDigest *copy = NULL;
+
+    if(interface->state_size) {
+        copy = rm_digest_pool_take(digest->type);
+        gpointer state = copy->state;
+        memcpy(copy, digest, sizeof(RmDigest));
+        memcpy(state, digest->state, interface->state_size);
+        copy->state = state;
+    } else if(interface->copy) {
+        copy = g_slice_copy(sizeof(RmDigest), digest);
+        copy->state = interface->copy(digest->state);
+    } else {
         return NULL;
     }
 
-    copy->state = interface->copy(digest->state);
+    copy->gathering = NULL;
     return copy;
 }
 
@@ -1008,13 +1893,13 @@ gboolean rm_digest_equal(RmDigest *a, RmDigest *b) {
             /* buffers have been freed so we need to rely on shadow hash */
             return rm_digest_equal(pa->shadow_hash, pb->shadow_hash);
         }
-        /* check if pre-matched twins */
-        if(pa->twin_candidate == b || pb->twin_candidate == a) {
-            return true;
+        /* check if pre-matched twins or already rejected */
+        gint known = rm_digest_paranoid_known_twin(pa, b);
+        if(known < 0) {
+            known = rm_digest_paranoid_known_twin(pb, a);
         }
-        /* check if already rejected */
-        if(g_slist_find(pa->rejects, b) || g_slist_find(pb->rejects, a)) {
-            return false;
+        if(known >= 0) {
+            return known;
         }
         /* all the "easy" ways failed... do manual check of all buffers */
         GSList *a_iter = pa->buffers;
@@ -1092,19 +1977,6 @@ guint8 *rm_digest_sum(RmDigestType algo, const guint8 *data, gsize len, gsize *o
 }
 
 void rm_digest_enable_sse(gboolean use_sse) {
-#if HAVE_MM_CRC32_U64 && HAVE_BUILTIN_CPU_SUPPORTS
-    if (use_sse && __builtin_cpu_supports("sse4.2")) {
-        g_atomic_int_set(&RM_DIGEST_USE_SSE, TRUE);
-    } else {
-        g_atomic_int_set(&RM_DIGEST_USE_SSE, FALSE);
-        if (use_sse) {
-            rm_log_warning_line("Can't enable sse4.2");
-        }
-    }
-#else
-    if (use_sse) {
-        rm_log_warning_line("Can't enable sse4.2");
-        g_atomic_int_set(&RM_DIGEST_USE_SSE, FALSE);
-    }
-#endif    
+    rm_simd_set_max_level(use_sse ? RM_SIMD_AVX512 : RM_SIMD_NONE);
+    rm_log_debug_line("SIMD hash kernels: %s", rm_simd_level_name(rm_simd_level()));
 }
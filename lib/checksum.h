@@ -27,10 +27,12 @@
 #define RM_CHECKSUM_H
 
 #include <glib.h>
+#include <signal.h>
 #include <stdbool.h>
 #include "config.h"
 
 #include "checksums/blake2/blake2.h"
+#include "checksums/blake3/blake3.h"
 #include "checksums/sha3/sha3.h"
 #include "checksums/highwayhash.h"
 
@@ -57,9 +59,13 @@ typedef enum RmDigestType {
     RM_DIGEST_BLAKE2SP /*  Parallel version of BLAKE2P */,
     RM_DIGEST_BLAKE2BP /*  Parallel version of BLAKE2S */,
     RM_DIGEST_XXHASH,
+    RM_DIGEST_XXH3_64,
+    RM_DIGEST_XXH3_128,
     RM_DIGEST_HIGHWAY64,
     RM_DIGEST_HIGHWAY128,
     RM_DIGEST_HIGHWAY256,
+    RM_DIGEST_BLAKE2B_TREE, /* leaves can be hashed in parallel */
+    RM_DIGEST_BLAKE3,       /* leaves can be hashed in parallel */
     /* special kids in town */
     RM_DIGEST_CUMULATIVE, /* hash([a, b]) = hash([b, a]) */
     RM_DIGEST_EXT,        /* read hash as string         */
@@ -73,6 +79,9 @@ typedef struct RmUint128 {
     guint64 second;
 } RmUint128;
 
+/* Max. number of twin candidates a paranoid digest compares against at once */
+#define RM_PARANOID_MAX_CANDIDATES (32)
+
 typedef struct RmParanoid {
     /* the buffers containing file data byte-by-byte */
     GSList *buffers;
@@ -84,21 +93,62 @@ typedef struct RmParanoid {
      */
     struct RmDigest *shadow_hash;
 
-    /* Optional: if known, a potentially matching *completed* RMDigest
+    /* Optional: if known, potentially matching *completed* RMDigests
      * can be provided and will be progressively compared against
-     * this RmDigest *during* rm_digest_buffered_update(); this speeds
-     * up subsequent calls to rm_digest_equal() significantly.
+     * this RmDigest *during* rm_digest_buffered_update(), all in one pass
+     * over each buffer; this speeds up subsequent calls to rm_digest_equal()
+     * significantly.
      */
-    struct RmDigest *twin_candidate;
+    struct RmDigest *twin_candidates[RM_PARANOID_MAX_CANDIDATES];
+
+    /* Pointer to current buffer in twin_candidates[i]->paranoid->buffers */
+    GSList *twin_candidate_buffers[RM_PARANOID_MAX_CANDIDATES];
+    guint n_twin_candidates;
 
-    /* Pointer to current buffer in twin_candidate->paranoid->buffers */
-    GSList *twin_candidate_buffer;
-    GSList *rejects;
+    /* bit i is set while twin_candidates[i] still matches; a cleared bit
+     * marks a known mismatch */
+    guint32 twin_matches;
 
     /* Optional: incoming queue for additional twin candidate RmDigest's */
     GAsyncQueue *incoming_twin_candidates;
 } RmParanoid;
 
+/* Leaf size of digests which can be hashed in leaves (see
+ * rm_digest_has_leaves()).  The checksum only depends on the data, not on how
+ * it was split into increments or buffers. */
+#define RM_DIGEST_TREE_LEAF_SIZE (1024 * 1024)
+
+/* One leaf of a digest, hashed apart from the digest (i.e. in another
+ * thread) by rm_digest_leaf_hash() */
+typedef struct RmDigestLeaf {
+    RmDigestType type;
+
+    /* offset of the leaf in the digest's input */
+    guint64 offset;
+
+    /* RmBuffers holding the leaf data, in order */
+    GQueue buffers;
+    gsize len;
+
+    /* result; valid once done is set */
+    guint8 hash[BLAKE2B_OUTBYTES];
+    gboolean done;
+    GMutex lock;
+    GCond cond;
+} RmDigestLeaf;
+
+typedef struct RmDigestTree {
+    /* hashes the leaf hashes, in order */
+    blake2b_state root;
+
+    /* the current leaf if data is hashed sequentially */
+    blake2b_state leaf;
+    gsize leaf_len;
+
+    /* number of bytes hashed so far */
+    guint64 len;
+} RmDigestTree;
+
 typedef struct RmDigest {
     /* Different storage structures are used depending on digest type: */
     gpointer state;
@@ -109,6 +159,15 @@ typedef struct RmDigest {
     /* digest output size in bytes */
     gsize bytes;
 
+    /* The following belong to the reader of digests with leaves, which may
+     * run ahead of the hashing: the number of bytes sent for hashing so far
+     * and the leaf being gathered (see rm_hasher) */
+    guint64 sent;
+    RmDigestLeaf *gathering;
+
+    /* set if the file was truncated while being hashed from a mapping (refer
+     * rm_buffer_mapping_new()); the digest is then worthless */
+    volatile sig_atomic_t truncated;
 } RmDigest;
 
 typedef struct RmSemaphore {
@@ -145,6 +204,15 @@ void rm_semaphore_release(RmSemaphore *sem);
 
 /////////// RmBuffer ////////////////
 
+/* Pool of aligned data blocks, e.g. for O_DIRECT reads; see rm_buffer_pool_new() */
+typedef struct RmBufferPool RmBufferPool;
+
+/* Reference counted mmap(2)ed region; see rm_buffer_mapping_new() */
+typedef struct RmBufferMapping RmBufferMapping;
+
+/* Scratch file for paranoid digests; see rm_digest_paranoid_spill_open() */
+typedef struct RmSpill RmSpill;
+
 /* Represents one block of read data */
 typedef struct RmBuffer {
     /* note that first (sizeof(pointer)) bytes of this structure get overwritten
@@ -165,12 +233,124 @@ typedef struct RmBuffer {
 
     /* pointer to the data block */
     unsigned char *data;
+
+    /* pool the data block came from, or NULL if allocated via g_slice */
+    RmBufferPool *pool;
+
+    /* if non-NULL, data points into this mapping and is not owned by the buffer */
+    RmBufferMapping *mapping;
+
+    /* if non-NULL, this buffer has no data but stands in for a leaf of a
+     * RM_DIGEST_BLAKE2B_TREE which is hashed elsewhere */
+    RmDigestLeaf *leaf;
+
+    /* if non-NULL, data has been moved to slot spill_slot of this scratch file */
+    RmSpill *spill;
+    guint64 spill_slot;
+
+    /* if set, data points to the shared block of zeros (see rm_buffer_new_zeros()) */
+    gboolean zeros;
 } RmBuffer;
 
+/* Max. length of a buffer from rm_buffer_new_zeros() */
+#define RM_BUFFER_ZEROS_LEN (RM_DIGEST_TREE_LEAF_SIZE)
+
 RmBuffer *rm_buffer_new(RmSemaphore *sem, gsize buf_size);
 
+/**
+ * @brief Allocate a new pool of data blocks of buf_size bytes, each aligned
+ * to alignment bytes (which must be a power of two).
+ *
+ * The pool is reference counted; each buffer taken from it holds a reference,
+ * so it is safe to rm_buffer_pool_unref() the pool while buffers are still
+ * in use (e.g. by paranoid digests).
+ */
+RmBufferPool *rm_buffer_pool_new(gsize buf_size, gsize alignment);
+
+/**
+ * @brief Drop a reference to the pool; frees it once no buffers are left.
+ */
+void rm_buffer_pool_unref(RmBufferPool *pool);
+
+/**
+ * @brief Like rm_buffer_new() but take the data block from pool.
+ * Buffers are returned to the pool by rm_buffer_free().
+ */
+RmBuffer *rm_buffer_new_from_pool(RmSemaphore *sem, RmBufferPool *pool);
+
+/**
+ * @brief Wrap a region returned by mmap(2) whose data is for digest.  The
+ * region is unmapped once the last reference (the caller's plus one per
+ * buffer) is dropped.
+ *
+ * If the file shrinks while mapped, the missing pages read as zeros and
+ * digest->truncated is set instead of the process being killed by SIGBUS.
+ *
+ * @retval NULL if too many regions are mapped already.
+ */
+RmBufferMapping *rm_buffer_mapping_new(gpointer addr, gsize len, RmDigest *digest);
+
+/**
+ * @brief Drop a reference to the mapping.
+ */
+void rm_buffer_mapping_unref(RmBufferMapping *mapping);
+
+/**
+ * @brief Create a buffer referring to len bytes at offset within mapping,
+ * without copying them.  rm_buffer_free() drops the buffer's reference.
+ *
+ * Not suitable for paranoid digests, which keep their buffers around.
+ */
+RmBuffer *rm_buffer_new_mapped(RmSemaphore *sem,
+                               RmBufferMapping *mapping,
+                               gsize offset,
+                               gsize len);
+
+/**
+ * @brief Create a placeholder buffer for leaf.  When passed to
+ * rm_digest_buffered_update() it waits for the leaf to be hashed and then adds
+ * the result to buffer->digest.  Frees the leaf.
+ */
+RmBuffer *rm_buffer_new_leaf(RmSemaphore *sem, RmDigestLeaf *leaf);
+
+/**
+ * @brief Create a buffer of len (<= RM_BUFFER_ZEROS_LEN) zero bytes, e.g. for a
+ * hole of a sparse file.  All such buffers share one read-only block of data.
+ */
+RmBuffer *rm_buffer_new_zeros(RmSemaphore *sem, gsize len);
+
 void rm_buffer_free(RmSemaphore *sem, RmBuffer *buf);
 
+/**
+ * @brief Can digests of this type be hashed in leaves of
+ * RM_DIGEST_TREE_LEAF_SIZE (see rm_buffer_new_leaf())?
+ */
+gboolean rm_digest_has_leaves(RmDigestType type);
+
+/**
+ * @brief Allocate a new (empty) leaf for the data of digest starting at
+ * digest->sent, which must be a multiple of RM_DIGEST_TREE_LEAF_SIZE.
+ * Add data to it by pushing RmBuffers onto leaf->buffers.
+ */
+RmDigestLeaf *rm_digest_leaf_new(RmDigest *digest);
+
+/**
+ * @brief Like rm_digest_leaf_new(), but for a leaf of zeros which is hashed
+ * already (without looking at the zeros).  Returns NULL for digest types
+ * whose leaf hash depends on the position of the leaf.
+ */
+RmDigestLeaf *rm_digest_leaf_new_zeros(RmDigest *digest);
+
+/**
+ * @brief Free a leaf which was not hashed; its buffers must have been taken.
+ */
+void rm_digest_leaf_free(RmDigestLeaf *leaf);
+
+/**
+ * @brief Hash all buffers of leaf (and free them); may be called from any thread.
+ */
+void rm_digest_leaf_hash(RmDigestLeaf *leaf, RmSemaphore *sem);
+
 /**
  * @brief Convert a string like "md5" to a RmDigestType member.
  *
@@ -189,6 +369,13 @@ RmDigestType rm_string_to_digest_type(const char *string);
  */
 const char *rm_digest_type_to_string(RmDigestType type);
 
+/**
+ * @brief Name of the kernel that hashes bulk data for `type`.
+ *
+ * @return "portable", "sse4.1", "sse4.2", "avx2" or "avx512".
+ */
+const char *rm_digest_kernel_name(RmDigestType type);
+
 /**
  * @brief Allocate and initialise a RmDigest.
  *
@@ -305,8 +492,42 @@ void rm_digest_release_buffers(RmDigest *digest);
 void rm_digest_send_match_candidate(RmDigest *target, RmDigest *candidate);
 
 /**
- * @brief Enable or disable SSE optimisations.
- * @note will also check __builtin_cpu_supports("sse4.2") before enabling
+ * @brief Make paranoid digests move the data of their buffers into an unlinked
+ * scratch file in dir, which is mmap(2)ed, so that it is held by the page cache
+ * (and written out under memory pressure) rather than by the heap.
+ *
+ * @return FALSE if the scratch file could not be created; paranoid digests then
+ * keep their buffers in memory.
+ */
+gboolean rm_digest_paranoid_spill_open(const char *dir);
+
+/**
+ * @brief Stop spilling paranoid buffers.  The scratch file is closed once the
+ * last buffer in it has been freed.
+ *
+ * @return the size the scratch file grew to.
+ */
+guint64 rm_digest_paranoid_spill_close(void);
+
+typedef struct RmDigestPoolStats {
+    /* digests allocated from the pools so far */
+    guint64 n_digests;
+
+    /* heap allocations that the pools made for them, and their size */
+    guint64 n_slabs;
+    guint64 slab_bytes;
+} RmDigestPoolStats;
+
+/**
+ * @brief Get statistics about the pools that digests with a flat state are
+ * allocated from.
+ */
+void rm_digest_pool_stats(RmDigestPoolStats *stats);
+
+/**
+ * @brief Enable or disable the SIMD hash kernels.
+ * @note The CPU is probed once (see checksums/simd.h); with use_sse each
+ * algorithm uses the widest kernel that the CPU supports.
  */
 void rm_digest_enable_sse(gboolean use_sse);
 
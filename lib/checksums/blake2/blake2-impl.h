@@ -125,4 +125,13 @@ static INLINE void secure_zero_memory(void *v, size_t n) {
     memset_v(v, 0, n);
 }
 
+#include "../simd.h"
+#include "blake2.h"
+
+#if RM_SIMD_X86
+/* SIMD compression functions; the reference code picks them at runtime */
+void blake2b_compress_avx2(blake2b_state *S, const uint8_t block[BLAKE2B_BLOCKBYTES]);
+void blake2s_compress_sse41(blake2s_state *S, const uint8_t block[BLAKE2S_BLOCKBYTES]);
+#endif
+
 #endif
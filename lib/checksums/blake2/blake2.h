@@ -143,6 +143,10 @@ int blake2b_init_param(blake2b_state *S, const blake2b_param *P);
 int blake2b_update(blake2b_state *S, const void *in, size_t inlen);
 int blake2b_final(blake2b_state *S, void *out, size_t outlen);
 
+/* Name of the compression kernel selected at runtime */
+const char *blake2s_kernel_name(void);
+const char *blake2b_kernel_name(void);
+
 int blake2sp_init(blake2sp_state *S, size_t outlen);
 int blake2sp_init_key(blake2sp_state *S, size_t outlen, const void *key, size_t keylen);
 int blake2sp_update(blake2sp_state *S, const void *in, size_t inlen);
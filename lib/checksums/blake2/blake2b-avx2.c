@@ -0,0 +1,108 @@
+/*
+ * BLAKE2b compression with AVX2: each row of the 4x4 state is one __m256i,
+ * the four G functions of a column (or diagonal) step run side by side.
+ */
+
+#include "blake2-impl.h"
+
+#if RM_SIMD_X86
+
+#include <immintrin.h>
+
+#define TARGET __attribute__((target("avx2")))
+
+static const uint64_t blake2b_avx2_IV[8] = {
+    0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL, 0x3c6ef372fe94f82bULL,
+    0xa54ff53a5f1d36f1ULL, 0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL,
+    0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL};
+
+static const uint8_t blake2b_avx2_sigma[12][16] = {
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+    {14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3},
+    {11, 8, 12, 0, 5, 2, 15, 13, 10, 14, 3, 6, 7, 1, 9, 4},
+    {7, 9, 3, 1, 13, 12, 11, 14, 2, 6, 5, 10, 4, 0, 15, 8},
+    {9, 0, 5, 7, 2, 4, 10, 15, 14, 1, 11, 12, 6, 8, 3, 13},
+    {2, 12, 6, 10, 0, 11, 8, 3, 4, 13, 7, 5, 15, 14, 1, 9},
+    {12, 5, 1, 15, 14, 13, 4, 10, 0, 7, 6, 3, 9, 2, 8, 11},
+    {13, 11, 7, 14, 12, 1, 3, 9, 5, 0, 15, 4, 8, 6, 2, 10},
+    {6, 15, 14, 9, 11, 3, 0, 8, 12, 2, 13, 7, 1, 4, 10, 5},
+    {10, 2, 8, 4, 7, 6, 1, 5, 15, 11, 9, 14, 3, 12, 13, 0},
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+    {14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3}};
+
+TARGET static inline __m256i vrotr32(__m256i x) {
+    return _mm256_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1));
+}
+
+TARGET static inline __m256i vrotr24(__m256i x) {
+    return _mm256_shuffle_epi8(
+        x, _mm256_setr_epi8(3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10, 3, 4,
+                            5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10));
+}
+
+TARGET static inline __m256i vrotr16(__m256i x) {
+    return _mm256_shuffle_epi8(
+        x, _mm256_setr_epi8(2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9, 2, 3,
+                            4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9));
+}
+
+TARGET static inline __m256i vrotr63(__m256i x) {
+    return _mm256_or_si256(_mm256_srli_epi64(x, 63), _mm256_add_epi64(x, x));
+}
+
+TARGET static inline void g(__m256i *a, __m256i *b, __m256i *c, __m256i *d, __m256i x,
+                            __m256i y) {
+    *a = _mm256_add_epi64(_mm256_add_epi64(*a, *b), x);
+    *d = vrotr32(_mm256_xor_si256(*d, *a));
+    *c = _mm256_add_epi64(*c, *d);
+    *b = vrotr24(_mm256_xor_si256(*b, *c));
+    *a = _mm256_add_epi64(_mm256_add_epi64(*a, *b), y);
+    *d = vrotr16(_mm256_xor_si256(*d, *a));
+    *c = _mm256_add_epi64(*c, *d);
+    *b = vrotr63(_mm256_xor_si256(*b, *c));
+}
+
+TARGET static inline __m256i msg(const uint64_t m[16], const uint8_t *s, int i) {
+    return _mm256_set_epi64x((long long)m[s[i + 6]], (long long)m[s[i + 4]],
+                             (long long)m[s[i + 2]], (long long)m[s[i]]);
+}
+
+TARGET void blake2b_compress_avx2(blake2b_state *S,
+                                  const uint8_t block[BLAKE2B_BLOCKBYTES]) {
+    uint64_t m[16];
+    for(size_t i = 0; i < 16; ++i) {
+        m[i] = load64(block + i * sizeof(m[i]));
+    }
+
+    const __m256i h0 = _mm256_loadu_si256((const __m256i *)&S->h[0]);
+    const __m256i h1 = _mm256_loadu_si256((const __m256i *)&S->h[4]);
+
+    __m256i a = h0;
+    __m256i b = h1;
+    __m256i c = _mm256_loadu_si256((const __m256i *)&blake2b_avx2_IV[0]);
+    __m256i d = _mm256_xor_si256(
+        _mm256_loadu_si256((const __m256i *)&blake2b_avx2_IV[4]),
+        _mm256_set_epi64x((long long)S->f[1], (long long)S->f[0], (long long)S->t[1],
+                          (long long)S->t[0]));
+
+    for(size_t r = 0; r < 12; ++r) {
+        const uint8_t *s = blake2b_avx2_sigma[r];
+
+        /* columns */
+        g(&a, &b, &c, &d, msg(m, s, 0), msg(m, s, 1));
+
+        /* diagonals: rotate rows 1-3 so that the diagonals line up */
+        b = _mm256_permute4x64_epi64(b, _MM_SHUFFLE(0, 3, 2, 1));
+        c = _mm256_permute4x64_epi64(c, _MM_SHUFFLE(1, 0, 3, 2));
+        d = _mm256_permute4x64_epi64(d, _MM_SHUFFLE(2, 1, 0, 3));
+        g(&a, &b, &c, &d, msg(m, s, 8), msg(m, s, 9));
+        b = _mm256_permute4x64_epi64(b, _MM_SHUFFLE(2, 1, 0, 3));
+        c = _mm256_permute4x64_epi64(c, _MM_SHUFFLE(1, 0, 3, 2));
+        d = _mm256_permute4x64_epi64(d, _MM_SHUFFLE(0, 3, 2, 1));
+    }
+
+    _mm256_storeu_si256((__m256i *)&S->h[0], _mm256_xor_si256(h0, _mm256_xor_si256(a, c)));
+    _mm256_storeu_si256((__m256i *)&S->h[4], _mm256_xor_si256(h1, _mm256_xor_si256(b, d)));
+}
+
+#endif /* RM_SIMD_X86 */
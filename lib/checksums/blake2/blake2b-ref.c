@@ -163,7 +163,8 @@ int blake2b_init_key(blake2b_state *S, size_t outlen, const void *key, size_t ke
         G(r, 7, v[3], v[4], v[9], v[14]);  \
     } while(0)
 
-static void blake2b_compress(blake2b_state *S, const uint8_t block[BLAKE2B_BLOCKBYTES]) {
+static void blake2b_compress_ref(blake2b_state *S,
+                                const uint8_t block[BLAKE2B_BLOCKBYTES]) {
     uint64_t m[16];
     uint64_t v[16];
     size_t i;
@@ -206,6 +207,25 @@ static void blake2b_compress(blake2b_state *S, const uint8_t block[BLAKE2B_BLOCK
 #undef G
 #undef ROUND
 
+static void blake2b_compress(blake2b_state *S, const uint8_t block[BLAKE2B_BLOCKBYTES]) {
+#if RM_SIMD_X86
+    if(rm_simd_level() >= RM_SIMD_AVX2) {
+        blake2b_compress_avx2(S, block);
+        return;
+    }
+#endif
+    blake2b_compress_ref(S, block);
+}
+
+const char *blake2b_kernel_name(void) {
+#if RM_SIMD_X86
+    if(rm_simd_level() >= RM_SIMD_AVX2) {
+        return rm_simd_level_name(RM_SIMD_AVX2);
+    }
+#endif
+    return rm_simd_level_name(RM_SIMD_NONE);
+}
+
 int blake2b_update(blake2b_state *S, const void *pin, size_t inlen) {
     const unsigned char *in = (const unsigned char *)pin;
     if(inlen > 0) {
@@ -163,7 +163,8 @@ int blake2s_init_key(blake2s_state *S, size_t outlen, const void *key, size_t ke
         G(r, 7, v[3], v[4], v[9], v[14]);  \
     } while(0)
 
-static void blake2s_compress(blake2s_state *S, const uint8_t in[BLAKE2S_BLOCKBYTES]) {
+static void blake2s_compress_ref(blake2s_state *S,
+                                const uint8_t in[BLAKE2S_BLOCKBYTES]) {
     uint32_t m[16];
     uint32_t v[16];
     size_t i;
@@ -204,6 +205,25 @@ static void blake2s_compress(blake2s_state *S, const uint8_t in[BLAKE2S_BLOCKBYT
 #undef G
 #undef ROUND
 
+static void blake2s_compress(blake2s_state *S, const uint8_t in[BLAKE2S_BLOCKBYTES]) {
+#if RM_SIMD_X86
+    if(rm_simd_level() >= RM_SIMD_SSE41) {
+        blake2s_compress_sse41(S, in);
+        return;
+    }
+#endif
+    blake2s_compress_ref(S, in);
+}
+
+const char *blake2s_kernel_name(void) {
+#if RM_SIMD_X86
+    if(rm_simd_level() >= RM_SIMD_SSE41) {
+        return rm_simd_level_name(RM_SIMD_SSE41);
+    }
+#endif
+    return rm_simd_level_name(RM_SIMD_NONE);
+}
+
 int blake2s_update(blake2s_state *S, const void *pin, size_t inlen) {
     const unsigned char *in = (const unsigned char *)pin;
     if(inlen > 0) {
@@ -0,0 +1,103 @@
+/*
+ * BLAKE2s compression with SSE4.1: each row of the 4x4 state is one __m128i,
+ * the four G functions of a column (or diagonal) step run side by side.
+ */
+
+#include "blake2-impl.h"
+
+#if RM_SIMD_X86
+
+#include <immintrin.h>
+
+#define TARGET __attribute__((target("sse4.1")))
+
+static const uint32_t blake2s_sse41_IV[8] = {0x6A09E667UL, 0xBB67AE85UL, 0x3C6EF372UL,
+                                             0xA54FF53AUL, 0x510E527FUL, 0x9B05688CUL,
+                                             0x1F83D9ABUL, 0x5BE0CD19UL};
+
+static const uint8_t blake2s_sse41_sigma[10][16] = {
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+    {14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3},
+    {11, 8, 12, 0, 5, 2, 15, 13, 10, 14, 3, 6, 7, 1, 9, 4},
+    {7, 9, 3, 1, 13, 12, 11, 14, 2, 6, 5, 10, 4, 0, 15, 8},
+    {9, 0, 5, 7, 2, 4, 10, 15, 14, 1, 11, 12, 6, 8, 3, 13},
+    {2, 12, 6, 10, 0, 11, 8, 3, 4, 13, 7, 5, 15, 14, 1, 9},
+    {12, 5, 1, 15, 14, 13, 4, 10, 0, 7, 6, 3, 9, 2, 8, 11},
+    {13, 11, 7, 14, 12, 1, 3, 9, 5, 0, 15, 4, 8, 6, 2, 10},
+    {6, 15, 14, 9, 11, 3, 0, 8, 12, 2, 13, 7, 1, 4, 10, 5},
+    {10, 2, 8, 4, 7, 6, 1, 5, 15, 11, 9, 14, 3, 12, 13, 0},
+};
+
+TARGET static inline __m128i vrotr16(__m128i x) {
+    return _mm_shuffle_epi8(
+        x, _mm_setr_epi8(2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13));
+}
+
+TARGET static inline __m128i vrotr12(__m128i x) {
+    return _mm_or_si128(_mm_srli_epi32(x, 12), _mm_slli_epi32(x, 32 - 12));
+}
+
+TARGET static inline __m128i vrotr8(__m128i x) {
+    return _mm_shuffle_epi8(
+        x, _mm_setr_epi8(1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12));
+}
+
+TARGET static inline __m128i vrotr7(__m128i x) {
+    return _mm_or_si128(_mm_srli_epi32(x, 7), _mm_slli_epi32(x, 32 - 7));
+}
+
+TARGET static inline void g(__m128i *a, __m128i *b, __m128i *c, __m128i *d, __m128i x,
+                            __m128i y) {
+    *a = _mm_add_epi32(_mm_add_epi32(*a, *b), x);
+    *d = vrotr16(_mm_xor_si128(*d, *a));
+    *c = _mm_add_epi32(*c, *d);
+    *b = vrotr12(_mm_xor_si128(*b, *c));
+    *a = _mm_add_epi32(_mm_add_epi32(*a, *b), y);
+    *d = vrotr8(_mm_xor_si128(*d, *a));
+    *c = _mm_add_epi32(*c, *d);
+    *b = vrotr7(_mm_xor_si128(*b, *c));
+}
+
+TARGET static inline __m128i msg(const uint32_t m[16], const uint8_t *s, int i) {
+    return _mm_set_epi32((int)m[s[i + 6]], (int)m[s[i + 4]], (int)m[s[i + 2]],
+                         (int)m[s[i]]);
+}
+
+TARGET void blake2s_compress_sse41(blake2s_state *S,
+                                   const uint8_t block[BLAKE2S_BLOCKBYTES]) {
+    uint32_t m[16];
+    for(size_t i = 0; i < 16; ++i) {
+        m[i] = load32(block + i * sizeof(m[i]));
+    }
+
+    const __m128i h0 = _mm_loadu_si128((const __m128i *)&S->h[0]);
+    const __m128i h1 = _mm_loadu_si128((const __m128i *)&S->h[4]);
+
+    __m128i a = h0;
+    __m128i b = h1;
+    __m128i c = _mm_loadu_si128((const __m128i *)&blake2s_sse41_IV[0]);
+    __m128i d = _mm_xor_si128(_mm_loadu_si128((const __m128i *)&blake2s_sse41_IV[4]),
+                              _mm_set_epi32((int)S->f[1], (int)S->f[0], (int)S->t[1],
+                                            (int)S->t[0]));
+
+    for(size_t r = 0; r < 10; ++r) {
+        const uint8_t *s = blake2s_sse41_sigma[r];
+
+        /* columns */
+        g(&a, &b, &c, &d, msg(m, s, 0), msg(m, s, 1));
+
+        /* diagonals: rotate rows 1-3 so that the diagonals line up */
+        b = _mm_shuffle_epi32(b, _MM_SHUFFLE(0, 3, 2, 1));
+        c = _mm_shuffle_epi32(c, _MM_SHUFFLE(1, 0, 3, 2));
+        d = _mm_shuffle_epi32(d, _MM_SHUFFLE(2, 1, 0, 3));
+        g(&a, &b, &c, &d, msg(m, s, 8), msg(m, s, 9));
+        b = _mm_shuffle_epi32(b, _MM_SHUFFLE(2, 1, 0, 3));
+        c = _mm_shuffle_epi32(c, _MM_SHUFFLE(1, 0, 3, 2));
+        d = _mm_shuffle_epi32(d, _MM_SHUFFLE(0, 3, 2, 1));
+    }
+
+    _mm_storeu_si128((__m128i *)&S->h[0], _mm_xor_si128(h0, _mm_xor_si128(a, c)));
+    _mm_storeu_si128((__m128i *)&S->h[4], _mm_xor_si128(h1, _mm_xor_si128(b, d)));
+}
+
+#endif /* RM_SIMD_X86 */
@@ -0,0 +1,430 @@
+/*
+ * BLAKE3 hasher and portable compression function; see blake3.h.
+ */
+
+#include "blake3_impl.h"
+
+//////////////////////////////
+//  Compression function    //
+//////////////////////////////
+
+static inline uint32_t rotr32(uint32_t w, uint32_t c) {
+    return (w >> c) | (w << (32 - c));
+}
+
+static inline void g(uint32_t *state, size_t a, size_t b, size_t c, size_t d,
+                     uint32_t x, uint32_t y) {
+    state[a] = state[a] + state[b] + x;
+    state[d] = rotr32(state[d] ^ state[a], 16);
+    state[c] = state[c] + state[d];
+    state[b] = rotr32(state[b] ^ state[c], 12);
+    state[a] = state[a] + state[b] + y;
+    state[d] = rotr32(state[d] ^ state[a], 8);
+    state[c] = state[c] + state[d];
+    state[b] = rotr32(state[b] ^ state[c], 7);
+}
+
+static inline void round_fn(uint32_t state[16], const uint32_t *msg, size_t round) {
+    const uint8_t *schedule = BLAKE3_MSG_SCHEDULE[round];
+
+    /* mix the columns */
+    g(state, 0, 4, 8, 12, msg[schedule[0]], msg[schedule[1]]);
+    g(state, 1, 5, 9, 13, msg[schedule[2]], msg[schedule[3]]);
+    g(state, 2, 6, 10, 14, msg[schedule[4]], msg[schedule[5]]);
+    g(state, 3, 7, 11, 15, msg[schedule[6]], msg[schedule[7]]);
+
+    /* mix the diagonals */
+    g(state, 0, 5, 10, 15, msg[schedule[8]], msg[schedule[9]]);
+    g(state, 1, 6, 11, 12, msg[schedule[10]], msg[schedule[11]]);
+    g(state, 2, 7, 8, 13, msg[schedule[12]], msg[schedule[13]]);
+    g(state, 3, 4, 9, 14, msg[schedule[14]], msg[schedule[15]]);
+}
+
+static inline void compress_pre(uint32_t state[16], const uint32_t cv[8],
+                                const uint8_t block[BLAKE3_BLOCK_LEN],
+                                uint8_t block_len, uint64_t counter, uint8_t flags) {
+    uint32_t block_words[16];
+    for(int i = 0; i < 16; i++) {
+        block_words[i] = blake3_load32(block + 4 * i);
+    }
+
+    memcpy(state, cv, 8 * sizeof(uint32_t));
+    memcpy(state + 8, BLAKE3_IV, 4 * sizeof(uint32_t));
+    state[12] = blake3_counter_low(counter);
+    state[13] = blake3_counter_high(counter);
+    state[14] = (uint32_t)block_len;
+    state[15] = (uint32_t)flags;
+
+    for(size_t round = 0; round < 7; round++) {
+        round_fn(state, block_words, round);
+    }
+}
+
+void blake3_compress_in_place_portable(uint32_t cv[8],
+                                       const uint8_t block[BLAKE3_BLOCK_LEN],
+                                       uint8_t block_len, uint64_t counter,
+                                       uint8_t flags) {
+    uint32_t state[16];
+    compress_pre(state, cv, block, block_len, counter, flags);
+    for(int i = 0; i < 8; i++) {
+        cv[i] = state[i] ^ state[i + 8];
+    }
+}
+
+void blake3_compress_xof_portable(const uint32_t cv[8],
+                                  const uint8_t block[BLAKE3_BLOCK_LEN],
+                                  uint8_t block_len, uint64_t counter, uint8_t flags,
+                                  uint8_t out[64]) {
+    uint32_t state[16];
+    compress_pre(state, cv, block, block_len, counter, flags);
+    for(int i = 0; i < 8; i++) {
+        blake3_store32(&out[4 * i], state[i] ^ state[i + 8]);
+        blake3_store32(&out[4 * (i + 8)], state[i + 8] ^ cv[i]);
+    }
+}
+
+void blake3_hash_chunks_portable(const uint8_t *input, size_t n_chunks,
+                                 const uint32_t key[8], uint64_t counter,
+                                 uint8_t flags, uint8_t *out) {
+    for(size_t i = 0; i < n_chunks; i++) {
+        uint32_t cv[8];
+        memcpy(cv, key, sizeof(cv));
+
+        const uint8_t *chunk = input + i * BLAKE3_CHUNK_LEN;
+        for(size_t b = 0; b < BLAKE3_CHUNK_LEN / BLAKE3_BLOCK_LEN; b++) {
+            uint8_t block_flags = flags;
+            if(b == 0) {
+                block_flags |= CHUNK_START;
+            }
+            if(b == BLAKE3_CHUNK_LEN / BLAKE3_BLOCK_LEN - 1) {
+                block_flags |= CHUNK_END;
+            }
+            blake3_compress_in_place_portable(cv, chunk + b * BLAKE3_BLOCK_LEN,
+                                              BLAKE3_BLOCK_LEN, counter + i,
+                                              block_flags);
+        }
+        blake3_store_cv(out + i * BLAKE3_OUT_LEN, cv);
+    }
+}
+
+//////////////////////////////
+//  Kernel selection        //
+//////////////////////////////
+
+const char *blake3_simd_name(void) {
+#if BLAKE3_USE_X86
+    return rm_simd_level_name(rm_simd_level());
+#else
+    return rm_simd_level_name(RM_SIMD_NONE);
+#endif
+}
+
+/* Hash n_chunks whole chunks using the widest kernels available */
+static void hash_chunks(const uint8_t *input, size_t n_chunks, const uint32_t key[8],
+                        uint64_t counter, uint8_t flags, uint8_t *out) {
+#if BLAKE3_USE_X86
+    RmSimdLevel simd = rm_simd_level();
+
+#define HASH_CHUNKS_WITH(KERNEL, DEGREE)                       \
+    while(n_chunks >= DEGREE) {                                \
+        blake3_hash_chunks_##KERNEL(input, key, counter, flags, out); \
+        input += DEGREE * BLAKE3_CHUNK_LEN;                    \
+        out += DEGREE * BLAKE3_OUT_LEN;                        \
+        counter += DEGREE;                                     \
+        n_chunks -= DEGREE;                                    \
+    }
+
+    if(simd >= RM_SIMD_AVX512) {
+        HASH_CHUNKS_WITH(avx512, BLAKE3_AVX512_DEGREE);
+    }
+    if(simd >= RM_SIMD_AVX2) {
+        HASH_CHUNKS_WITH(avx2, BLAKE3_AVX2_DEGREE);
+    }
+    if(simd >= RM_SIMD_SSE41) {
+        HASH_CHUNKS_WITH(sse41, BLAKE3_SSE41_DEGREE);
+    }
+
+#undef HASH_CHUNKS_WITH
+#endif
+    blake3_hash_chunks_portable(input, n_chunks, key, counter, flags, out);
+}
+
+//////////////////////////////
+//  Chunk state             //
+//////////////////////////////
+
+static void chunk_state_init(blake3_chunk_state *self, const uint32_t key[8],
+                             uint64_t chunk_counter) {
+    memcpy(self->cv, key, sizeof(self->cv));
+    self->chunk_counter = chunk_counter;
+    memset(self->buf, 0, BLAKE3_BLOCK_LEN);
+    self->buf_len = 0;
+    self->blocks_compressed = 0;
+    self->flags = 0;
+}
+
+static size_t chunk_state_len(const blake3_chunk_state *self) {
+    return (BLAKE3_BLOCK_LEN * (size_t)self->blocks_compressed) + (size_t)self->buf_len;
+}
+
+static uint8_t chunk_state_start_flag(const blake3_chunk_state *self) {
+    return self->blocks_compressed == 0 ? CHUNK_START : 0;
+}
+
+static void chunk_state_update(blake3_chunk_state *self, const uint8_t *input,
+                               size_t input_len) {
+    while(input_len > 0) {
+        /* only compress a full buffer once more input arrives, since the last
+         * block of the chunk needs CHUNK_END */
+        if(self->buf_len == BLAKE3_BLOCK_LEN) {
+            blake3_compress_in_place_portable(self->cv, self->buf, BLAKE3_BLOCK_LEN,
+                                              self->chunk_counter,
+                                              self->flags | chunk_state_start_flag(self));
+            self->blocks_compressed += 1;
+            self->buf_len = 0;
+            memset(self->buf, 0, BLAKE3_BLOCK_LEN);
+        }
+
+        size_t take = BLAKE3_BLOCK_LEN - (size_t)self->buf_len;
+        if(take > input_len) {
+            take = input_len;
+        }
+        memcpy(self->buf + self->buf_len, input, take);
+        self->buf_len += (uint8_t)take;
+        input += take;
+        input_len -= take;
+    }
+}
+
+/* The last compression of a chunk or parent, kept back until we know if it is
+ * the root */
+typedef struct {
+    uint32_t input_cv[8];
+    uint64_t counter;
+    uint8_t block[BLAKE3_BLOCK_LEN];
+    uint8_t block_len;
+    uint8_t flags;
+} output_t;
+
+static output_t make_output(const uint32_t input_cv[8],
+                            const uint8_t block[BLAKE3_BLOCK_LEN], uint8_t block_len,
+                            uint64_t counter, uint8_t flags) {
+    output_t ret;
+    memcpy(ret.input_cv, input_cv, sizeof(ret.input_cv));
+    memcpy(ret.block, block, BLAKE3_BLOCK_LEN);
+    ret.block_len = block_len;
+    ret.counter = counter;
+    ret.flags = flags;
+    return ret;
+}
+
+static void output_chaining_value(const output_t *self, uint8_t cv[BLAKE3_OUT_LEN]) {
+    uint32_t cv_words[8];
+    memcpy(cv_words, self->input_cv, sizeof(cv_words));
+    blake3_compress_in_place_portable(cv_words, self->block, self->block_len,
+                                      self->counter, self->flags);
+    blake3_store_cv(cv, cv_words);
+}
+
+static void output_root_bytes(const output_t *self, uint8_t *out, size_t out_len) {
+    uint64_t output_block_counter = 0;
+    uint8_t wide_buf[64];
+    while(out_len > 0) {
+        blake3_compress_xof_portable(self->input_cv, self->block, self->block_len,
+                                     output_block_counter, self->flags | ROOT,
+                                     wide_buf);
+        size_t take = out_len < sizeof(wide_buf) ? out_len : sizeof(wide_buf);
+        memcpy(out, wide_buf, take);
+        out += take;
+        out_len -= take;
+        output_block_counter += 1;
+    }
+}
+
+static output_t chunk_state_output(const blake3_chunk_state *self) {
+    uint8_t block_flags = self->flags | chunk_state_start_flag(self) | CHUNK_END;
+    return make_output(self->cv, self->buf, self->buf_len, self->chunk_counter,
+                       block_flags);
+}
+
+static output_t parent_output(const uint8_t block[BLAKE3_BLOCK_LEN],
+                              const uint32_t key[8], uint8_t flags) {
+    return make_output(key, block, BLAKE3_BLOCK_LEN, 0, flags | PARENT);
+}
+
+//////////////////////////////
+//  Hasher                  //
+//////////////////////////////
+
+static void hasher_init_base(blake3_hasher *self, uint64_t chunk_counter) {
+    memcpy(self->key, BLAKE3_IV, sizeof(self->key));
+    chunk_state_init(&self->chunk, self->key, chunk_counter);
+    self->base_chunk = chunk_counter;
+    self->eager = false;
+    self->cv_stack_len = 0;
+}
+
+void blake3_hasher_init(blake3_hasher *self) {
+    hasher_init_base(self, 0);
+}
+
+void blake3_hasher_init_subtree(blake3_hasher *self, uint64_t chunk_counter) {
+    hasher_init_base(self, chunk_counter);
+    self->eager = true;
+}
+
+static void hasher_merge_parent(blake3_hasher *self) {
+    size_t parent_offset = (self->cv_stack_len - 2) * BLAKE3_OUT_LEN;
+    output_t output =
+        parent_output(&self->cv_stack[parent_offset], self->key, self->chunk.flags);
+    output_chaining_value(&output, &self->cv_stack[parent_offset]);
+    self->cv_stack_len -= 1;
+}
+
+/* Merge completed subtrees, except for the last one, which might still become
+ * the root: after chunk_counter chunks there is one CV on the stack per set
+ * bit.  Merging lazily lets blake3_hasher_finalize() set ROOT on the right
+ * compression. */
+static void hasher_merge_cv_stack(blake3_hasher *self, uint64_t chunk_counter) {
+    size_t post_merge_stack_len =
+        (size_t)__builtin_popcountll(chunk_counter - self->base_chunk);
+    while(self->cv_stack_len > post_merge_stack_len) {
+        hasher_merge_parent(self);
+    }
+}
+
+/* Push the CV of the subtree starting at chunk_counter */
+static void hasher_push_cv(blake3_hasher *self, const uint8_t new_cv[BLAKE3_OUT_LEN],
+                           uint64_t chunk_counter) {
+    hasher_merge_cv_stack(self, chunk_counter);
+    memcpy(&self->cv_stack[self->cv_stack_len * BLAKE3_OUT_LEN], new_cv,
+           BLAKE3_OUT_LEN);
+    self->cv_stack_len += 1;
+}
+
+/* Finish the (full) current chunk, which is known not to be the root */
+static void hasher_finish_chunk(blake3_hasher *self) {
+    output_t output = chunk_state_output(&self->chunk);
+    uint8_t chunk_cv[BLAKE3_OUT_LEN];
+    output_chaining_value(&output, chunk_cv);
+    hasher_push_cv(self, chunk_cv, self->chunk.chunk_counter);
+    chunk_state_init(&self->chunk, self->key, self->chunk.chunk_counter + 1);
+}
+
+/* The chunk which ends the input is kept back (not compressed to a CV) if it
+ * might turn out to be the root.  That is only possible for the very first
+ * chunk: later chunks are merged into parents, and finalize() merges the top
+ * of the stack lazily to set ROOT on the right compression. */
+static bool hasher_keep_back(const blake3_hasher *self) {
+    return !self->eager && self->chunk.chunk_counter == 0;
+}
+
+void blake3_hasher_update(blake3_hasher *self, const void *input, size_t input_len) {
+    const uint8_t *input_bytes = (const uint8_t *)input;
+
+    /* top up a partial chunk first */
+    if(chunk_state_len(&self->chunk) > 0) {
+        size_t take = BLAKE3_CHUNK_LEN - chunk_state_len(&self->chunk);
+        if(take > input_len) {
+            take = input_len;
+        }
+        chunk_state_update(&self->chunk, input_bytes, take);
+        input_bytes += take;
+        input_len -= take;
+
+        if(chunk_state_len(&self->chunk) < BLAKE3_CHUNK_LEN ||
+           (input_len == 0 && hasher_keep_back(self))) {
+            return;
+        }
+        hasher_finish_chunk(self);
+    }
+
+    /* whole chunks go to the SIMD kernels in batches */
+    while(input_len >= BLAKE3_CHUNK_LEN) {
+        if(input_len == BLAKE3_CHUNK_LEN && hasher_keep_back(self)) {
+            break;
+        }
+
+        size_t n_chunks = input_len / BLAKE3_CHUNK_LEN;
+        if(n_chunks > BLAKE3_MAX_SIMD_DEGREE) {
+            n_chunks = BLAKE3_MAX_SIMD_DEGREE;
+        }
+
+        uint8_t cvs[BLAKE3_MAX_SIMD_DEGREE * BLAKE3_OUT_LEN];
+        uint64_t counter = self->chunk.chunk_counter;
+        hash_chunks(input_bytes, n_chunks, self->key, counter, self->chunk.flags, cvs);
+        for(size_t i = 0; i < n_chunks; i++) {
+            hasher_push_cv(self, &cvs[i * BLAKE3_OUT_LEN], counter + i);
+        }
+
+        chunk_state_init(&self->chunk, self->key, counter + n_chunks);
+        input_bytes += n_chunks * BLAKE3_CHUNK_LEN;
+        input_len -= n_chunks * BLAKE3_CHUNK_LEN;
+    }
+
+    if(input_len > 0) {
+        chunk_state_update(&self->chunk, input_bytes, input_len);
+        if(chunk_state_len(&self->chunk) == BLAKE3_CHUNK_LEN && !hasher_keep_back(self)) {
+            hasher_finish_chunk(self);
+        } else {
+            /* finalize() expects everything before this chunk to be merged */
+            hasher_merge_cv_stack(self, self->chunk.chunk_counter);
+        }
+    }
+}
+
+void blake3_hasher_finalize(const blake3_hasher *self, uint8_t *out, size_t out_len) {
+    /* a single chunk is its own root */
+    if(self->cv_stack_len == 0) {
+        output_t output = chunk_state_output(&self->chunk);
+        output_root_bytes(&output, out, out_len);
+        return;
+    }
+
+    /* otherwise merge everything on the stack, from the top down */
+    output_t output;
+    size_t cvs_remaining;
+    if(chunk_state_len(&self->chunk) > 0) {
+        cvs_remaining = self->cv_stack_len;
+        output = chunk_state_output(&self->chunk);
+    } else {
+        /* there are always at least two CVs on the stack in this case */
+        cvs_remaining = self->cv_stack_len - 2;
+        output = parent_output(&self->cv_stack[cvs_remaining * BLAKE3_OUT_LEN],
+                               self->key, self->chunk.flags);
+    }
+
+    while(cvs_remaining > 0) {
+        cvs_remaining -= 1;
+        uint8_t parent_block[BLAKE3_BLOCK_LEN];
+        memcpy(parent_block, &self->cv_stack[cvs_remaining * BLAKE3_OUT_LEN],
+               BLAKE3_OUT_LEN);
+        output_chaining_value(&output, &parent_block[BLAKE3_OUT_LEN]);
+        output = parent_output(parent_block, self->key, self->chunk.flags);
+    }
+    output_root_bytes(&output, out, out_len);
+}
+
+void blake3_hasher_finalize_subtree(blake3_hasher *self,
+                                    uint8_t out[2 * BLAKE3_OUT_LEN]) {
+    /* subtree hashers keep no chunk back; merge all but the two halves */
+    while(self->cv_stack_len > 2) {
+        hasher_merge_parent(self);
+    }
+    memcpy(out, self->cv_stack, 2 * BLAKE3_OUT_LEN);
+}
+
+void blake3_hasher_push_subtree(blake3_hasher *self,
+                                const uint8_t cvs[2 * BLAKE3_OUT_LEN],
+                                uint64_t n_chunks) {
+    /* a first chunk may still be kept back */
+    if(chunk_state_len(&self->chunk) > 0) {
+        hasher_finish_chunk(self);
+    }
+
+    /* push both halves so the subtree's own parent can still become the root */
+    uint64_t counter = self->chunk.chunk_counter;
+    hasher_push_cv(self, cvs, counter);
+    hasher_push_cv(self, cvs + BLAKE3_OUT_LEN, counter + n_chunks / 2);
+    chunk_state_init(&self->chunk, self->key, counter + n_chunks);
+}
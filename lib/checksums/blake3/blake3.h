@@ -0,0 +1,70 @@
+/*
+ * BLAKE3 for rmlint.
+ *
+ * Follows the BLAKE3 specification (https://github.com/BLAKE3-team/BLAKE3-specs)
+ * and the structure of its reference C implementation (CC0 / Apache-2.0).
+ * Only unkeyed hashing is provided.  On x86-64 the bulk of the work is done
+ * by SSE4.1, AVX2 or AVX-512 kernels, up to the level allowed by
+ * rm_simd_level().
+ */
+
+#ifndef RM_BLAKE3_H
+#define RM_BLAKE3_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define BLAKE3_KEY_LEN 32
+#define BLAKE3_OUT_LEN 32
+#define BLAKE3_BLOCK_LEN 64
+#define BLAKE3_CHUNK_LEN 1024
+#define BLAKE3_MAX_DEPTH 54
+
+typedef struct {
+    uint32_t cv[8];
+    uint64_t chunk_counter;
+    uint8_t buf[BLAKE3_BLOCK_LEN];
+    uint8_t buf_len;
+    uint8_t blocks_compressed;
+    uint8_t flags;
+} blake3_chunk_state;
+
+typedef struct {
+    uint32_t key[8];
+    blake3_chunk_state chunk;
+    /* first chunk of a hasher created by blake3_hasher_init_subtree() */
+    uint64_t base_chunk;
+    /* a subtree is never the root, so its first chunk need not be kept back
+     * until more input arrives */
+    bool eager;
+    uint8_t cv_stack_len;
+    uint8_t cv_stack[(BLAKE3_MAX_DEPTH + 1) * BLAKE3_OUT_LEN];
+} blake3_hasher;
+
+void blake3_hasher_init(blake3_hasher *self);
+void blake3_hasher_update(blake3_hasher *self, const void *input, size_t input_len);
+void blake3_hasher_finalize(const blake3_hasher *self, uint8_t *out, size_t out_len);
+
+/*
+ * Subtrees allow parts of the input to be hashed elsewhere (e.g. in other
+ * threads).  A subtree covers n_chunks * BLAKE3_CHUNK_LEN bytes of input,
+ * where n_chunks is a power of two (at least 2) and the subtree starts at a
+ * multiple of its own size.
+ *
+ * blake3_hasher_init_subtree() prepares a hasher for the subtree starting at
+ * chunk chunk_counter; after feeding it exactly the subtree's input,
+ * blake3_hasher_finalize_subtree() returns the chaining values of its two
+ * halves, which blake3_hasher_push_subtree() adds to the main hasher.
+ */
+void blake3_hasher_init_subtree(blake3_hasher *self, uint64_t chunk_counter);
+void blake3_hasher_finalize_subtree(blake3_hasher *self,
+                                    uint8_t out[2 * BLAKE3_OUT_LEN]);
+void blake3_hasher_push_subtree(blake3_hasher *self,
+                                const uint8_t cvs[2 * BLAKE3_OUT_LEN],
+                                uint64_t n_chunks);
+
+/* Name of the kernel that blake3_hasher_update() uses for bulk data */
+const char *blake3_simd_name(void);
+
+#endif /* RM_BLAKE3_H */
@@ -0,0 +1,162 @@
+/*
+ * BLAKE3 AVX2 kernel: hashes 8 chunks in parallel, one per 32-bit lane.
+ */
+
+#include "blake3_impl.h"
+
+#if BLAKE3_USE_X86
+
+#include <immintrin.h>
+
+#define TARGET __attribute__((target("avx2")))
+#define DEGREE BLAKE3_AVX2_DEGREE
+
+TARGET static inline __m256i add(__m256i a, __m256i b) {
+    return _mm256_add_epi32(a, b);
+}
+
+TARGET static inline __m256i xorv(__m256i a, __m256i b) {
+    return _mm256_xor_si256(a, b);
+}
+
+TARGET static inline __m256i set1(uint32_t x) {
+    return _mm256_set1_epi32((int32_t)x);
+}
+
+TARGET static inline __m256i rot16(__m256i x) {
+    return _mm256_shuffle_epi8(
+        x, _mm256_set_epi8(13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2, 13, 12,
+                           15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2));
+}
+
+TARGET static inline __m256i rot12(__m256i x) {
+    return _mm256_or_si256(_mm256_srli_epi32(x, 12), _mm256_slli_epi32(x, 32 - 12));
+}
+
+TARGET static inline __m256i rot8(__m256i x) {
+    return _mm256_shuffle_epi8(
+        x, _mm256_set_epi8(12, 15, 14, 13, 8, 11, 10, 9, 4, 7, 6, 5, 0, 3, 2, 1, 12, 15,
+                           14, 13, 8, 11, 10, 9, 4, 7, 6, 5, 0, 3, 2, 1));
+}
+
+TARGET static inline __m256i rot7(__m256i x) {
+    return _mm256_or_si256(_mm256_srli_epi32(x, 7), _mm256_slli_epi32(x, 32 - 7));
+}
+
+TARGET static inline void g(__m256i *v, int a, int b, int c, int d, __m256i x,
+                            __m256i y) {
+    v[a] = add(add(v[a], v[b]), x);
+    v[d] = rot16(xorv(v[d], v[a]));
+    v[c] = add(v[c], v[d]);
+    v[b] = rot12(xorv(v[b], v[c]));
+    v[a] = add(add(v[a], v[b]), y);
+    v[d] = rot8(xorv(v[d], v[a]));
+    v[c] = add(v[c], v[d]);
+    v[b] = rot7(xorv(v[b], v[c]));
+}
+
+TARGET static inline void round_fn(__m256i v[16], const __m256i m[16], size_t r) {
+    const uint8_t *s = BLAKE3_MSG_SCHEDULE[r];
+    g(v, 0, 4, 8, 12, m[s[0]], m[s[1]]);
+    g(v, 1, 5, 9, 13, m[s[2]], m[s[3]]);
+    g(v, 2, 6, 10, 14, m[s[4]], m[s[5]]);
+    g(v, 3, 7, 11, 15, m[s[6]], m[s[7]]);
+    g(v, 0, 5, 10, 15, m[s[8]], m[s[9]]);
+    g(v, 1, 6, 11, 12, m[s[10]], m[s[11]]);
+    g(v, 2, 7, 8, 13, m[s[12]], m[s[13]]);
+    g(v, 3, 4, 9, 14, m[s[14]], m[s[15]]);
+}
+
+/* Transpose 8 rows of 8 words, so that out[w] holds word w of every row */
+TARGET static inline void transpose8(const __m256i r[8], __m256i out[8]) {
+    __m256i t0 = _mm256_unpacklo_epi32(r[0], r[1]);
+    __m256i t1 = _mm256_unpackhi_epi32(r[0], r[1]);
+    __m256i t2 = _mm256_unpacklo_epi32(r[2], r[3]);
+    __m256i t3 = _mm256_unpackhi_epi32(r[2], r[3]);
+    __m256i t4 = _mm256_unpacklo_epi32(r[4], r[5]);
+    __m256i t5 = _mm256_unpackhi_epi32(r[4], r[5]);
+    __m256i t6 = _mm256_unpacklo_epi32(r[6], r[7]);
+    __m256i t7 = _mm256_unpackhi_epi32(r[6], r[7]);
+
+    __m256i u0 = _mm256_unpacklo_epi64(t0, t2);
+    __m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+    __m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+    __m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+    __m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+    __m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+    __m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+    __m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+
+    out[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+    out[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+    out[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+    out[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+    out[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+    out[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+    out[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+    out[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+}
+
+/* Load block number `block` of each chunk so that m[w] holds word w of all
+ * chunks */
+TARGET static inline void load_msg(const uint8_t *input, size_t block, __m256i m[16]) {
+    const uint8_t *base = input + block * BLAKE3_BLOCK_LEN;
+    for(int w = 0; w < 16; w += 8) {
+        __m256i r[8];
+        for(int lane = 0; lane < DEGREE; lane++) {
+            r[lane] = _mm256_loadu_si256(
+                (const __m256i *)(base + lane * BLAKE3_CHUNK_LEN + 4 * w));
+        }
+        transpose8(r, &m[w]);
+    }
+}
+
+TARGET void blake3_hash_chunks_avx2(const uint8_t *input, const uint32_t key[8],
+                                    uint64_t counter, uint8_t flags, uint8_t *out) {
+    uint32_t counter_low[DEGREE], counter_high[DEGREE];
+    for(int i = 0; i < DEGREE; i++) {
+        counter_low[i] = blake3_counter_low(counter + i);
+        counter_high[i] = blake3_counter_high(counter + i);
+    }
+
+    __m256i h[8];
+    for(int i = 0; i < 8; i++) {
+        h[i] = set1(key[i]);
+    }
+
+    for(size_t b = 0; b < BLAKE3_CHUNK_LEN / BLAKE3_BLOCK_LEN; b++) {
+        uint8_t block_flags = flags;
+        if(b == 0) {
+            block_flags |= CHUNK_START;
+        }
+        if(b == BLAKE3_CHUNK_LEN / BLAKE3_BLOCK_LEN - 1) {
+            block_flags |= CHUNK_END;
+        }
+
+        __m256i m[16];
+        load_msg(input, b, m);
+
+        __m256i v[16] = {
+            h[0], h[1], h[2], h[3], h[4], h[5], h[6], h[7],
+            set1(BLAKE3_IV[0]), set1(BLAKE3_IV[1]), set1(BLAKE3_IV[2]), set1(BLAKE3_IV[3]),
+            _mm256_loadu_si256((const __m256i *)counter_low),
+            _mm256_loadu_si256((const __m256i *)counter_high),
+            set1(BLAKE3_BLOCK_LEN), set1(block_flags),
+        };
+        for(size_t r = 0; r < 7; r++) {
+            round_fn(v, m, r);
+        }
+        for(int i = 0; i < 8; i++) {
+            h[i] = xorv(v[i], v[i + 8]);
+        }
+    }
+
+    /* h[i] holds word i of every chunk's CV; turn that around */
+    __m256i cvs[8];
+    transpose8(h, cvs);
+    for(int lane = 0; lane < DEGREE; lane++) {
+        _mm256_storeu_si256((__m256i *)(out + lane * BLAKE3_OUT_LEN), cvs[lane]);
+    }
+}
+
+#endif /* BLAKE3_USE_X86 */
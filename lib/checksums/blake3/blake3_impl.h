@@ -0,0 +1,104 @@
+/*
+ * Internals shared by the BLAKE3 portable code and SIMD kernels.
+ */
+
+#ifndef RM_BLAKE3_IMPL_H
+#define RM_BLAKE3_IMPL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "../simd.h"
+#include "blake3.h"
+
+enum blake3_flags {
+    CHUNK_START = 1 << 0,
+    CHUNK_END = 1 << 1,
+    PARENT = 1 << 2,
+    ROOT = 1 << 3,
+};
+
+#define BLAKE3_USE_X86 RM_SIMD_X86
+
+/* most chunks hashed by a single kernel call */
+#define BLAKE3_MAX_SIMD_DEGREE 16
+
+static const uint32_t BLAKE3_IV[8] = {0x6A09E667UL, 0xBB67AE85UL, 0x3C6EF372UL,
+                                      0xA54FF53AUL, 0x510E527FUL, 0x9B05688CUL,
+                                      0x1F83D9ABUL, 0x5BE0CD19UL};
+
+static const uint8_t BLAKE3_MSG_SCHEDULE[7][16] = {
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+    {2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8},
+    {3, 4, 10, 12, 13, 2, 7, 14, 6, 5, 9, 0, 11, 15, 8, 1},
+    {10, 7, 12, 9, 14, 3, 13, 15, 4, 0, 11, 2, 5, 8, 1, 6},
+    {12, 13, 9, 11, 15, 10, 14, 8, 7, 2, 5, 3, 0, 1, 6, 4},
+    {9, 14, 11, 5, 8, 12, 15, 1, 13, 3, 0, 10, 2, 6, 4, 7},
+    {11, 15, 5, 0, 1, 9, 8, 6, 14, 10, 2, 12, 3, 4, 7, 13},
+};
+
+static inline uint32_t blake3_load32(const void *src) {
+    const uint8_t *p = (const uint8_t *)src;
+    return ((uint32_t)p[0] << 0) | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+           ((uint32_t)p[3] << 24);
+}
+
+static inline void blake3_store32(void *dst, uint32_t w) {
+    uint8_t *p = (uint8_t *)dst;
+    p[0] = (uint8_t)(w >> 0);
+    p[1] = (uint8_t)(w >> 8);
+    p[2] = (uint8_t)(w >> 16);
+    p[3] = (uint8_t)(w >> 24);
+}
+
+static inline void blake3_store_cv(uint8_t out[BLAKE3_OUT_LEN], const uint32_t cv[8]) {
+    for(int i = 0; i < 8; i++) {
+        blake3_store32(&out[4 * i], cv[i]);
+    }
+}
+
+static inline uint32_t blake3_counter_low(uint64_t counter) {
+    return (uint32_t)counter;
+}
+
+static inline uint32_t blake3_counter_high(uint64_t counter) {
+    return (uint32_t)(counter >> 32);
+}
+
+/* Compress one block; cv is updated in place */
+void blake3_compress_in_place_portable(uint32_t cv[8],
+                                       const uint8_t block[BLAKE3_BLOCK_LEN],
+                                       uint8_t block_len, uint64_t counter,
+                                       uint8_t flags);
+
+/* Compress one block and return the full 64 byte output (for the root) */
+void blake3_compress_xof_portable(const uint32_t cv[8],
+                                  const uint8_t block[BLAKE3_BLOCK_LEN],
+                                  uint8_t block_len, uint64_t counter, uint8_t flags,
+                                  uint8_t out[64]);
+
+/*
+ * Hash whole chunks which are stored one after the other at input; chunk i
+ * gets counter + i and its chaining value goes to out + i * BLAKE3_OUT_LEN.
+ * Each SIMD kernel hashes exactly as many chunks as it has lanes.
+ */
+void blake3_hash_chunks_portable(const uint8_t *input, size_t n_chunks,
+                                 const uint32_t key[8], uint64_t counter,
+                                 uint8_t flags, uint8_t *out);
+
+#if BLAKE3_USE_X86
+#define BLAKE3_SSE41_DEGREE 4
+#define BLAKE3_AVX2_DEGREE 8
+#define BLAKE3_AVX512_DEGREE 16
+
+void blake3_hash_chunks_sse41(const uint8_t *input, const uint32_t key[8],
+                              uint64_t counter, uint8_t flags, uint8_t *out);
+void blake3_hash_chunks_avx2(const uint8_t *input, const uint32_t key[8],
+                             uint64_t counter, uint8_t flags, uint8_t *out);
+void blake3_hash_chunks_avx512(const uint8_t *input, const uint32_t key[8],
+                               uint64_t counter, uint8_t flags, uint8_t *out);
+#endif
+
+#endif /* RM_BLAKE3_IMPL_H */
@@ -0,0 +1,141 @@
+/*
+ * BLAKE3 SSE4.1 kernel: hashes 4 chunks in parallel, one per 32-bit lane.
+ */
+
+#include "blake3_impl.h"
+
+#if BLAKE3_USE_X86
+
+#include <immintrin.h>
+
+#define TARGET __attribute__((target("sse4.1")))
+#define DEGREE BLAKE3_SSE41_DEGREE
+
+TARGET static inline __m128i add(__m128i a, __m128i b) {
+    return _mm_add_epi32(a, b);
+}
+
+TARGET static inline __m128i xorv(__m128i a, __m128i b) {
+    return _mm_xor_si128(a, b);
+}
+
+TARGET static inline __m128i set1(uint32_t x) {
+    return _mm_set1_epi32((int32_t)x);
+}
+
+TARGET static inline __m128i rot16(__m128i x) {
+    return _mm_shuffle_epi8(
+        x, _mm_set_epi8(13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2));
+}
+
+TARGET static inline __m128i rot12(__m128i x) {
+    return _mm_or_si128(_mm_srli_epi32(x, 12), _mm_slli_epi32(x, 32 - 12));
+}
+
+TARGET static inline __m128i rot8(__m128i x) {
+    return _mm_shuffle_epi8(
+        x, _mm_set_epi8(12, 15, 14, 13, 8, 11, 10, 9, 4, 7, 6, 5, 0, 3, 2, 1));
+}
+
+TARGET static inline __m128i rot7(__m128i x) {
+    return _mm_or_si128(_mm_srli_epi32(x, 7), _mm_slli_epi32(x, 32 - 7));
+}
+
+TARGET static inline void g(__m128i *v, int a, int b, int c, int d, __m128i x,
+                            __m128i y) {
+    v[a] = add(add(v[a], v[b]), x);
+    v[d] = rot16(xorv(v[d], v[a]));
+    v[c] = add(v[c], v[d]);
+    v[b] = rot12(xorv(v[b], v[c]));
+    v[a] = add(add(v[a], v[b]), y);
+    v[d] = rot8(xorv(v[d], v[a]));
+    v[c] = add(v[c], v[d]);
+    v[b] = rot7(xorv(v[b], v[c]));
+}
+
+TARGET static inline void round_fn(__m128i v[16], const __m128i m[16], size_t r) {
+    const uint8_t *s = BLAKE3_MSG_SCHEDULE[r];
+    g(v, 0, 4, 8, 12, m[s[0]], m[s[1]]);
+    g(v, 1, 5, 9, 13, m[s[2]], m[s[3]]);
+    g(v, 2, 6, 10, 14, m[s[4]], m[s[5]]);
+    g(v, 3, 7, 11, 15, m[s[6]], m[s[7]]);
+    g(v, 0, 5, 10, 15, m[s[8]], m[s[9]]);
+    g(v, 1, 6, 11, 12, m[s[10]], m[s[11]]);
+    g(v, 2, 7, 8, 13, m[s[12]], m[s[13]]);
+    g(v, 3, 4, 9, 14, m[s[14]], m[s[15]]);
+}
+
+/* Load block number `block` of each chunk so that m[w] holds word w of all
+ * chunks */
+TARGET static inline void load_msg(const uint8_t *input, size_t block, __m128i m[16]) {
+    const uint8_t *base = input + block * BLAKE3_BLOCK_LEN;
+    for(int w = 0; w < 16; w += 4) {
+        __m128i r0 = _mm_loadu_si128((const __m128i *)(base + 0 * BLAKE3_CHUNK_LEN + 4 * w));
+        __m128i r1 = _mm_loadu_si128((const __m128i *)(base + 1 * BLAKE3_CHUNK_LEN + 4 * w));
+        __m128i r2 = _mm_loadu_si128((const __m128i *)(base + 2 * BLAKE3_CHUNK_LEN + 4 * w));
+        __m128i r3 = _mm_loadu_si128((const __m128i *)(base + 3 * BLAKE3_CHUNK_LEN + 4 * w));
+
+        __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+        __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+        __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+        __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+
+        m[w + 0] = _mm_unpacklo_epi64(t0, t1);
+        m[w + 1] = _mm_unpackhi_epi64(t0, t1);
+        m[w + 2] = _mm_unpacklo_epi64(t2, t3);
+        m[w + 3] = _mm_unpackhi_epi64(t2, t3);
+    }
+}
+
+TARGET void blake3_hash_chunks_sse41(const uint8_t *input, const uint32_t key[8],
+                                     uint64_t counter, uint8_t flags, uint8_t *out) {
+    uint32_t counter_low[DEGREE], counter_high[DEGREE];
+    for(int i = 0; i < DEGREE; i++) {
+        counter_low[i] = blake3_counter_low(counter + i);
+        counter_high[i] = blake3_counter_high(counter + i);
+    }
+
+    __m128i h[8];
+    for(int i = 0; i < 8; i++) {
+        h[i] = set1(key[i]);
+    }
+
+    for(size_t b = 0; b < BLAKE3_CHUNK_LEN / BLAKE3_BLOCK_LEN; b++) {
+        uint8_t block_flags = flags;
+        if(b == 0) {
+            block_flags |= CHUNK_START;
+        }
+        if(b == BLAKE3_CHUNK_LEN / BLAKE3_BLOCK_LEN - 1) {
+            block_flags |= CHUNK_END;
+        }
+
+        __m128i m[16];
+        load_msg(input, b, m);
+
+        __m128i v[16] = {
+            h[0], h[1], h[2], h[3], h[4], h[5], h[6], h[7],
+            set1(BLAKE3_IV[0]), set1(BLAKE3_IV[1]), set1(BLAKE3_IV[2]), set1(BLAKE3_IV[3]),
+            _mm_loadu_si128((const __m128i *)counter_low),
+            _mm_loadu_si128((const __m128i *)counter_high),
+            set1(BLAKE3_BLOCK_LEN), set1(block_flags),
+        };
+        for(size_t r = 0; r < 7; r++) {
+            round_fn(v, m, r);
+        }
+        for(int i = 0; i < 8; i++) {
+            h[i] = xorv(v[i], v[i + 8]);
+        }
+    }
+
+    uint32_t words[8][DEGREE];
+    for(int i = 0; i < 8; i++) {
+        _mm_storeu_si128((__m128i *)words[i], h[i]);
+    }
+    for(int lane = 0; lane < DEGREE; lane++) {
+        for(int i = 0; i < 8; i++) {
+            blake3_store32(out + lane * BLAKE3_OUT_LEN + 4 * i, words[i][lane]);
+        }
+    }
+}
+
+#endif /* BLAKE3_USE_X86 */
@@ -0,0 +1,114 @@
+#include "blockcmp.h"
+
+#include <string.h>
+
+#include "simd.h"
+
+#if RM_SIMD_X86
+#include <immintrin.h>
+#endif
+
+/* The SIMD kernels walk through data in strides, loading each stride of data
+ * once and checking it against all candidates that still match; a candidate
+ * drops out at the first stride that differs.  The remainder is left to
+ * memcmp(), which is also the portable kernel: libc's memcmp() is hard to beat
+ * one candidate at a time. */
+
+static uint64_t rm_blockcmp_tail(const uint8_t *data, const void *const *cands,
+                                 unsigned n_cands, size_t offset, size_t len,
+                                 uint64_t mask) {
+    if(offset == len) {
+        return mask;
+    }
+    for(unsigned i = 0; i < n_cands; i++) {
+        if((mask >> i & 1) &&
+           memcmp(data + offset, (const uint8_t *)cands[i] + offset, len - offset) != 0) {
+            mask &= ~((uint64_t)1 << i);
+        }
+    }
+    return mask;
+}
+
+#if RM_SIMD_X86
+
+#define RM_BLOCKCMP_AVX2_STRIDE (4 * sizeof(__m256i))
+
+__attribute__((target("avx2"))) static uint64_t rm_blockcmp_avx2(
+    const uint8_t *data, const void *const *cands, unsigned n_cands, size_t len,
+    uint64_t mask) {
+    size_t offset = 0;
+    for(; mask && offset + RM_BLOCKCMP_AVX2_STRIDE <= len;
+        offset += RM_BLOCKCMP_AVX2_STRIDE) {
+        const __m256i *dp = (const __m256i *)(data + offset);
+        __m256i d0 = _mm256_loadu_si256(dp + 0);
+        __m256i d1 = _mm256_loadu_si256(dp + 1);
+        __m256i d2 = _mm256_loadu_si256(dp + 2);
+        __m256i d3 = _mm256_loadu_si256(dp + 3);
+        for(unsigned i = 0; i < n_cands; i++) {
+            if(mask >> i & 1) {
+                const __m256i *cp = (const __m256i *)((const uint8_t *)cands[i] + offset);
+                __m256i x0 = _mm256_xor_si256(d0, _mm256_loadu_si256(cp + 0));
+                __m256i x1 = _mm256_xor_si256(d1, _mm256_loadu_si256(cp + 1));
+                __m256i x2 = _mm256_xor_si256(d2, _mm256_loadu_si256(cp + 2));
+                __m256i x3 = _mm256_xor_si256(d3, _mm256_loadu_si256(cp + 3));
+                __m256i x = _mm256_or_si256(_mm256_or_si256(x0, x1), _mm256_or_si256(x2, x3));
+                if(!_mm256_testz_si256(x, x)) {
+                    mask &= ~((uint64_t)1 << i);
+                }
+            }
+        }
+    }
+    return rm_blockcmp_tail(data, cands, n_cands, offset, len, mask);
+}
+
+#define RM_BLOCKCMP_AVX512_STRIDE (2 * sizeof(__m512i))
+
+/* compares 64 bit lanes, so AVX-512F suffices */
+__attribute__((target("avx512f"))) static uint64_t rm_blockcmp_avx512(
+    const uint8_t *data, const void *const *cands, unsigned n_cands, size_t len,
+    uint64_t mask) {
+    size_t offset = 0;
+    for(; mask && offset + RM_BLOCKCMP_AVX512_STRIDE <= len;
+        offset += RM_BLOCKCMP_AVX512_STRIDE) {
+        const uint8_t *dp = data + offset;
+        __m512i d0 = _mm512_loadu_si512(dp);
+        __m512i d1 = _mm512_loadu_si512(dp + sizeof(__m512i));
+        for(unsigned i = 0; i < n_cands; i++) {
+            if(mask >> i & 1) {
+                const uint8_t *cp = (const uint8_t *)cands[i] + offset;
+                __mmask8 ne0 = _mm512_cmpneq_epu64_mask(d0, _mm512_loadu_si512(cp));
+                __mmask8 ne1 =
+                    _mm512_cmpneq_epu64_mask(d1, _mm512_loadu_si512(cp + sizeof(__m512i)));
+                if((ne0 | ne1) != 0) {
+                    mask &= ~((uint64_t)1 << i);
+                }
+            }
+        }
+    }
+    return rm_blockcmp_tail(data, cands, n_cands, offset, len, mask);
+}
+
+#endif /* RM_SIMD_X86 */
+
+uint64_t rm_blockcmp(const void *data, const void *const *cands, unsigned n_cands,
+                     size_t len, uint64_t mask) {
+#if RM_SIMD_X86
+    const RmSimdLevel level = rm_simd_level();
+    if(level >= RM_SIMD_AVX512) {
+        return rm_blockcmp_avx512(data, cands, n_cands, len, mask);
+    }
+    if(level >= RM_SIMD_AVX2) {
+        return rm_blockcmp_avx2(data, cands, n_cands, len, mask);
+    }
+#endif
+    return rm_blockcmp_tail(data, cands, n_cands, 0, len, mask);
+}
+
+const char *rm_blockcmp_kernel_name(void) {
+#if RM_SIMD_X86
+    const RmSimdLevel level = rm_simd_level();
+    return rm_simd_level_name(level >= RM_SIMD_AVX2 ? level : RM_SIMD_NONE);
+#else
+    return rm_simd_level_name(RM_SIMD_NONE);
+#endif
+}
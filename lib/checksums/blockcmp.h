@@ -0,0 +1,24 @@
+/*
+ * Comparison of one block of data against several others at once, for the
+ * paranoid digest.
+ */
+
+#ifndef RM_BLOCKCMP_H
+#define RM_BLOCKCMP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Max number of candidates per call */
+#define RM_BLOCKCMP_MAX_CANDIDATES 64
+
+/* Compare the len bytes at data with the len bytes at cands[i], for each bit i
+ * set in mask (i < n_cands <= RM_BLOCKCMP_MAX_CANDIDATES).  data is only read
+ * once.  Returns mask with the bits of the mismatching candidates cleared. */
+uint64_t rm_blockcmp(const void *data, const void *const *cands, unsigned n_cands,
+                     size_t len, uint64_t mask);
+
+/* Name of the kernel used by rm_blockcmp() */
+const char *rm_blockcmp_kernel_name(void);
+
+#endif /* RM_BLOCKCMP_H */
@@ -4,6 +4,12 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "simd.h"
+
+#if RM_SIMD_X86
+#include <immintrin.h>
+#endif
+
 /*
 This code is compatible with C90 with the additional requirement of
 supporting uint64_t.
@@ -73,6 +79,110 @@ void HighwayHashUpdatePacket(const uint8_t* packet, HighwayHashState* state) {
     Update(lanes, state);
 }
 
+/*////////////////////////////////////////////////////////////////////////////*/
+/* SIMD packet loops, selected at runtime                                     */
+/*////////////////////////////////////////////////////////////////////////////*/
+
+#if RM_SIMD_X86
+
+/* Same as ZipperMergeAndAdd(), as a byte shuffle within each 128 bit half */
+#define HH_ZIPPER_LO 0x000F010E05020C03ll
+#define HH_ZIPPER_HI 0x070806090D0A040Bll
+
+__attribute__((target("avx2"))) static void UpdatePacketsAVX2(const uint8_t* packets,
+                                                              size_t n,
+                                                              HighwayHashState* state) {
+    const __m256i zipper =
+        _mm256_set_epi64x(HH_ZIPPER_HI, HH_ZIPPER_LO, HH_ZIPPER_HI, HH_ZIPPER_LO);
+    __m256i v0 = _mm256_loadu_si256((const __m256i*)state->v0);
+    __m256i v1 = _mm256_loadu_si256((const __m256i*)state->v1);
+    __m256i mul0 = _mm256_loadu_si256((const __m256i*)state->mul0);
+    __m256i mul1 = _mm256_loadu_si256((const __m256i*)state->mul1);
+    size_t i;
+
+    for(i = 0; i < n; ++i) {
+        const __m256i lanes = _mm256_loadu_si256((const __m256i*)(packets + 32 * i));
+        v1 = _mm256_add_epi64(v1, _mm256_add_epi64(mul0, lanes));
+        mul0 = _mm256_xor_si256(mul0, _mm256_mul_epu32(v1, _mm256_srli_epi64(v0, 32)));
+        v0 = _mm256_add_epi64(v0, mul1);
+        mul1 = _mm256_xor_si256(mul1, _mm256_mul_epu32(v0, _mm256_srli_epi64(v1, 32)));
+        v0 = _mm256_add_epi64(v0, _mm256_shuffle_epi8(v1, zipper));
+        v1 = _mm256_add_epi64(v1, _mm256_shuffle_epi8(v0, zipper));
+    }
+
+    _mm256_storeu_si256((__m256i*)state->v0, v0);
+    _mm256_storeu_si256((__m256i*)state->v1, v1);
+    _mm256_storeu_si256((__m256i*)state->mul0, mul0);
+    _mm256_storeu_si256((__m256i*)state->mul1, mul1);
+}
+
+__attribute__((target("sse4.1"))) static void UpdatePacketsSSE41(
+    const uint8_t* packets, size_t n, HighwayHashState* state) {
+    const __m128i zipper = _mm_set_epi64x(HH_ZIPPER_HI, HH_ZIPPER_LO);
+    __m128i v0[2], v1[2], mul0[2], mul1[2];
+    size_t i;
+    int h;
+
+    for(h = 0; h < 2; ++h) {
+        v0[h] = _mm_loadu_si128((const __m128i*)&state->v0[2 * h]);
+        v1[h] = _mm_loadu_si128((const __m128i*)&state->v1[2 * h]);
+        mul0[h] = _mm_loadu_si128((const __m128i*)&state->mul0[2 * h]);
+        mul1[h] = _mm_loadu_si128((const __m128i*)&state->mul1[2 * h]);
+    }
+
+    for(i = 0; i < n; ++i) {
+        for(h = 0; h < 2; ++h) {
+            const __m128i lanes =
+                _mm_loadu_si128((const __m128i*)(packets + 32 * i + 16 * h));
+            v1[h] = _mm_add_epi64(v1[h], _mm_add_epi64(mul0[h], lanes));
+            mul0[h] =
+                _mm_xor_si128(mul0[h], _mm_mul_epu32(v1[h], _mm_srli_epi64(v0[h], 32)));
+            v0[h] = _mm_add_epi64(v0[h], mul1[h]);
+            mul1[h] =
+                _mm_xor_si128(mul1[h], _mm_mul_epu32(v0[h], _mm_srli_epi64(v1[h], 32)));
+            v0[h] = _mm_add_epi64(v0[h], _mm_shuffle_epi8(v1[h], zipper));
+            v1[h] = _mm_add_epi64(v1[h], _mm_shuffle_epi8(v0[h], zipper));
+        }
+    }
+
+    for(h = 0; h < 2; ++h) {
+        _mm_storeu_si128((__m128i*)&state->v0[2 * h], v0[h]);
+        _mm_storeu_si128((__m128i*)&state->v1[2 * h], v1[h]);
+        _mm_storeu_si128((__m128i*)&state->mul0[2 * h], mul0[h]);
+        _mm_storeu_si128((__m128i*)&state->mul1[2 * h], mul1[h]);
+    }
+}
+
+#endif /* RM_SIMD_X86 */
+
+/* Hashes n consecutive packets of 32 bytes */
+static void UpdatePackets(const uint8_t* packets, size_t n, HighwayHashState* state) {
+    size_t i;
+#if RM_SIMD_X86
+    const RmSimdLevel level = rm_simd_level();
+    if(level >= RM_SIMD_AVX2) {
+        UpdatePacketsAVX2(packets, n, state);
+        return;
+    }
+    if(level >= RM_SIMD_SSE41) {
+        UpdatePacketsSSE41(packets, n, state);
+        return;
+    }
+#endif
+    for(i = 0; i < n; ++i) {
+        HighwayHashUpdatePacket(packets + 32 * i, state);
+    }
+}
+
+const char* HighwayHashKernelName(void) {
+#if RM_SIMD_X86
+    const RmSimdLevel level = rm_simd_level();
+    return rm_simd_level_name(level > RM_SIMD_AVX2 ? RM_SIMD_AVX2 : level);
+#else
+    return rm_simd_level_name(RM_SIMD_NONE);
+#endif
+}
+
 static void Rotate32By(uint64_t count, uint64_t lanes[4]) {
     int i;
     for(i = 0; i < 4; ++i) {
@@ -166,9 +276,8 @@ static void ProcessAll(const uint8_t* data, size_t size, const uint64_t key[4],
                        HighwayHashState* state) {
     size_t i;
     HighwayHashReset(key, state);
-    for(i = 0; i + 32 <= size; i += 32) {
-        HighwayHashUpdatePacket(data + i, state);
-    }
+    UpdatePackets(data, size / 32, state);
+    i = size & ~(size_t)31;
     if((size & 31) != 0)
         HighwayHashUpdateRemainder(data + i, size & 31, state);
 }
@@ -217,10 +326,10 @@ void HighwayHashCatAppend(const uint8_t* bytes, size_t num, HighwayHashCat* stat
             state->num = 0;
         }
     }
-    while(num >= 32) {
-        HighwayHashUpdatePacket(bytes, &state->state);
-        num -= 32;
-        bytes += 32;
+    if(num >= 32) {
+        UpdatePackets(bytes, num / 32, &state->state);
+        bytes += num & ~(size_t)31;
+        num &= 31;
     }
     for(i = 0; i < num; i++) {
         state->packet[state->num] = bytes[i];
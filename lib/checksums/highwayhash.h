@@ -23,6 +23,8 @@ typedef struct {
 void HighwayHashReset(const uint64_t key[4], HighwayHashState* state);
 /* Takes a packet of 32 bytes */
 void HighwayHashUpdatePacket(const uint8_t* packet, HighwayHashState* state);
+/* Name of the SIMD kernel used for bulk data by HighwayHashCatAppend() */
+const char* HighwayHashKernelName(void);
 /* Adds the final 1..31 bytes, do not use if 0 remain */
 void HighwayHashUpdateRemainder(const uint8_t* bytes, const size_t size_mod32,
                                 HighwayHashState* state);
@@ -0,0 +1,292 @@
+/*
+ * SHA-1/SHA-256 kernels for the ARMv8 crypto extensions.
+ */
+
+#include "sha-impl.h"
+
+#if SHA_USE_ARMV8
+
+#include <arm_neon.h>
+
+#if defined(__clang__)
+#define TARGET __attribute__((target("crypto")))
+#else
+#define TARGET __attribute__((target("+crypto")))
+#endif
+
+TARGET static inline uint32x4_t load_be(const uint8_t *in) {
+    return vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(in)));
+}
+
+TARGET void sha1_blocks_armv8(uint32_t *h, const uint8_t *in, size_t n_blocks) {
+    uint32x4_t abcd = vld1q_u32(h);
+    uint32_t e0 = h[4];
+
+    for(; n_blocks > 0; n_blocks--, in += SHA_BLOCK_LEN) {
+        uint32x4_t abcd_save = abcd, wk;
+        uint32_t e0_save = e0, e1;
+        uint32x4_t m0 = load_be(in), m1 = load_be(in + 16);
+        uint32x4_t m2 = load_be(in + 32), m3 = load_be(in + 48);
+
+        /* rounds 0-3 */
+        wk = vaddq_u32(m0, vdupq_n_u32(0x5A827999));
+        e1 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+        abcd = vsha1cq_u32(abcd, e0, wk);
+        m0 = vsha1su1q_u32(vsha1su0q_u32(m0, m1, m2), m3);
+
+        /* rounds 4-7 */
+        wk = vaddq_u32(m1, vdupq_n_u32(0x5A827999));
+        e0 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+        abcd = vsha1cq_u32(abcd, e1, wk);
+        m1 = vsha1su1q_u32(vsha1su0q_u32(m1, m2, m3), m0);
+
+        /* rounds 8-11 */
+        wk = vaddq_u32(m2, vdupq_n_u32(0x5A827999));
+        e1 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+        abcd = vsha1cq_u32(abcd, e0, wk);
+        m2 = vsha1su1q_u32(vsha1su0q_u32(m2, m3, m0), m1);
+
+        /* rounds 12-15 */
+        wk = vaddq_u32(m3, vdupq_n_u32(0x5A827999));
+        e0 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+        abcd = vsha1cq_u32(abcd, e1, wk);
+        m3 = vsha1su1q_u32(vsha1su0q_u32(m3, m0, m1), m2);
+
+        /* rounds 16-19 */
+        wk = vaddq_u32(m0, vdupq_n_u32(0x5A827999));
+        e1 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+        abcd = vsha1cq_u32(abcd, e0, wk);
+        m0 = vsha1su1q_u32(vsha1su0q_u32(m0, m1, m2), m3);
+
+        /* rounds 20-23 */
+        wk = vaddq_u32(m1, vdupq_n_u32(0x6ED9EBA1));
+        e0 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+        abcd = vsha1pq_u32(abcd, e1, wk);
+        m1 = vsha1su1q_u32(vsha1su0q_u32(m1, m2, m3), m0);
+
+        /* rounds 24-27 */
+        wk = vaddq_u32(m2, vdupq_n_u32(0x6ED9EBA1));
+        e1 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+        abcd = vsha1pq_u32(abcd, e0, wk);
+        m2 = vsha1su1q_u32(vsha1su0q_u32(m2, m3, m0), m1);
+
+        /* rounds 28-31 */
+        wk = vaddq_u32(m3, vdupq_n_u32(0x6ED9EBA1));
+        e0 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+        abcd = vsha1pq_u32(abcd, e1, wk);
+        m3 = vsha1su1q_u32(vsha1su0q_u32(m3, m0, m1), m2);
+
+        /* rounds 32-35 */
+        wk = vaddq_u32(m0, vdupq_n_u32(0x6ED9EBA1));
+        e1 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+        abcd = vsha1pq_u32(abcd, e0, wk);
+        m0 = vsha1su1q_u32(vsha1su0q_u32(m0, m1, m2), m3);
+
+        /* rounds 36-39 */
+        wk = vaddq_u32(m1, vdupq_n_u32(0x6ED9EBA1));
+        e0 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+        abcd = vsha1pq_u32(abcd, e1, wk);
+        m1 = vsha1su1q_u32(vsha1su0q_u32(m1, m2, m3), m0);
+
+        /* rounds 40-43 */
+        wk = vaddq_u32(m2, vdupq_n_u32(0x8F1BBCDC));
+        e1 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+        abcd = vsha1mq_u32(abcd, e0, wk);
+        m2 = vsha1su1q_u32(vsha1su0q_u32(m2, m3, m0), m1);
+
+        /* rounds 44-47 */
+        wk = vaddq_u32(m3, vdupq_n_u32(0x8F1BBCDC));
+        e0 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+        abcd = vsha1mq_u32(abcd, e1, wk);
+        m3 = vsha1su1q_u32(vsha1su0q_u32(m3, m0, m1), m2);
+
+        /* rounds 48-51 */
+        wk = vaddq_u32(m0, vdupq_n_u32(0x8F1BBCDC));
+        e1 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+        abcd = vsha1mq_u32(abcd, e0, wk);
+        m0 = vsha1su1q_u32(vsha1su0q_u32(m0, m1, m2), m3);
+
+        /* rounds 52-55 */
+        wk = vaddq_u32(m1, vdupq_n_u32(0x8F1BBCDC));
+        e0 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+        abcd = vsha1mq_u32(abcd, e1, wk);
+        m1 = vsha1su1q_u32(vsha1su0q_u32(m1, m2, m3), m0);
+
+        /* rounds 56-59 */
+        wk = vaddq_u32(m2, vdupq_n_u32(0x8F1BBCDC));
+        e1 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+        abcd = vsha1mq_u32(abcd, e0, wk);
+        m2 = vsha1su1q_u32(vsha1su0q_u32(m2, m3, m0), m1);
+
+        /* rounds 60-63 */
+        wk = vaddq_u32(m3, vdupq_n_u32(0xCA62C1D6));
+        e0 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+        abcd = vsha1pq_u32(abcd, e1, wk);
+        m3 = vsha1su1q_u32(vsha1su0q_u32(m3, m0, m1), m2);
+
+        /* rounds 64-67 */
+        wk = vaddq_u32(m0, vdupq_n_u32(0xCA62C1D6));
+        e1 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+        abcd = vsha1pq_u32(abcd, e0, wk);
+
+        /* rounds 68-71 */
+        wk = vaddq_u32(m1, vdupq_n_u32(0xCA62C1D6));
+        e0 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+        abcd = vsha1pq_u32(abcd, e1, wk);
+
+        /* rounds 72-75 */
+        wk = vaddq_u32(m2, vdupq_n_u32(0xCA62C1D6));
+        e1 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+        abcd = vsha1pq_u32(abcd, e0, wk);
+
+        /* rounds 76-79 */
+        wk = vaddq_u32(m3, vdupq_n_u32(0xCA62C1D6));
+        e0 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+        abcd = vsha1pq_u32(abcd, e1, wk);
+
+        e0 += e0_save;
+        abcd = vaddq_u32(abcd, abcd_save);
+    }
+
+    vst1q_u32(h, abcd);
+    h[4] = e0;
+}
+
+TARGET void sha256_blocks_armv8(uint32_t *h, const uint8_t *in, size_t n_blocks) {
+    uint32x4_t state0 = vld1q_u32(&h[0]); /* ABCD */
+    uint32x4_t state1 = vld1q_u32(&h[4]); /* EFGH */
+
+    for(; n_blocks > 0; n_blocks--, in += SHA_BLOCK_LEN) {
+        uint32x4_t abcd_save = state0, efgh_save = state1, wk, tmp;
+        uint32x4_t m0 = load_be(in), m1 = load_be(in + 16);
+        uint32x4_t m2 = load_be(in + 32), m3 = load_be(in + 48);
+
+        /* rounds 0-3 */
+        wk = vaddq_u32(m0, vld1q_u32(&SHA256_K[0]));
+        m0 = vsha256su0q_u32(m0, m1);
+        tmp = state0;
+        state0 = vsha256hq_u32(state0, state1, wk);
+        state1 = vsha256h2q_u32(state1, tmp, wk);
+        m0 = vsha256su1q_u32(m0, m2, m3);
+
+        /* rounds 4-7 */
+        wk = vaddq_u32(m1, vld1q_u32(&SHA256_K[4]));
+        m1 = vsha256su0q_u32(m1, m2);
+        tmp = state0;
+        state0 = vsha256hq_u32(state0, state1, wk);
+        state1 = vsha256h2q_u32(state1, tmp, wk);
+        m1 = vsha256su1q_u32(m1, m3, m0);
+
+        /* rounds 8-11 */
+        wk = vaddq_u32(m2, vld1q_u32(&SHA256_K[8]));
+        m2 = vsha256su0q_u32(m2, m3);
+        tmp = state0;
+        state0 = vsha256hq_u32(state0, state1, wk);
+        state1 = vsha256h2q_u32(state1, tmp, wk);
+        m2 = vsha256su1q_u32(m2, m0, m1);
+
+        /* rounds 12-15 */
+        wk = vaddq_u32(m3, vld1q_u32(&SHA256_K[12]));
+        m3 = vsha256su0q_u32(m3, m0);
+        tmp = state0;
+        state0 = vsha256hq_u32(state0, state1, wk);
+        state1 = vsha256h2q_u32(state1, tmp, wk);
+        m3 = vsha256su1q_u32(m3, m1, m2);
+
+        /* rounds 16-19 */
+        wk = vaddq_u32(m0, vld1q_u32(&SHA256_K[16]));
+        m0 = vsha256su0q_u32(m0, m1);
+        tmp = state0;
+        state0 = vsha256hq_u32(state0, state1, wk);
+        state1 = vsha256h2q_u32(state1, tmp, wk);
+        m0 = vsha256su1q_u32(m0, m2, m3);
+
+        /* rounds 20-23 */
+        wk = vaddq_u32(m1, vld1q_u32(&SHA256_K[20]));
+        m1 = vsha256su0q_u32(m1, m2);
+        tmp = state0;
+        state0 = vsha256hq_u32(state0, state1, wk);
+        state1 = vsha256h2q_u32(state1, tmp, wk);
+        m1 = vsha256su1q_u32(m1, m3, m0);
+
+        /* rounds 24-27 */
+        wk = vaddq_u32(m2, vld1q_u32(&SHA256_K[24]));
+        m2 = vsha256su0q_u32(m2, m3);
+        tmp = state0;
+        state0 = vsha256hq_u32(state0, state1, wk);
+        state1 = vsha256h2q_u32(state1, tmp, wk);
+        m2 = vsha256su1q_u32(m2, m0, m1);
+
+        /* rounds 28-31 */
+        wk = vaddq_u32(m3, vld1q_u32(&SHA256_K[28]));
+        m3 = vsha256su0q_u32(m3, m0);
+        tmp = state0;
+        state0 = vsha256hq_u32(state0, state1, wk);
+        state1 = vsha256h2q_u32(state1, tmp, wk);
+        m3 = vsha256su1q_u32(m3, m1, m2);
+
+        /* rounds 32-35 */
+        wk = vaddq_u32(m0, vld1q_u32(&SHA256_K[32]));
+        m0 = vsha256su0q_u32(m0, m1);
+        tmp = state0;
+        state0 = vsha256hq_u32(state0, state1, wk);
+        state1 = vsha256h2q_u32(state1, tmp, wk);
+        m0 = vsha256su1q_u32(m0, m2, m3);
+
+        /* rounds 36-39 */
+        wk = vaddq_u32(m1, vld1q_u32(&SHA256_K[36]));
+        m1 = vsha256su0q_u32(m1, m2);
+        tmp = state0;
+        state0 = vsha256hq_u32(state0, state1, wk);
+        state1 = vsha256h2q_u32(state1, tmp, wk);
+        m1 = vsha256su1q_u32(m1, m3, m0);
+
+        /* rounds 40-43 */
+        wk = vaddq_u32(m2, vld1q_u32(&SHA256_K[40]));
+        m2 = vsha256su0q_u32(m2, m3);
+        tmp = state0;
+        state0 = vsha256hq_u32(state0, state1, wk);
+        state1 = vsha256h2q_u32(state1, tmp, wk);
+        m2 = vsha256su1q_u32(m2, m0, m1);
+
+        /* rounds 44-47 */
+        wk = vaddq_u32(m3, vld1q_u32(&SHA256_K[44]));
+        m3 = vsha256su0q_u32(m3, m0);
+        tmp = state0;
+        state0 = vsha256hq_u32(state0, state1, wk);
+        state1 = vsha256h2q_u32(state1, tmp, wk);
+        m3 = vsha256su1q_u32(m3, m1, m2);
+
+        /* rounds 48-51 */
+        wk = vaddq_u32(m0, vld1q_u32(&SHA256_K[48]));
+        tmp = state0;
+        state0 = vsha256hq_u32(state0, state1, wk);
+        state1 = vsha256h2q_u32(state1, tmp, wk);
+
+        /* rounds 52-55 */
+        wk = vaddq_u32(m1, vld1q_u32(&SHA256_K[52]));
+        tmp = state0;
+        state0 = vsha256hq_u32(state0, state1, wk);
+        state1 = vsha256h2q_u32(state1, tmp, wk);
+
+        /* rounds 56-59 */
+        wk = vaddq_u32(m2, vld1q_u32(&SHA256_K[56]));
+        tmp = state0;
+        state0 = vsha256hq_u32(state0, state1, wk);
+        state1 = vsha256h2q_u32(state1, tmp, wk);
+
+        /* rounds 60-63 */
+        wk = vaddq_u32(m3, vld1q_u32(&SHA256_K[60]));
+        tmp = state0;
+        state0 = vsha256hq_u32(state0, state1, wk);
+        state1 = vsha256h2q_u32(state1, tmp, wk);
+
+        state0 = vaddq_u32(state0, abcd_save);
+        state1 = vaddq_u32(state1, efgh_save);
+    }
+
+    vst1q_u32(&h[0], state0);
+    vst1q_u32(&h[4], state1);
+}
+
+#endif /* SHA_USE_ARMV8 */
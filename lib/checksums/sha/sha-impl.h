@@ -0,0 +1,60 @@
+/*
+ * Internals shared by the SHA-1/SHA-256 block functions.
+ */
+
+#ifndef RM_SHA_IMPL_H
+#define RM_SHA_IMPL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../simd.h"
+#include "sha.h"
+
+/* Hash n_blocks consecutive 64 byte blocks into the state words h */
+typedef void (*sha_blocks_func)(uint32_t *h, const uint8_t *in, size_t n_blocks);
+
+extern const uint32_t SHA256_K[64];
+
+void sha1_blocks_ref(uint32_t *h, const uint8_t *in, size_t n_blocks);
+void sha256_blocks_ref(uint32_t *h, const uint8_t *in, size_t n_blocks);
+
+#if RM_SIMD_X86
+void sha1_blocks_shani(uint32_t *h, const uint8_t *in, size_t n_blocks);
+void sha256_blocks_shani(uint32_t *h, const uint8_t *in, size_t n_blocks);
+#endif
+
+/* older clang only offers the crypto intrinsics to -march=...+crypto builds */
+#if RM_SIMD_ARM64 && \
+    (defined(__ARM_FEATURE_CRYPTO) || !defined(__clang__) || __clang_major__ >= 16)
+#define SHA_USE_ARMV8 1
+#else
+#define SHA_USE_ARMV8 0
+#endif
+
+#if SHA_USE_ARMV8
+void sha1_blocks_armv8(uint32_t *h, const uint8_t *in, size_t n_blocks);
+void sha256_blocks_armv8(uint32_t *h, const uint8_t *in, size_t n_blocks);
+#endif
+
+static inline uint32_t sha_load32be(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) |
+           (uint32_t)p[3];
+}
+
+static inline void sha_store32be(uint8_t *p, uint32_t w) {
+    p[0] = (uint8_t)(w >> 24);
+    p[1] = (uint8_t)(w >> 16);
+    p[2] = (uint8_t)(w >> 8);
+    p[3] = (uint8_t)w;
+}
+
+static inline uint32_t sha_rotl32(uint32_t w, unsigned c) {
+    return (w << c) | (w >> (32 - c));
+}
+
+static inline uint32_t sha_rotr32(uint32_t w, unsigned c) {
+    return (w >> c) | (w << (32 - c));
+}
+
+#endif /* RM_SHA_IMPL_H */
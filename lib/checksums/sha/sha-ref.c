@@ -0,0 +1,97 @@
+/*
+ * Portable SHA-1/SHA-256 block functions.
+ */
+
+#include "sha-impl.h"
+
+const uint32_t SHA256_K[64] = {
+    0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4,
+    0xAB1C5ED5, 0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE,
+    0x9BDC06A7, 0xC19BF174, 0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F,
+    0x4A7484AA, 0x5CB0A9DC, 0x76F988DA, 0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7,
+    0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967, 0x27B70A85, 0x2E1B2138, 0x4D2C6DFC,
+    0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85, 0xA2BFE8A1, 0xA81A664B,
+    0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070, 0x19A4C116,
+    0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+    0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7,
+    0xC67178F2};
+
+/* one loop per round function, so that the rounds need no branches */
+#define SHA1_ROUNDS(FIRST, F, K)                                   \
+    for(int i = FIRST; i < FIRST + 20; i++) {                      \
+        uint32_t t = sha_rotl32(a, 5) + (F) + e + (K) + w[i];     \
+        e = d;                                                     \
+        d = c;                                                     \
+        c = sha_rotl32(b, 30);                                     \
+        b = a;                                                     \
+        a = t;                                                     \
+    }
+
+void sha1_blocks_ref(uint32_t *h, const uint8_t *in, size_t n_blocks) {
+    for(; n_blocks > 0; n_blocks--, in += SHA_BLOCK_LEN) {
+        uint32_t w[80];
+        for(int i = 0; i < 16; i++) {
+            w[i] = sha_load32be(in + 4 * i);
+        }
+        for(int i = 16; i < 80; i++) {
+            w[i] = sha_rotl32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        }
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        SHA1_ROUNDS(0, (b & c) | (~b & d), 0x5A827999);
+        SHA1_ROUNDS(20, b ^ c ^ d, 0x6ED9EBA1);
+        SHA1_ROUNDS(40, (b & c) | (b & d) | (c & d), 0x8F1BBCDC);
+        SHA1_ROUNDS(60, b ^ c ^ d, 0xCA62C1D6);
+
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+}
+
+void sha256_blocks_ref(uint32_t *h, const uint8_t *in, size_t n_blocks) {
+    for(; n_blocks > 0; n_blocks--, in += SHA_BLOCK_LEN) {
+        uint32_t w[64];
+        for(int i = 0; i < 16; i++) {
+            w[i] = sha_load32be(in + 4 * i);
+        }
+        for(int i = 16; i < 64; i++) {
+            uint32_t s0 =
+                sha_rotr32(w[i - 15], 7) ^ sha_rotr32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 =
+                sha_rotr32(w[i - 2], 17) ^ sha_rotr32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3];
+        uint32_t e = h[4], f = h[5], g = h[6], hh = h[7];
+        for(int i = 0; i < 64; i++) {
+            uint32_t S1 = sha_rotr32(e, 6) ^ sha_rotr32(e, 11) ^ sha_rotr32(e, 25);
+            uint32_t ch = (e & f) ^ (~e & g);
+            uint32_t t1 = hh + S1 + ch + SHA256_K[i] + w[i];
+            uint32_t S0 = sha_rotr32(a, 2) ^ sha_rotr32(a, 13) ^ sha_rotr32(a, 22);
+            uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+            uint32_t t2 = S0 + maj;
+
+            hh = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+        h[5] += f;
+        h[6] += g;
+        h[7] += hh;
+    }
+}
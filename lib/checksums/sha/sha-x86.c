@@ -0,0 +1,331 @@
+/*
+ * SHA-1/SHA-256 kernels for the x86 SHA extensions (SHA-NI).
+ *
+ * The round instructions keep the SHA-256 state split as ABEF/CDGH and the
+ * SHA-1 state as ABCD plus E in the top lane, so the state words are
+ * shuffled on entry and exit.
+ */
+
+#include "sha-impl.h"
+
+#if RM_SIMD_X86
+
+#include <immintrin.h>
+
+#define TARGET __attribute__((target("sha,sse4.1")))
+
+TARGET void sha1_blocks_shani(uint32_t *h, const uint8_t *in, size_t n_blocks) {
+    const __m128i bswap = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+
+    __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)h), 0x1B);
+    __m128i e0 = _mm_set_epi32((int)h[4], 0, 0, 0);
+
+    for(; n_blocks > 0; n_blocks--, in += SHA_BLOCK_LEN) {
+        __m128i abcd_save = abcd, e0_save = e0;
+        __m128i e1, m0, m1, m2, m3;
+
+        /* rounds 0-3 */
+        m0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(in + 0)), bswap);
+        e0 = _mm_add_epi32(e0, m0);
+        e1 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+
+        /* rounds 4-7 */
+        m1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(in + 16)), bswap);
+        e1 = _mm_sha1nexte_epu32(e1, m1);
+        e0 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+        m0 = _mm_sha1msg1_epu32(m0, m1);
+
+        /* rounds 8-11 */
+        m2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(in + 32)), bswap);
+        e0 = _mm_sha1nexte_epu32(e0, m2);
+        e1 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+        m1 = _mm_sha1msg1_epu32(m1, m2);
+        m0 = _mm_xor_si128(m0, m2);
+
+        /* rounds 12-15 */
+        m3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(in + 48)), bswap);
+        e1 = _mm_sha1nexte_epu32(e1, m3);
+        e0 = abcd;
+        m0 = _mm_sha1msg2_epu32(m0, m3);
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+        m2 = _mm_sha1msg1_epu32(m2, m3);
+        m1 = _mm_xor_si128(m1, m3);
+
+        /* rounds 16-19 */
+        e0 = _mm_sha1nexte_epu32(e0, m0);
+        e1 = abcd;
+        m1 = _mm_sha1msg2_epu32(m1, m0);
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+        m3 = _mm_sha1msg1_epu32(m3, m0);
+        m2 = _mm_xor_si128(m2, m0);
+
+        /* rounds 20-23 */
+        e1 = _mm_sha1nexte_epu32(e1, m1);
+        e0 = abcd;
+        m2 = _mm_sha1msg2_epu32(m2, m1);
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 1);
+        m0 = _mm_sha1msg1_epu32(m0, m1);
+        m3 = _mm_xor_si128(m3, m1);
+
+        /* rounds 24-27 */
+        e0 = _mm_sha1nexte_epu32(e0, m2);
+        e1 = abcd;
+        m3 = _mm_sha1msg2_epu32(m3, m2);
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 1);
+        m1 = _mm_sha1msg1_epu32(m1, m2);
+        m0 = _mm_xor_si128(m0, m2);
+
+        /* rounds 28-31 */
+        e1 = _mm_sha1nexte_epu32(e1, m3);
+        e0 = abcd;
+        m0 = _mm_sha1msg2_epu32(m0, m3);
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 1);
+        m2 = _mm_sha1msg1_epu32(m2, m3);
+        m1 = _mm_xor_si128(m1, m3);
+
+        /* rounds 32-35 */
+        e0 = _mm_sha1nexte_epu32(e0, m0);
+        e1 = abcd;
+        m1 = _mm_sha1msg2_epu32(m1, m0);
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 1);
+        m3 = _mm_sha1msg1_epu32(m3, m0);
+        m2 = _mm_xor_si128(m2, m0);
+
+        /* rounds 36-39 */
+        e1 = _mm_sha1nexte_epu32(e1, m1);
+        e0 = abcd;
+        m2 = _mm_sha1msg2_epu32(m2, m1);
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 1);
+        m0 = _mm_sha1msg1_epu32(m0, m1);
+        m3 = _mm_xor_si128(m3, m1);
+
+        /* rounds 40-43 */
+        e0 = _mm_sha1nexte_epu32(e0, m2);
+        e1 = abcd;
+        m3 = _mm_sha1msg2_epu32(m3, m2);
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 2);
+        m1 = _mm_sha1msg1_epu32(m1, m2);
+        m0 = _mm_xor_si128(m0, m2);
+
+        /* rounds 44-47 */
+        e1 = _mm_sha1nexte_epu32(e1, m3);
+        e0 = abcd;
+        m0 = _mm_sha1msg2_epu32(m0, m3);
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 2);
+        m2 = _mm_sha1msg1_epu32(m2, m3);
+        m1 = _mm_xor_si128(m1, m3);
+
+        /* rounds 48-51 */
+        e0 = _mm_sha1nexte_epu32(e0, m0);
+        e1 = abcd;
+        m1 = _mm_sha1msg2_epu32(m1, m0);
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 2);
+        m3 = _mm_sha1msg1_epu32(m3, m0);
+        m2 = _mm_xor_si128(m2, m0);
+
+        /* rounds 52-55 */
+        e1 = _mm_sha1nexte_epu32(e1, m1);
+        e0 = abcd;
+        m2 = _mm_sha1msg2_epu32(m2, m1);
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 2);
+        m0 = _mm_sha1msg1_epu32(m0, m1);
+        m3 = _mm_xor_si128(m3, m1);
+
+        /* rounds 56-59 */
+        e0 = _mm_sha1nexte_epu32(e0, m2);
+        e1 = abcd;
+        m3 = _mm_sha1msg2_epu32(m3, m2);
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 2);
+        m1 = _mm_sha1msg1_epu32(m1, m2);
+        m0 = _mm_xor_si128(m0, m2);
+
+        /* rounds 60-63 */
+        e1 = _mm_sha1nexte_epu32(e1, m3);
+        e0 = abcd;
+        m0 = _mm_sha1msg2_epu32(m0, m3);
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+        m2 = _mm_sha1msg1_epu32(m2, m3);
+        m1 = _mm_xor_si128(m1, m3);
+
+        /* rounds 64-67 */
+        e0 = _mm_sha1nexte_epu32(e0, m0);
+        e1 = abcd;
+        m1 = _mm_sha1msg2_epu32(m1, m0);
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 3);
+        m3 = _mm_sha1msg1_epu32(m3, m0);
+        m2 = _mm_xor_si128(m2, m0);
+
+        /* rounds 68-71 */
+        e1 = _mm_sha1nexte_epu32(e1, m1);
+        e0 = abcd;
+        m2 = _mm_sha1msg2_epu32(m2, m1);
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+        m3 = _mm_xor_si128(m3, m1);
+
+        /* rounds 72-75 */
+        e0 = _mm_sha1nexte_epu32(e0, m2);
+        e1 = abcd;
+        m3 = _mm_sha1msg2_epu32(m3, m2);
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 3);
+
+        /* rounds 76-79 */
+        e1 = _mm_sha1nexte_epu32(e1, m3);
+        e0 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+
+        e0 = _mm_sha1nexte_epu32(e0, e0_save);
+        abcd = _mm_add_epi32(abcd, abcd_save);
+    }
+
+    _mm_storeu_si128((__m128i *)h, _mm_shuffle_epi32(abcd, 0x1B));
+    h[4] = (uint32_t)_mm_extract_epi32(e0, 3);
+}
+
+TARGET void sha256_blocks_shani(uint32_t *h, const uint8_t *in, size_t n_blocks) {
+    const __m128i bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&h[0]), 0xB1); /* CDAB */
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&h[4]), 0x1B); /* EFGH */
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);                                   /* ABEF */
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);                                         /* CDGH */
+
+    for(; n_blocks > 0; n_blocks--, in += SHA_BLOCK_LEN) {
+        __m128i abef_save = state0, cdgh_save = state1;
+        __m128i wk, m0, m1, m2, m3;
+
+        /* rounds 0-3 */
+        m0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(in + 0)), bswap);
+        wk = _mm_add_epi32(m0, _mm_loadu_si128((const __m128i *)&SHA256_K[0]));
+        state1 = _mm_sha256rnds2_epu32(state1, state0, wk);
+        state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(wk, 0x0E));
+
+        /* rounds 4-7 */
+        m1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(in + 16)), bswap);
+        wk = _mm_add_epi32(m1, _mm_loadu_si128((const __m128i *)&SHA256_K[4]));
+        state1 = _mm_sha256rnds2_epu32(state1, state0, wk);
+        state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(wk, 0x0E));
+        m0 = _mm_sha256msg1_epu32(m0, m1);
+
+        /* rounds 8-11 */
+        m2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(in + 32)), bswap);
+        wk = _mm_add_epi32(m2, _mm_loadu_si128((const __m128i *)&SHA256_K[8]));
+        state1 = _mm_sha256rnds2_epu32(state1, state0, wk);
+        state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(wk, 0x0E));
+        m1 = _mm_sha256msg1_epu32(m1, m2);
+
+        /* rounds 12-15 */
+        m3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(in + 48)), bswap);
+        wk = _mm_add_epi32(m3, _mm_loadu_si128((const __m128i *)&SHA256_K[12]));
+        state1 = _mm_sha256rnds2_epu32(state1, state0, wk);
+        m0 = _mm_add_epi32(m0, _mm_alignr_epi8(m3, m2, 4));
+        m0 = _mm_sha256msg2_epu32(m0, m3);
+        state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(wk, 0x0E));
+        m2 = _mm_sha256msg1_epu32(m2, m3);
+
+        /* rounds 16-19 */
+        wk = _mm_add_epi32(m0, _mm_loadu_si128((const __m128i *)&SHA256_K[16]));
+        state1 = _mm_sha256rnds2_epu32(state1, state0, wk);
+        m1 = _mm_add_epi32(m1, _mm_alignr_epi8(m0, m3, 4));
+        m1 = _mm_sha256msg2_epu32(m1, m0);
+        state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(wk, 0x0E));
+        m3 = _mm_sha256msg1_epu32(m3, m0);
+
+        /* rounds 20-23 */
+        wk = _mm_add_epi32(m1, _mm_loadu_si128((const __m128i *)&SHA256_K[20]));
+        state1 = _mm_sha256rnds2_epu32(state1, state0, wk);
+        m2 = _mm_add_epi32(m2, _mm_alignr_epi8(m1, m0, 4));
+        m2 = _mm_sha256msg2_epu32(m2, m1);
+        state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(wk, 0x0E));
+        m0 = _mm_sha256msg1_epu32(m0, m1);
+
+        /* rounds 24-27 */
+        wk = _mm_add_epi32(m2, _mm_loadu_si128((const __m128i *)&SHA256_K[24]));
+        state1 = _mm_sha256rnds2_epu32(state1, state0, wk);
+        m3 = _mm_add_epi32(m3, _mm_alignr_epi8(m2, m1, 4));
+        m3 = _mm_sha256msg2_epu32(m3, m2);
+        state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(wk, 0x0E));
+        m1 = _mm_sha256msg1_epu32(m1, m2);
+
+        /* rounds 28-31 */
+        wk = _mm_add_epi32(m3, _mm_loadu_si128((const __m128i *)&SHA256_K[28]));
+        state1 = _mm_sha256rnds2_epu32(state1, state0, wk);
+        m0 = _mm_add_epi32(m0, _mm_alignr_epi8(m3, m2, 4));
+        m0 = _mm_sha256msg2_epu32(m0, m3);
+        state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(wk, 0x0E));
+        m2 = _mm_sha256msg1_epu32(m2, m3);
+
+        /* rounds 32-35 */
+        wk = _mm_add_epi32(m0, _mm_loadu_si128((const __m128i *)&SHA256_K[32]));
+        state1 = _mm_sha256rnds2_epu32(state1, state0, wk);
+        m1 = _mm_add_epi32(m1, _mm_alignr_epi8(m0, m3, 4));
+        m1 = _mm_sha256msg2_epu32(m1, m0);
+        state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(wk, 0x0E));
+        m3 = _mm_sha256msg1_epu32(m3, m0);
+
+        /* rounds 36-39 */
+        wk = _mm_add_epi32(m1, _mm_loadu_si128((const __m128i *)&SHA256_K[36]));
+        state1 = _mm_sha256rnds2_epu32(state1, state0, wk);
+        m2 = _mm_add_epi32(m2, _mm_alignr_epi8(m1, m0, 4));
+        m2 = _mm_sha256msg2_epu32(m2, m1);
+        state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(wk, 0x0E));
+        m0 = _mm_sha256msg1_epu32(m0, m1);
+
+        /* rounds 40-43 */
+        wk = _mm_add_epi32(m2, _mm_loadu_si128((const __m128i *)&SHA256_K[40]));
+        state1 = _mm_sha256rnds2_epu32(state1, state0, wk);
+        m3 = _mm_add_epi32(m3, _mm_alignr_epi8(m2, m1, 4));
+        m3 = _mm_sha256msg2_epu32(m3, m2);
+        state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(wk, 0x0E));
+        m1 = _mm_sha256msg1_epu32(m1, m2);
+
+        /* rounds 44-47 */
+        wk = _mm_add_epi32(m3, _mm_loadu_si128((const __m128i *)&SHA256_K[44]));
+        state1 = _mm_sha256rnds2_epu32(state1, state0, wk);
+        m0 = _mm_add_epi32(m0, _mm_alignr_epi8(m3, m2, 4));
+        m0 = _mm_sha256msg2_epu32(m0, m3);
+        state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(wk, 0x0E));
+        m2 = _mm_sha256msg1_epu32(m2, m3);
+
+        /* rounds 48-51 */
+        wk = _mm_add_epi32(m0, _mm_loadu_si128((const __m128i *)&SHA256_K[48]));
+        state1 = _mm_sha256rnds2_epu32(state1, state0, wk);
+        m1 = _mm_add_epi32(m1, _mm_alignr_epi8(m0, m3, 4));
+        m1 = _mm_sha256msg2_epu32(m1, m0);
+        state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(wk, 0x0E));
+        m3 = _mm_sha256msg1_epu32(m3, m0);
+
+        /* rounds 52-55 */
+        wk = _mm_add_epi32(m1, _mm_loadu_si128((const __m128i *)&SHA256_K[52]));
+        state1 = _mm_sha256rnds2_epu32(state1, state0, wk);
+        m2 = _mm_add_epi32(m2, _mm_alignr_epi8(m1, m0, 4));
+        m2 = _mm_sha256msg2_epu32(m2, m1);
+        state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(wk, 0x0E));
+
+        /* rounds 56-59 */
+        wk = _mm_add_epi32(m2, _mm_loadu_si128((const __m128i *)&SHA256_K[56]));
+        state1 = _mm_sha256rnds2_epu32(state1, state0, wk);
+        m3 = _mm_add_epi32(m3, _mm_alignr_epi8(m2, m1, 4));
+        m3 = _mm_sha256msg2_epu32(m3, m2);
+        state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(wk, 0x0E));
+
+        /* rounds 60-63 */
+        wk = _mm_add_epi32(m3, _mm_loadu_si128((const __m128i *)&SHA256_K[60]));
+        state1 = _mm_sha256rnds2_epu32(state1, state0, wk);
+        state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(wk, 0x0E));
+
+        state0 = _mm_add_epi32(state0, abef_save);
+        state1 = _mm_add_epi32(state1, cdgh_save);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B);       /* FEBA */
+    state1 = _mm_shuffle_epi32(state1, 0xB1);    /* DCHG */
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0); /* DCBA */
+    state1 = _mm_alignr_epi8(state1, tmp, 8);    /* HGFE */
+    _mm_storeu_si128((__m128i *)&h[0], state0);
+    _mm_storeu_si128((__m128i *)&h[4], state1);
+}
+
+#endif /* RM_SIMD_X86 */
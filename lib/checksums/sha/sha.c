@@ -0,0 +1,150 @@
+/*
+ * SHA-1/SHA-256 buffering, padding and kernel selection.
+ */
+
+#include <string.h>
+
+#include "sha-impl.h"
+
+typedef enum {
+    SHA_KERNEL_REF,
+    SHA_KERNEL_SHANI,
+    SHA_KERNEL_ARMV8,
+} sha_kernel;
+
+static sha_kernel sha_select(void) {
+    if(!rm_simd_has_sha()) {
+        return SHA_KERNEL_REF;
+    }
+#if RM_SIMD_X86
+    return SHA_KERNEL_SHANI;
+#elif SHA_USE_ARMV8
+    return SHA_KERNEL_ARMV8;
+#else
+    return SHA_KERNEL_REF;
+#endif
+}
+
+const char *sha_kernel_name(void) {
+    switch(sha_select()) {
+    case SHA_KERNEL_SHANI:
+        return "sha-ni";
+    case SHA_KERNEL_ARMV8:
+        return "armv8";
+    default:
+        return "portable";
+    }
+}
+
+static sha_blocks_func sha1_blocks(void) {
+    switch(sha_select()) {
+#if RM_SIMD_X86
+    case SHA_KERNEL_SHANI:
+        return sha1_blocks_shani;
+#endif
+#if SHA_USE_ARMV8
+    case SHA_KERNEL_ARMV8:
+        return sha1_blocks_armv8;
+#endif
+    default:
+        return sha1_blocks_ref;
+    }
+}
+
+static sha_blocks_func sha256_blocks(void) {
+    switch(sha_select()) {
+#if RM_SIMD_X86
+    case SHA_KERNEL_SHANI:
+        return sha256_blocks_shani;
+#endif
+#if SHA_USE_ARMV8
+    case SHA_KERNEL_ARMV8:
+        return sha256_blocks_armv8;
+#endif
+    default:
+        return sha256_blocks_ref;
+    }
+}
+
+/* Both algorithms share the Merkle-Damgard framing: 64 byte blocks, and a
+ * final block padded with 0x80, zeros and the big endian bit length */
+
+static void sha_update(uint32_t *h, uint64_t *len, uint8_t *buf, const uint8_t *in,
+                       size_t inlen, sha_blocks_func blocks) {
+    size_t fill = *len % SHA_BLOCK_LEN;
+    *len += inlen;
+
+    if(fill > 0) {
+        size_t take = SHA_BLOCK_LEN - fill;
+        if(inlen < take) {
+            memcpy(buf + fill, in, inlen);
+            return;
+        }
+        memcpy(buf + fill, in, take);
+        blocks(h, buf, 1);
+        in += take;
+        inlen -= take;
+    }
+
+    if(inlen >= SHA_BLOCK_LEN) {
+        blocks(h, in, inlen / SHA_BLOCK_LEN);
+        in += inlen - inlen % SHA_BLOCK_LEN;
+        inlen %= SHA_BLOCK_LEN;
+    }
+
+    memcpy(buf, in, inlen);
+}
+
+static void sha_final(uint32_t *h, uint64_t len, const uint8_t *buf, sha_blocks_func blocks,
+                      uint8_t *out, size_t n_words) {
+    uint8_t last[2 * SHA_BLOCK_LEN] = {0};
+    size_t fill = len % SHA_BLOCK_LEN;
+    size_t n_blocks = (fill + 1 + 8 > SHA_BLOCK_LEN) ? 2 : 1;
+
+    memcpy(last, buf, fill);
+    last[fill] = 0x80;
+
+    uint64_t bits = len * 8;
+    for(int i = 0; i < 8; i++) {
+        last[n_blocks * SHA_BLOCK_LEN - 1 - i] = (uint8_t)(bits >> (8 * i));
+    }
+
+    blocks(h, last, n_blocks);
+    for(size_t i = 0; i < n_words; i++) {
+        sha_store32be(out + 4 * i, h[i]);
+    }
+}
+
+void sha1_init(sha1_state *S) {
+    static const uint32_t iv[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476,
+                                   0xC3D2E1F0};
+    memcpy(S->h, iv, sizeof(iv));
+    S->len = 0;
+}
+
+void sha1_update(sha1_state *S, const void *in, size_t inlen) {
+    sha_update(S->h, &S->len, S->buf, in, inlen, sha1_blocks());
+}
+
+void sha1_final(const sha1_state *S, uint8_t out[SHA1_OUT_LEN]) {
+    uint32_t h[5];
+    memcpy(h, S->h, sizeof(h));
+    sha_final(h, S->len, S->buf, sha1_blocks(), out, 5);
+}
+
+void sha256_init(sha256_state *S) {
+    static const uint32_t iv[8] = {0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+                                   0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19};
+    memcpy(S->h, iv, sizeof(iv));
+    S->len = 0;
+}
+
+void sha256_update(sha256_state *S, const void *in, size_t inlen) {
+    sha_update(S->h, &S->len, S->buf, in, inlen, sha256_blocks());
+}
+
+void sha256_final(const sha256_state *S, uint8_t out[SHA256_OUT_LEN]) {
+    uint32_t h[8];
+    memcpy(h, S->h, sizeof(h));
+    sha_final(h, S->len, S->buf, sha256_blocks(), out, 8);
+}
@@ -0,0 +1,43 @@
+/*
+ * SHA-1 and SHA-256 (FIPS 180-4) for rmlint.
+ *
+ * The block functions use the SHA-NI instructions on x86-64 and the crypto
+ * extensions on ARMv8 when rm_simd_has_sha() allows it; otherwise the
+ * portable C code is used.
+ */
+
+#ifndef RM_SHA_H
+#define RM_SHA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA_BLOCK_LEN 64
+#define SHA1_OUT_LEN 20
+#define SHA256_OUT_LEN 32
+
+typedef struct {
+    uint32_t h[5];
+    uint64_t len;
+    uint8_t buf[SHA_BLOCK_LEN];
+} sha1_state;
+
+typedef struct {
+    uint32_t h[8];
+    uint64_t len;
+    uint8_t buf[SHA_BLOCK_LEN];
+} sha256_state;
+
+void sha1_init(sha1_state *S);
+void sha1_update(sha1_state *S, const void *in, size_t inlen);
+/* does not modify S, so more data may be added afterwards */
+void sha1_final(const sha1_state *S, uint8_t out[SHA1_OUT_LEN]);
+
+void sha256_init(sha256_state *S);
+void sha256_update(sha256_state *S, const void *in, size_t inlen);
+void sha256_final(const sha256_state *S, uint8_t out[SHA256_OUT_LEN]);
+
+/* Name of the kernel used for both algorithms */
+const char *sha_kernel_name(void);
+
+#endif /* RM_SHA_H */
@@ -0,0 +1,98 @@
+#include "simd.h"
+
+#if RM_SIMD_X86
+#include <cpuid.h>
+#elif RM_SIMD_ARM64
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#endif
+
+#define RM_SIMD_UNKNOWN -1
+
+/* written once at startup; racing readers would only detect the same value
+ * again */
+static volatile int rm_simd_detected = RM_SIMD_UNKNOWN;
+static volatile int rm_simd_crc32 = RM_SIMD_UNKNOWN;
+static volatile int rm_simd_sha = RM_SIMD_UNKNOWN;
+static volatile int rm_simd_max_level = RM_SIMD_AVX512;
+
+static int rm_simd_detect(void) {
+#if RM_SIMD_X86
+    if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl")) {
+        return RM_SIMD_AVX512;
+    }
+    if(__builtin_cpu_supports("avx2")) {
+        return RM_SIMD_AVX2;
+    }
+    if(__builtin_cpu_supports("sse4.1")) {
+        return RM_SIMD_SSE41;
+    }
+#endif
+    return RM_SIMD_NONE;
+}
+
+static int rm_simd_detect_crc32(void) {
+#if RM_SIMD_X86 && HAVE_MM_CRC32_U64
+    return __builtin_cpu_supports("sse4.2");
+#else
+    return false;
+#endif
+}
+
+static int rm_simd_detect_sha(void) {
+#if RM_SIMD_X86
+    /* not every compiler knows "sha" for __builtin_cpu_supports() */
+    unsigned int eax, ebx, ecx, edx;
+    if(!__builtin_cpu_supports("sse4.1") ||
+       !__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+        return false;
+    }
+    return (ebx & bit_SHA) != 0;
+#elif RM_SIMD_ARM64
+    unsigned long hwcap = getauxval(AT_HWCAP);
+    return (hwcap & HWCAP_SHA1) && (hwcap & HWCAP_SHA2);
+#else
+    return false;
+#endif
+}
+
+RmSimdLevel rm_simd_level(void) {
+    int level = rm_simd_detected;
+    if(level == RM_SIMD_UNKNOWN) {
+        level = rm_simd_detected = rm_simd_detect();
+    }
+    return (level < rm_simd_max_level) ? level : rm_simd_max_level;
+}
+
+void rm_simd_set_max_level(RmSimdLevel max_level) {
+    rm_simd_max_level = max_level;
+}
+
+bool rm_simd_has_crc32(void) {
+    int crc32 = rm_simd_crc32;
+    if(crc32 == RM_SIMD_UNKNOWN) {
+        crc32 = rm_simd_crc32 = rm_simd_detect_crc32();
+    }
+    return crc32 && rm_simd_max_level > RM_SIMD_NONE;
+}
+
+bool rm_simd_has_sha(void) {
+    int sha = rm_simd_sha;
+    if(sha == RM_SIMD_UNKNOWN) {
+        sha = rm_simd_sha = rm_simd_detect_sha();
+    }
+    return sha && rm_simd_max_level > RM_SIMD_NONE;
+}
+
+const char *rm_simd_level_name(RmSimdLevel level) {
+    switch(level) {
+    case RM_SIMD_AVX512:
+        return "avx512";
+    case RM_SIMD_AVX2:
+        return "avx2";
+    case RM_SIMD_SSE41:
+        return "sse4.1";
+    default:
+        return "portable";
+    }
+}
@@ -0,0 +1,58 @@
+/*
+ * Runtime selection of the SIMD hash kernels.
+ *
+ * Kernels are compiled with per-function target attributes, so a generic
+ * build (e.g. a distribution package) carries all of them.  The CPU is probed
+ * once; every algorithm then uses the widest kernel it has up to
+ * rm_simd_level().
+ */
+
+#ifndef RM_SIMD_H
+#define RM_SIMD_H
+
+#include <stdbool.h>
+
+#include "../config.h"
+
+/* the x86 kernels need target attributes and __builtin_cpu_supports() */
+#if HAVE_BUILTIN_CPU_SUPPORTS && defined(__x86_64__) && \
+    (defined(__GNUC__) || defined(__clang__))
+#define RM_SIMD_X86 1
+#else
+#define RM_SIMD_X86 0
+#endif
+
+/* the ARMv8 crypto kernels are probed through getauxval() */
+#if defined(__aarch64__) && defined(__linux__) && \
+    (defined(__GNUC__) || defined(__clang__))
+#define RM_SIMD_ARM64 1
+#else
+#define RM_SIMD_ARM64 0
+#endif
+
+/* instruction set levels, in increasing order */
+typedef enum RmSimdLevel {
+    RM_SIMD_NONE = 0,
+    RM_SIMD_SSE41,
+    RM_SIMD_AVX2,
+    RM_SIMD_AVX512,
+} RmSimdLevel;
+
+/* Level the kernels may use: what the CPU supports, capped by
+ * rm_simd_set_max_level() */
+RmSimdLevel rm_simd_level(void);
+
+/* Cap the level, e.g. RM_SIMD_NONE to use the portable code only */
+void rm_simd_set_max_level(RmSimdLevel max_level);
+
+/* True if the SSE4.2 crc32 instruction may be used */
+bool rm_simd_has_crc32(void);
+
+/* True if the SHA-1/SHA-256 instructions may be used (SHA-NI on x86, the
+ * crypto extensions on ARMv8) */
+bool rm_simd_has_sha(void);
+
+/* "portable", "sse4.1", "avx2" or "avx512" */
+const char *rm_simd_level_name(RmSimdLevel level);
+
+#endif /* RM_SIMD_H */
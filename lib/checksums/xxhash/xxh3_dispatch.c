@@ -0,0 +1,80 @@
+/*
+ * XXH3 streaming update with runtime kernel selection.
+ *
+ * The accumulate/scramble kernels of xxhash.h are instantiated once per
+ * instruction set (guarded by target attributes), so a generic build can use
+ * AVX2 or AVX-512 where the CPU has them.  All kernels give identical hashes.
+ */
+
+#include "../simd.h"
+
+#if RM_SIMD_X86
+
+#include <immintrin.h>
+
+#define XXH_DISPATCH_AVX2 1
+#define XXH_DISPATCH_AVX512 1
+#define XXH_TARGET_SSE2 __attribute__((target("sse2")))
+#define XXH_TARGET_AVX2 __attribute__((target("avx2")))
+#define XXH_TARGET_AVX512 __attribute__((target("avx512f")))
+
+/* private copy of xxhash with the kernels of all instruction sets */
+#define XXH_INLINE_ALL
+#define XXH_X86DISPATCH
+#include "xxhash.h"
+
+#define RM_XXH3_DEFINE_UPDATE(suffix, target)                                       \
+    XXH_NO_INLINE target XXH_errorcode rm_xxh3_update_##suffix(                     \
+        XXH3_state_t *state, const void *input, size_t len) {                       \
+        return XXH3_update(state, (const xxh_u8 *)input, len,                       \
+                           XXH3_accumulate_##suffix, XXH3_scrambleAcc_##suffix);    \
+    }
+
+RM_XXH3_DEFINE_UPDATE(scalar, )
+RM_XXH3_DEFINE_UPDATE(sse2, XXH_TARGET_SSE2)
+RM_XXH3_DEFINE_UPDATE(avx2, XXH_TARGET_AVX2)
+RM_XXH3_DEFINE_UPDATE(avx512, XXH_TARGET_AVX512)
+
+#undef RM_XXH3_DEFINE_UPDATE
+
+#include "xxh3_dispatch.h"
+
+XXH_errorcode XXH3_64bits_update_dispatch(XXH3_state_t *state, const void *input,
+                                          size_t len) {
+    switch(rm_simd_level()) {
+    case RM_SIMD_AVX512:
+        return rm_xxh3_update_avx512(state, input, len);
+    case RM_SIMD_AVX2:
+        return rm_xxh3_update_avx2(state, input, len);
+    case RM_SIMD_SSE41:
+        return rm_xxh3_update_sse2(state, input, len);
+    default:
+        return rm_xxh3_update_scalar(state, input, len);
+    }
+}
+
+const char *XXH3_dispatch_name(void) {
+    const RmSimdLevel level = rm_simd_level();
+    return (level == RM_SIMD_SSE41) ? "sse2" : rm_simd_level_name(level);
+}
+
+#else /* !RM_SIMD_X86 */
+
+#include "xxh3_dispatch.h"
+
+XXH_errorcode XXH3_64bits_update_dispatch(XXH3_state_t *state, const void *input,
+                                          size_t len) {
+    return XXH3_64bits_update(state, input, len);
+}
+
+const char *XXH3_dispatch_name(void) {
+    return "default";
+}
+
+#endif /* RM_SIMD_X86 */
+
+XXH_errorcode XXH3_128bits_update_dispatch(XXH3_state_t *state, const void *input,
+                                           size_t len) {
+    /* both variants share the same state and update */
+    return XXH3_64bits_update_dispatch(state, input, len);
+}
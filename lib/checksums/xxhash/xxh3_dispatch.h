@@ -0,0 +1,21 @@
+/*
+ * Runtime selection of the XXH3 kernels (scalar, SSE2, AVX2 or AVX-512) for
+ * streaming input, following xxHash's own xxh_x86dispatch.c.
+ */
+
+#ifndef RM_XXH3_DISPATCH_H
+#define RM_XXH3_DISPATCH_H
+
+#include "xxhash.h"
+
+/* Same as XXH3_64bits_update() / XXH3_128bits_update(), using the widest
+ * kernel allowed by rm_simd_level() */
+XXH_errorcode XXH3_64bits_update_dispatch(XXH3_state_t *state, const void *input,
+                                          size_t len);
+XXH_errorcode XXH3_128bits_update_dispatch(XXH3_state_t *state, const void *input,
+                                           size_t len);
+
+/* Name of the kernel used by the functions above */
+const char *XXH3_dispatch_name(void);
+
+#endif /* RM_XXH3_DISPATCH_H */
@@ -78,6 +78,7 @@ static void rm_cmd_show_version(void) {
                     {.name = "replay",         .enabled = HAVE_JSON_GLIB},
                     {.name = "xattr",          .enabled = HAVE_XATTR},
                     {.name = "btrfs-support",  .enabled = HAVE_BTRFS_H},
+                    {.name = "io-uring",       .enabled = HAVE_IO_URING},
                     {.name = NULL,             .enabled = 0}};
     /* clang-format on */
 
@@ -86,6 +87,25 @@ static void rm_cmd_show_version(void) {
         fprintf(stderr, " %c%s", (features[i].enabled) ? '+' : '-', features[i].name);
     }
 
+    /* Kernels picked for this CPU (one per family of digests) */
+    static const RmDigestType kernel_types[] = {RM_DIGEST_BLAKE2B,
+                                                RM_DIGEST_BLAKE2S,
+                                                RM_DIGEST_BLAKE3,
+                                                RM_DIGEST_HIGHWAY256,
+                                                RM_DIGEST_SHA256,
+                                                RM_DIGEST_PARANOID,
+#if HAVE_MM_CRC32_U64
+                                                RM_DIGEST_METROCRC,
+#endif
+                                                RM_DIGEST_XXH3_64};
+
+    fprintf(stderr, "\n");
+    fprintf(stderr, _("hash kernels:"));
+    for(size_t i = 0; i < sizeof(kernel_types) / sizeof(kernel_types[0]); ++i) {
+        fprintf(stderr, " %s=%s", rm_digest_type_to_string(kernel_types[i]),
+                rm_digest_kernel_name(kernel_types[i]));
+    }
+
     fprintf(stderr, RESET "\n\n");
     fprintf(stderr, _("rmlint was written by Christopher <sahib> Pahl and Daniel "
                       "<SeeSpotRun> Thomas."));
@@ -989,6 +1009,31 @@ static gboolean rm_cmd_parse_read_buf_len(_UNUSED const char *option_name,
     return (rm_cmd_parse_mem(size_spec, error, &session->cfg->read_buf_len));
 }
 
+static gboolean rm_cmd_parse_mmap_threshold(_UNUSED const char *option_name,
+                                            const gchar *size_spec, RmSession *session,
+                                            GError **error) {
+    return (rm_cmd_parse_mem(size_spec, error, &session->cfg->mmap_threshold));
+}
+
+static gboolean rm_cmd_parse_read_budget(_UNUSED const char *option_name,
+                                         const gchar *size_spec, RmSession *session,
+                                         GError **error) {
+    return (rm_cmd_parse_mem(size_spec, error, &session->cfg->read_budget));
+}
+
+static gboolean rm_cmd_parse_paranoid_spill_dir(_UNUSED const char *option_name,
+                                                const gchar *dir, RmSession *session,
+                                                GError **error) {
+    if(!g_file_test(dir, G_FILE_TEST_IS_DIR)) {
+        g_set_error(error, RM_ERROR_QUARK, 0, _("Not a directory: %s"), dir);
+        return false;
+    }
+
+    g_free(session->cfg->paranoid_spill_dir);
+    session->cfg->paranoid_spill_dir = g_strdup(dir);
+    return true;
+}
+
 static gboolean rm_cmd_parse_sweep_size(_UNUSED const char *option_name,
                                         const gchar *size_spec, RmSession *session,
                                         GError **error) {
@@ -1422,6 +1467,7 @@ bool rm_cmd_parse_args(int argc, char **argv, RmSession *session) {
         {"followlinks"              , 'f'  , EMPTY     , G_OPTION_ARG_CALLBACK  , FUNC(follow_symlinks)          , _("Follow symlinks")                                                      , NULL}     ,
         {"no-followlinks"           , 'F'  , EMPTY     , G_OPTION_ARG_CALLBACK  , FUNC(no_follow_symlinks)       , _("Ignore symlinks")                                                      , NULL}     ,
         {"paranoid"                 , 'p'  , EMPTY     , G_OPTION_ARG_CALLBACK  , FUNC(paranoid)                 , _("Use more paranoid hashing")                                            , NULL}     ,
+        {"verify"                   , 0    , 0         , G_OPTION_ARG_NONE      , &cfg->verify                   , _("Compare found duplicates byte-by-byte")                                , NULL}     ,
         {"no-crossdev"              , 'x'  , DISABLE   , G_OPTION_ARG_NONE      , &cfg->crossdev                 , _("Do not cross mountpoints")                                             , NULL}     ,
         {"keep-all-tagged"          , 'k'  , 0         , G_OPTION_ARG_NONE      , &cfg->keep_all_tagged          , _("Keep all tagged files")                                                , NULL}     ,
         {"keep-all-untagged"        , 'K'  , 0         , G_OPTION_ARG_NONE      , &cfg->keep_all_untagged        , _("Keep all untagged files")                                              , NULL}     ,
@@ -1481,6 +1527,7 @@ bool rm_cmd_parse_args(int argc, char **argv, RmSession *session) {
         {"clamp-top"              , 'Q' , 0                , G_OPTION_ARG_CALLBACK , FUNC(clamp_top)              , "Limit upper reading barrier"                                 , "P"}    ,
         {"limit-mem"              , 'u' , HIDDEN           , G_OPTION_ARG_CALLBACK , FUNC(limit_mem)              , "Specify max. memory usage target"                            , "S"}    ,
         {"read-buffer-len"        , 0   , HIDDEN           , G_OPTION_ARG_CALLBACK , FUNC(read_buf_len)           , "Specify read buffer length in bytes"                         , "S"}    ,
+        {"paranoid-spill-dir"     , 0   , 0                , G_OPTION_ARG_CALLBACK , FUNC(paranoid_spill_dir)     , "Keep --paranoid data in a scratch file in this directory"    , "DIR"}  ,
         {"sweep-size"             , 0   , HIDDEN           , G_OPTION_ARG_CALLBACK , FUNC(sweep_size)             , "Specify max. bytes per pass when scanning disks"             , "S"}    ,
         {"sweep-files"            , 0   , HIDDEN           , G_OPTION_ARG_CALLBACK , FUNC(sweep_count)            , "Specify max. file count per pass when scanning disks"        , "S"}    ,
         {"threads"                , 't' , HIDDEN           , G_OPTION_ARG_INT64    , &cfg->threads                , "Specify max. number of hasher threads"                       , "N"}    ,
@@ -1497,8 +1544,15 @@ bool rm_cmd_parse_args(int argc, char **argv, RmSession *session) {
         {"fake-fiemap"            , 0   , HIDDEN           , G_OPTION_ARG_NONE     , &cfg->fake_fiemap            , "Create faked fiemap data for all files"                      , NULL}   ,
         {"fake-abort"             , 0   , HIDDEN           , G_OPTION_ARG_NONE     , &cfg->fake_abort             , "Simulate interrupt after 10% shredder progress"              , NULL}   ,
         {"buffered-read"          , 0   , HIDDEN           , G_OPTION_ARG_NONE     , &cfg->use_buffered_read      , "Default to buffered reading calls (fread) during reading."   , NULL}   ,
+        {"direct-io"              , 0   , 0                , G_OPTION_ARG_NONE     , &cfg->use_direct_io          , "Bypass the page cache when reading files"                    , NULL}   ,
+        {"mmap-threshold"         , 0   , 0                , G_OPTION_ARG_CALLBACK , FUNC(mmap_threshold)         , "mmap() files of at least this size instead of reading them"  , "S"}    ,
+        {"sample-pages"           , 0   , 0                , G_OPTION_ARG_INT      , &cfg->sample_pages           , "Hash N pages spread over large files before reading them"    , "N"}    ,
+        {"cluster-reflinks"       , 0   , 0                , G_OPTION_ARG_NONE     , &cfg->cluster_reflinks       , "Read files sharing all their extents only once"              , NULL}   ,
+        {"time-budget"            , 0   , 0                , G_OPTION_ARG_DOUBLE   , &cfg->time_budget            , "Stop reading after T seconds and output what was found"      , "T"}    ,
+        {"read-budget"            , 0   , 0                , G_OPTION_ARG_CALLBACK , FUNC(read_budget)            , "Stop reading after S bytes and output what was found"        , "S"}    ,
         {"shred-never-wait"       , 0   , HIDDEN           , G_OPTION_ARG_NONE     , &cfg->shred_never_wait       , "Never waits for file increment to finish hashing"            , NULL}   ,
         {"no-sse"                 , 0   , HIDDEN           , G_OPTION_ARG_NONE     , &cfg->no_sse                 , "Don't use SSE accelerations"                                 , NULL}   ,
+        {"no-io-uring"            , 0   , HIDDEN           , G_OPTION_ARG_NONE     , &cfg->no_io_uring            , "Don't use io_uring for reading, even if supported"          , NULL}   ,
         {"no-mount-table"         , 0   , DISABLE | HIDDEN , G_OPTION_ARG_NONE     , &cfg->list_mounts            , "Do not try to optimize by listing mounted volumes"           , NULL}   ,
         {NULL                     , 0   , HIDDEN           , 0                     , NULL                         , NULL                                                          , NULL}
     };
@@ -1674,9 +1728,7 @@ bool rm_cmd_parse_args(int argc, char **argv, RmSession *session) {
         );
     }
 
-#if HAVE_BUILTIN_CPU_SUPPORTS && HAVE_MM_CRC32_U64
-    rm_digest_enable_sse(!cfg->no_sse && __builtin_cpu_supports("sse4.2"));
-#endif
+    rm_digest_enable_sse(!cfg->no_sse);
 
 cleanup:
     if(error != NULL) {
@@ -1719,6 +1771,7 @@ static int rm_cmd_replay_main(RmSession *session) {
     rm_fmt_flush(session->formats);
     rm_fmt_set_state(session->formats, RM_PROGRESS_STATE_PRE_SHUTDOWN);
     rm_fmt_set_state(session->formats, RM_PROGRESS_STATE_SUMMARY);
+    session->fast_exit = true;
 
     rm_parrot_cage_close(&cage);
     return EXIT_SUCCESS;
@@ -1832,6 +1885,9 @@ int rm_cmd_main(RmSession *session) {
     rm_fmt_set_state(session->formats, RM_PROGRESS_STATE_PRE_SHUTDOWN);
     rm_fmt_set_state(session->formats, RM_PROGRESS_STATE_SUMMARY);
 
+    /* nothing looks at the files any more */
+    session->fast_exit = true;
+
     if(session->shred_bytes_remaining != 0) {
         rm_log_error_line("BUG: Number of remaining bytes is %" LLU
                           " (not 0). Please report this.",
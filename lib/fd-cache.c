@@ -0,0 +1,202 @@
+/*
+ *  This file is part of rmlint.
+ *
+ *  rmlint is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  rmlint is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with rmlint.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *
+ *  - Christopher <sahib> Pahl 2010-2020 (https://github.com/sahib)
+ *  - Daniel <SeeSpotRun> T.   2014-2020 (https://github.com/SeeSpotRun)
+ *
+ * Hosted on http://github.com/sahib/rmlint
+ *
+ */
+
+#include <sys/resource.h>
+
+#include "fd-cache.h"
+#include "utilities.h"
+
+/* Descriptors kept back from the cache for everything else
+ * (stdio, output files, batched reads, ...) */
+#define RM_FD_CACHE_RESERVED (256)
+
+/* More than that does not buy anything but kernel memory */
+#define RM_FD_CACHE_MAX (4096)
+
+typedef struct RmFdCacheEntry {
+    gconstpointer key;
+    int fd;
+
+    /* position in RmFdCache.lru */
+    GList link;
+} RmFdCacheEntry;
+
+struct _RmFdCache {
+    /* key -> RmFdCacheEntry */
+    GHashTable *entries;
+
+    /* most recently used entries at the head */
+    GQueue lru;
+
+    guint capacity;
+    GMutex lock;
+
+    /* statistics for the debug log */
+    guint64 hits;
+    guint64 misses;
+    guint64 evictions;
+};
+
+guint rm_fd_cache_default_capacity(void) {
+    struct rlimit limit;
+    if(getrlimit(RLIMIT_NOFILE, &limit) == -1) {
+        rm_log_perror("getrlimit(RLIMIT_NOFILE) failed");
+        return 0;
+    }
+
+    if(limit.rlim_cur == RLIM_INFINITY) {
+        return RM_FD_CACHE_MAX;
+    }
+
+    if(limit.rlim_cur <= RM_FD_CACHE_RESERVED) {
+        return 0;
+    }
+
+    /* only use half of what's left; the limit is per process */
+    return MIN((limit.rlim_cur - RM_FD_CACHE_RESERVED) / 2, RM_FD_CACHE_MAX);
+}
+
+RmFdCache *rm_fd_cache_new(guint capacity) {
+    RmFdCache *self = g_slice_new0(RmFdCache);
+    self->entries = g_hash_table_new(NULL, NULL);
+    self->capacity = capacity;
+    g_queue_init(&self->lru);
+    g_mutex_init(&self->lock);
+    return self;
+}
+
+static void rm_fd_cache_entry_close(RmFdCacheEntry *entry) {
+    rm_sys_close(entry->fd);
+    g_slice_free(RmFdCacheEntry, entry);
+}
+
+/* caller must hold cache->lock */
+static void rm_fd_cache_unlink(RmFdCache *self, RmFdCacheEntry *entry) {
+    g_queue_unlink(&self->lru, &entry->link);
+    g_hash_table_remove(self->entries, entry->key);
+}
+
+void rm_fd_cache_free(RmFdCache *self) {
+    if(!self) {
+        return;
+    }
+
+    rm_log_debug_line("fd cache: %" G_GUINT64_FORMAT " hits, %" G_GUINT64_FORMAT
+                      " misses, %" G_GUINT64_FORMAT " evictions (capacity %u)",
+                      self->hits, self->misses, self->evictions, self->capacity);
+
+    GList *link = NULL;
+    while((link = g_queue_peek_head_link(&self->lru))) {
+        RmFdCacheEntry *entry = link->data;
+        rm_fd_cache_unlink(self, entry);
+        rm_fd_cache_entry_close(entry);
+    }
+
+    g_hash_table_unref(self->entries);
+    g_mutex_clear(&self->lock);
+    g_slice_free(RmFdCache, self);
+}
+
+/* remove entry for key and return its fd or -1 */
+static int rm_fd_cache_steal(RmFdCache *self, gconstpointer key, gboolean count) {
+    int fd = -1;
+    g_mutex_lock(&self->lock);
+    {
+        RmFdCacheEntry *entry = g_hash_table_lookup(self->entries, key);
+        if(entry) {
+            rm_fd_cache_unlink(self, entry);
+            fd = entry->fd;
+            g_slice_free(RmFdCacheEntry, entry);
+        }
+        if(count) {
+            if(fd != -1) {
+                self->hits++;
+            } else {
+                self->misses++;
+            }
+        }
+    }
+    g_mutex_unlock(&self->lock);
+    return fd;
+}
+
+int rm_fd_cache_take(RmFdCache *self, gconstpointer key) {
+    if(!self) {
+        return -1;
+    }
+    return rm_fd_cache_steal(self, key, TRUE);
+}
+
+void rm_fd_cache_put(RmFdCache *self, gconstpointer key, int fd) {
+    if(!self || self->capacity == 0) {
+        rm_sys_close(fd);
+        return;
+    }
+
+    RmFdCacheEntry *entry = g_slice_new0(RmFdCacheEntry);
+    entry->key = key;
+    entry->fd = fd;
+    entry->link.data = entry;
+
+    RmFdCacheEntry *evicted = NULL;
+    RmFdCacheEntry *replaced = NULL;
+
+    g_mutex_lock(&self->lock);
+    {
+        replaced = g_hash_table_lookup(self->entries, key);
+        if(replaced) {
+            rm_fd_cache_unlink(self, replaced);
+        }
+
+        g_hash_table_insert(self->entries, (gpointer)key, entry);
+        g_queue_push_head_link(&self->lru, &entry->link);
+
+        if(self->lru.length > self->capacity) {
+            evicted = g_queue_peek_tail(&self->lru);
+            rm_fd_cache_unlink(self, evicted);
+            self->evictions++;
+        }
+    }
+    g_mutex_unlock(&self->lock);
+
+    /* close outside the lock */
+    if(replaced) {
+        rm_fd_cache_entry_close(replaced);
+    }
+    if(evicted) {
+        rm_fd_cache_entry_close(evicted);
+    }
+}
+
+void rm_fd_cache_forget(RmFdCache *self, gconstpointer key) {
+    if(!self) {
+        return;
+    }
+
+    int fd = rm_fd_cache_steal(self, key, FALSE);
+    if(fd != -1) {
+        rm_sys_close(fd);
+    }
+}
@@ -0,0 +1,95 @@
+/*
+ *  This file is part of rmlint.
+ *
+ *  rmlint is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  rmlint is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with rmlint.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *
+ *  - Christopher <sahib> Pahl 2010-2020 (https://github.com/sahib)
+ *  - Daniel <SeeSpotRun> T.   2014-2020 (https://github.com/SeeSpotRun)
+ *
+ * Hosted on http://github.com/sahib/rmlint
+ *
+ */
+
+#ifndef RM_FD_CACHE_H
+#define RM_FD_CACHE_H
+
+#include <glib.h>
+#include "config.h"
+
+/**
+ * @file fd-cache.h
+ * @brief Bounded LRU cache of open file descriptors.
+ *
+ * Files which are hashed in several increments would otherwise be reopened
+ * (and have their path rebuilt) for each increment.  The cache lets the
+ * device workers park the descriptor between increments instead.
+ *
+ * Descriptors are keyed by an opaque pointer (the RmFile in practice).
+ * A descriptor is owned by the cache while parked and by the caller after
+ * rm_fd_cache_take(); the cache is safe to share between threads.
+ *
+ * Typical workflow:
+ *
+ *     int fd = rm_fd_cache_take(cache, file);
+ *     if(fd == -1) {
+ *         fd = open(...);
+ *     }
+ *     read(fd, ...);
+ *     rm_fd_cache_put(cache, file, fd);
+ *     ...
+ *     rm_fd_cache_forget(cache, file);
+ **/
+
+typedef struct _RmFdCache RmFdCache;
+
+/**
+ * @brief Work out a sensible cache size from RLIMIT_NOFILE.
+ *
+ * Leaves enough headroom for traversal, batch reads and output files.
+ *
+ * @retval 0 if no descriptors can be spared.
+ **/
+guint rm_fd_cache_default_capacity(void);
+
+/**
+ * @brief Allocate a new cache holding at most capacity descriptors.
+ **/
+RmFdCache *rm_fd_cache_new(guint capacity);
+
+/**
+ * @brief Close all parked descriptors and free the cache.
+ **/
+void rm_fd_cache_free(RmFdCache *cache);
+
+/**
+ * @brief Remove the descriptor parked for key and hand it to the caller.
+ *
+ * @retval the descriptor or -1 if none was parked (or cache is NULL).
+ **/
+int rm_fd_cache_take(RmFdCache *cache, gconstpointer key);
+
+/**
+ * @brief Park fd under key; closes the least recently used descriptor if the
+ * cache is full.  If the cache is NULL or has no capacity, fd is closed.
+ **/
+void rm_fd_cache_put(RmFdCache *cache, gconstpointer key, int fd);
+
+/**
+ * @brief Close and drop the descriptor parked for key (if any).
+ **/
+void rm_fd_cache_forget(RmFdCache *cache, gconstpointer key);
+
+#endif /* end of include guard */
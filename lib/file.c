@@ -56,7 +56,7 @@ RmFile *rm_file_new(struct RmSession *session, const char *path, RmStat *statp,
         }
     }
 
-    RmFile *self = g_slice_new0(RmFile);
+    RmFile *self = rm_arena_alloc0(&session->file_arena);
     self->session = session;
 
     rm_file_set_path(self, (char *)path);
@@ -112,7 +112,7 @@ void rm_file_build_path(RmFile *file, char *buf) {
 RmFile *rm_file_copy(RmFile *file) {
     g_assert(file);
 
-    RmFile *copy  = g_slice_new0(RmFile);
+    RmFile *copy = rm_arena_alloc0((RmArena *)&file->session->file_arena);
     memcpy(copy, file, sizeof(RmFile));
 
     /* Only reset/copy the complex fields */
@@ -145,7 +145,7 @@ void rm_file_destroy(RmFile *file) {
         rm_digest_free(file->digest);
     }
 
-    g_slice_free(RmFile, file);
+    rm_arena_free((RmArena *)&file->session->file_arena, file);
 }
 
 static const char *LINT_TYPES[] = {[RM_LINT_TYPE_UNKNOWN] = "",
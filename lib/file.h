@@ -106,17 +106,43 @@ struct RmDirectory;
  * RmFile structure; used by pretty much all rmlint modules.
  */
 typedef struct RmFile {
-    /* file path lookup ID (if using swap table)
-        * */
-    RmOff path_id;
+    /* The fields up to and including folder are the ones that the scans over
+     * size groups (preprocessing, shredder) touch; keep them together.
+     * Fields are ordered so that the struct has no padding holes, since
+     * there is one RmFile for every file found.
+     */
+
+    /* Filesize in bytes; this may be less than actual_file_size,
+     * since -q / -Q may limit this number.
+     */
+    RmOff file_size;
+
+    /* The inode and device of this file.
+     * Used to filter double paths and hardlinks.
+     */
+    ino_t inode;
+    dev_t dev;
+
+    /* How many bytes were already read.
+    * (lower or equal file_size)
+    */
+    RmOff hash_offset;
+
+    /* File modification date/time
+     * */
+    gdouble mtime;
 
     /* file folder as node of folder n-ary tree
      * */
     RmNode *folder;
 
-    /* File modification date/time
+    /* The index of the path this file belongs to. */
+    guint32 path_index;
+
+    /* Number of children this file has.
+     * Only filled if type is RM_LINT_TYPE_PART_OF_DIRECTORY.
      * */
-    gdouble mtime;
+    guint32 n_children;
 
     /* Depth of the file, relative to the path it was found in.
      */
@@ -132,17 +158,17 @@ typedef struct RmFile {
      * */
     gint16 outer_link_count;
 
+    /* Caching bitmasks to ensure each file is only matched once
+     * for every GRegex combination.
+     * See also preprocess.c for more explanation.
+     * */
+    RmPatternBitmask pattern_bitmask_path;
+    RmPatternBitmask pattern_bitmask_basename;
+
     /* Depth of the path of this file.
      */
     guint8 path_depth;
 
-    /* The inode and device of this file.
-     * Used to filter double paths and hardlinks.
-     */
-    ino_t inode;
-    dev_t dev;
-    struct _RmMDSDevice *disk;
-
     /* True if the file is a symlink
      * shredder needs to know this, since the metadata might be about the
      * symlink file itself, while open() returns the pointed file.
@@ -188,6 +214,14 @@ typedef struct RmFile {
     /* Set to true if file belongs to a subvolume-capable filesystem eg btrfs */
     bool is_on_subvol_fs : 1;
 
+    /* Flag for when we do intermediate steps within a hash increment because the file is
+     * fragmented */
+    RmFileState status;
+
+    /* What kind of lint this file is.
+     */
+    RmLintType lint_type;
+
     /* The pre-matched file cluster that this file belongs to (or NULL) */
     GQueue *cluster;
 
@@ -195,37 +229,28 @@ typedef struct RmFile {
      * set */
     GQueue *hardlinks;
 
-    /* The index of the path this file belongs to. */
-    RmOff path_index;
-
-    /* Filesize in bytes; this may be less than actual_file_size,
-     * since -q / -Q may limit this number.
-     */
-    RmOff file_size;
-
-    /* Filesize of a file when it was traversed by rmlint.
-     */
-    RmOff actual_file_size;
-
-    /* How many bytes were already read.
-    * (lower or equal file_size)
-    */
-    RmOff hash_offset;
+    /* Link to the RmShredGroup that the file currently belongs to */
+    struct RmShredGroup *shred_group;
 
-    /* Flag for when we do intermediate steps within a hash increment because the file is
-     * fragmented */
-    RmFileState status;
+    struct _RmMDSDevice *disk;
 
     /* digest of this file updated on every hash iteration.  Use a pointer so we can share
      * with RmShredGroup
      */
     RmDigest *digest;
 
+    /* Filesize of a file when it was traversed by rmlint.
+     */
+    RmOff actual_file_size;
+
     /* digest of this file read from file extended attributes (previously written by
      * rmlint)
      */
     char *ext_cksum;
 
+    /* Required for rm_file_equal and for RM_DEFINE_PATH */
+    const struct RmSession *session;
+
     /* Those are never used at the same time.
      * disk_offset is used during computation,
      * twin_count during output.
@@ -241,34 +266,18 @@ typedef struct RmFile {
         RmOff disk_offset;
     };
 
-    /* What kind of lint this file is.
+    /* Likewise: signal is only used by the shredder, parent_dir only by
+     * treemerge and the output.
      */
-    RmLintType lint_type;
-
-    /* Link to the RmShredGroup that the file currently belongs to */
-    struct RmShredGroup *shred_group;
-
-    /* Required for rm_file_equal and for RM_DEFINE_PATH */
-    const struct RmSession *session;
-
-    struct RmSignal *signal;
-
-    /* Caching bitmasks to ensure each file is only matched once
-     * for every GRegex combination.
-     * See also preprocess.c for more explanation.
-     * */
-    RmPatternBitmask pattern_bitmask_path;
-    RmPatternBitmask pattern_bitmask_basename;
-
-    /* Parent directory.
-     * Only filled if type is RM_LINT_TYPE_PART_OF_DIRECTORY.
-     */
-    struct RmDirectory *parent_dir;
+    union {
+        /* Set while rm_shred_process_file() waits for an increment's hash */
+        struct RmSignal *signal;
 
-    /* Number of children this file has.
-     * Only filled if type is RM_LINT_TYPE_PART_OF_DIRECTORY.
-     * */
-    size_t n_children;
+        /* Parent directory.
+         * Only filled if type is RM_LINT_TYPE_PART_OF_DIRECTORY.
+         */
+        struct RmDirectory *parent_dir;
+    };
 } RmFile;
 
 /* Defines a path variable containing the file's path */
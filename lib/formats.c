@@ -435,7 +435,13 @@ void rm_fmt_flush(RmFmtTable *self) {
 void rm_fmt_close(RmFmtTable *self) {
     for(GList *iter = self->groups.head; iter; iter = iter->next) {
         RmFmtGroup *group = iter->data;
-        rm_fmt_group_destroy(self, group);
+        if(self->session->fast_exit) {
+            /* the files go with the session's file_arena */
+            g_queue_clear(&group->files);
+            g_slice_free(RmFmtGroup, group);
+        } else {
+            rm_fmt_group_destroy(self, group);
+        }
     }
 
     g_queue_clear(&self->groups);
@@ -87,6 +87,18 @@ static void rm_fmt_prog(RmSession *session,
     fprintf(out, _("%s%15s%s bytes of files data actually read\n"),
             MAYBE_RED(out, session), numbers, MAYBE_RESET(out, session));
 
+    if(session->cfg->use_direct_io) {
+        rm_util_size_to_human_readable(session->shred_bytes_read_direct, numbers,
+                                       sizeof(numbers));
+        fprintf(out, _("%s%15s%s bytes read bypassing the page cache\n"),
+                MAYBE_RED(out, session), numbers, MAYBE_RESET(out, session));
+
+        rm_util_size_to_human_readable(session->shred_bytes_read_cached, numbers,
+                                       sizeof(numbers));
+        fprintf(out, _("%s%15s%s bytes of files data left in page cache\n"),
+                MAYBE_RED(out, session), numbers, MAYBE_RESET(out, session));
+    }
+
     fprintf(out, _("%s%15d%s Files in total\n"), MAYBE_RED(out, session),
             session->total_files, MAYBE_RESET(out, session));
     fprintf(out, _("%s%15ld%s Duplicate files\n"), MAYBE_RED(out, session),
@@ -106,6 +118,18 @@ static void rm_fmt_prog(RmSession *session,
     );
     g_free(elapsed_time);
 
+    if(session->cfg->use_direct_io) {
+        /* to judge what O_DIRECT costs compared to a run without it */
+        char throughput[64] = "NaN";
+        if(session->shred_elapsed > 0) {
+            RmOff bytes_per_second = session->shred_bytes_read / session->shred_elapsed;
+            rm_util_size_to_human_readable(bytes_per_second, numbers, sizeof(numbers));
+            snprintf(throughput, sizeof(throughput), "%s/s", numbers);
+        }
+        fprintf(out, _("%s%15s%s Hashing throughput\n"), MAYBE_RED(out, session),
+                throughput, MAYBE_RESET(out, session));
+    }
+
     char eff_total[64] = "NaN";
     char eff_dupes[64] = "NaN";
     if(session->shred_bytes_read != 0) {
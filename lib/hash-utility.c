@@ -121,6 +121,7 @@ int rm_hasher_main(int argc, const char **argv) {
     gint threads = 8;
     gint64 buffer_mbytes = 256;
     guint64 increment = 4096;
+    gboolean no_sse = FALSE;
 
     ////////////// Option Parsing ///////////////
 
@@ -132,6 +133,7 @@ int rm_hasher_main(int argc, const char **argv) {
         {"buffer-mbytes"  , 'b'  , 0                      , G_OPTION_ARG_INT64           , &buffer_mbytes                        , _("Megabytes read buffer [256 MB]")                                                , "MB"}       ,
         {"increment"      , 'x'  , G_OPTION_FLAG_HIDDEN   , G_OPTION_ARG_INT64           , &increment                            , _("bytes to hash at a time [4096]")                                                , "MB"}       ,
         {"ignore-order"   , 'i'  , G_OPTION_FLAG_REVERSE  , G_OPTION_ARG_NONE            , &tag.print_in_order                   , _("Print hashes in order completed, not in order entered (reduces memory usage)")  , NULL}       ,
+        {"no-sse"         , 0    , G_OPTION_FLAG_HIDDEN   , G_OPTION_ARG_NONE            , &no_sse                               , _("Don't use SSE accelerations")                                                   , NULL}       ,
         {""               , 0    , 0                      , G_OPTION_ARG_FILENAME_ARRAY  , &tag.paths                            , _("Space-separated list of files")                                                 , "[FILE…]"}  ,
         {NULL             , 0    , 0                      , 0                            , NULL                                  , NULL                                                                               , NULL}};
 
@@ -158,7 +160,7 @@ int rm_hasher_main(int argc, const char **argv) {
 #if HAVE_MM_CRC32_U64
                "metrocrc, metrocrc256, "
 #endif
-               "metro, metro256, xxhash, murmur",
+               "metro, metro256, xxhash, xxh3, xxh3-128, murmur",
                "cumulative, paranoid, ext");
 
     g_option_group_add_entries(main_group, entries);
@@ -194,9 +196,7 @@ int rm_hasher_main(int argc, const char **argv) {
 
     ////////// Implementation //////
 
-#if HAVE_MM_CRC32_U64 && HAVE_BUILTIN_CPU_SUPPORTS
-    rm_digest_enable_sse(TRUE);
-#endif
+    rm_digest_enable_sse(!no_sse);
 
     int buf_size = (g_strv_length(tag.paths) + 1) * sizeof(RmDigest *);
     tag.read_succesful = g_slice_alloc0(buf_size);
@@ -32,6 +32,14 @@
 #include "hasher.h"
 #include "utilities.h"
 
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#endif
+
 /* Flags for the fadvise() call that tells the kernel
  * what we want to do with the file.
  */
@@ -52,9 +60,41 @@ const int HASHER_FADVISE_FLAGS = 0
 /* how many buffers to read? */
 const guint16 N_PREADV_BUFFERS = 4;
 
+/* how many reads to keep in flight per file when using io_uring */
+#define RM_HASHER_RING_DEPTH (8)
+
+/* submission queue size of each reader thread's io_uring */
+#define RM_HASHER_RING_ENTRIES (128)
+
+/* maximum number of read buffers held by one RmHasherBatch; must not exceed
+ * RM_HASHER_RING_ENTRIES / 2 (closing may take two sqes per file) */
+#define RM_HASHER_BATCH_MAX_BUFFERS (64)
+
+/* alignment of buffers, offsets and lengths for O_DIRECT reads; the logical
+ * block size of most devices is 512 or 4096 bytes */
+#define RM_HASHER_DIRECT_ALIGN (4096)
+
+/* with --direct-io, read data that went through the page cache anyway is
+ * dropped from the cache in chunks of this size */
+#define RM_HASHER_DROP_BEHIND_BYTES (8 * 1024 * 1024)
+
+#define ALIGN_UP(n, m) (DIVIDE_CEIL(n, m) * (m))
+
+/* size of the slices of a mmap()ed increment that are sent to the hashpipe;
+ * there is no copy, so bigger is cheaper */
+#define RM_HASHER_MMAP_SLICE (1024 * 1024)
+
 struct _RmHasher {
     RmDigestType digest_type;
     gboolean use_buffered_read;
+    gboolean use_io_uring;
+    /* try to open files with O_DIRECT */
+    gboolean use_direct_io;
+    /* drop data read via the page cache with POSIX_FADV_DONTNEED */
+    gboolean drop_cache;
+    /* mmap() increments of files at least this big; 0 to disable */
+    RmOff mmap_threshold;
+    gsize page_size;
     guint64 cache_quota_bytes;
     gpointer session_user_data;
     RmHasherCallback callback;
@@ -69,6 +109,17 @@ struct _RmHasher {
     guint active_tasks;
 
     RmSemaphore *buf_sem;
+
+    /* aligned buffers for O_DIRECT reads; NULL unless use_direct_io */
+    RmBufferPool *direct_pool;
+
+    /* I/O statistics (protected by lock) */
+    guint64 bytes_read_direct;
+    guint64 bytes_read_cached;
+
+    /* hashes leaves of digests in parallel (see rm_digest_has_leaves());
+     * NULL for other digest types */
+    GThreadPool *leaf_pool;
 };
 
 struct _RmHasherTask {
@@ -137,6 +188,265 @@ static void rm_hasher_request_readahead(int fd, RmOff seek_offset, RmOff bytes_t
 #endif
 }
 
+/* Tell the kernel we won't need [start, end) of fd again */
+static void rm_hasher_drop_cache(int fd, RmOff start, RmOff end) {
+#if HAVE_POSIX_FADVISE && defined(POSIX_FADV_DONTNEED)
+    if(end > start) {
+        posix_fadvise(fd, start, end - start, POSIX_FADV_DONTNEED);
+    }
+#else
+    (void)fd;
+    (void)start;
+    (void)end;
+#endif
+}
+
+/* Drop data behind the read cursor once enough has accumulated;
+ * *dropped is where the previous drop ended */
+static void rm_hasher_drop_behind(RmHasher *hasher, int fd, RmOff *dropped,
+                                  RmOff cursor, gboolean force) {
+    if(hasher->drop_cache && (force || cursor >= *dropped + RM_HASHER_DROP_BEHIND_BYTES)) {
+        rm_hasher_drop_cache(fd, *dropped, cursor);
+        *dropped = cursor;
+    }
+}
+
+/* Turn O_DIRECT on or off for fd; returns the resulting state */
+static gboolean rm_hasher_fd_set_direct(int fd, gboolean direct) {
+#ifdef O_DIRECT
+    int flags = fcntl(fd, F_GETFL);
+    if(flags == -1) {
+        return FALSE;
+    }
+
+    int new_flags = direct ? (flags | O_DIRECT) : (flags & ~O_DIRECT);
+    if(new_flags != flags && fcntl(fd, F_SETFL, new_flags) == -1) {
+        return !!(flags & O_DIRECT);
+    }
+    return direct;
+#else
+    (void)fd;
+    (void)direct;
+    return FALSE;
+#endif
+}
+
+/* Check if a read from fd at offset can bypass the page cache.  fds which
+ * can't (unaligned offset, e.g. due to --clamp-low) fall back to normal reads
+ * for the rest of the file. */
+static gboolean rm_hasher_fd_is_direct(RmHasher *hasher, int fd, RmOff offset) {
+#ifdef O_DIRECT
+    if(!hasher->use_direct_io) {
+        return FALSE;
+    }
+
+    int flags = fcntl(fd, F_GETFL);
+    if(flags == -1 || !(flags & O_DIRECT)) {
+        return FALSE;
+    }
+
+    if(offset % RM_HASHER_DIRECT_ALIGN != 0) {
+        return rm_hasher_fd_set_direct(fd, FALSE);
+    }
+    return TRUE;
+#else
+    (void)hasher;
+    (void)fd;
+    (void)offset;
+    return FALSE;
+#endif
+}
+
+/* Check if fd has fewer blocks allocated than its size needs, i.e. has holes
+ * which rm_hasher_next_data() can skip */
+static gboolean rm_hasher_fd_is_sparse(int fd) {
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+    RmStat stat_buf;
+    return rm_sys_fstat(fd, &stat_buf) == 0 && S_ISREG(stat_buf.st_mode) &&
+           (RmOff)stat_buf.st_blocks * 512 < (RmOff)stat_buf.st_size;
+#else
+    (void)fd;
+    return FALSE;
+#endif
+}
+
+/* Find the data region of sparse fd at or after offset; sets *data_start and
+ * *data_end to it, or both to the file size if only a hole is left.  Returns
+ * FALSE if the filesystem can't tell, in which case everything counts as data */
+static gboolean rm_hasher_next_data(int fd, RmOff offset, RmOff *data_start,
+                                    RmOff *data_end) {
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+    off_t start = lseek(fd, offset, SEEK_DATA);
+    if(start == -1 && errno == ENXIO) {
+        /* hole up to the end of the file */
+        RmStat stat_buf;
+        if(rm_sys_fstat(fd, &stat_buf) == -1) {
+            return FALSE;
+        }
+        *data_start = *data_end = MAX((RmOff)stat_buf.st_size, offset);
+        return TRUE;
+    }
+
+    off_t end = (start == -1) ? -1 : lseek(fd, start, SEEK_HOLE);
+    if(end == -1) {
+        return FALSE;
+    }
+    *data_start = start;
+    *data_end = end;
+    return TRUE;
+#else
+    (void)fd;
+    (void)offset;
+    (void)data_start;
+    (void)data_end;
+    return FALSE;
+#endif
+}
+
+static RmBuffer *rm_hasher_buffer_new(RmHasher *hasher, gboolean direct) {
+    if(direct) {
+        return rm_buffer_new_from_pool(hasher->buf_sem, hasher->direct_pool);
+    }
+    return rm_buffer_new(hasher->buf_sem, hasher->buf_size);
+}
+
+/* GThreadPool Worker for hashing leaves of a digest */
+static void rm_hasher_leaf_worker(RmDigestLeaf *leaf, RmHasher *hasher) {
+    rm_digest_leaf_hash(leaf, hasher->buf_sem);
+}
+
+/* Send the buffers gathered so far for digest one by one to the hashpipe */
+static void rm_hasher_leaf_flush(RmDigest *digest, GThreadPool *hashpipe) {
+    RmDigestLeaf *leaf = digest->gathering;
+    if(!leaf) {
+        return;
+    }
+
+    RmBuffer *buffer = NULL;
+    while((buffer = g_queue_pop_head(&leaf->buffers))) {
+        rm_util_thread_pool_push(hashpipe, buffer);
+    }
+
+    rm_digest_leaf_free(leaf);
+    digest->gathering = NULL;
+}
+
+/* Send buffer (which must be for buffer->digest) to be hashed.
+ * For digests with leaves, buffers are gathered into whole leaves which are
+ * hashed by hasher->leaf_pool while the hashpipe only gets a placeholder; that
+ * way a single file can keep several threads busy.  Everything else, including
+ * data that does not line up with leaf boundaries, goes straight to the
+ * hashpipe. */
+static void rm_hasher_send(RmHasher *hasher, GThreadPool *hashpipe, RmBuffer *buffer) {
+    RmDigest *digest = buffer->digest;
+    if(!hasher->leaf_pool || !rm_digest_has_leaves(digest->type)) {
+        rm_util_thread_pool_push(hashpipe, buffer);
+        return;
+    }
+
+    RmDigestLeaf *leaf = digest->gathering;
+
+    if(leaf && leaf->len + buffer->len > RM_DIGEST_TREE_LEAF_SIZE) {
+        /* buffer would straddle the leaf boundary */
+        rm_hasher_leaf_flush(digest, hashpipe);
+        leaf = NULL;
+    } else if(!leaf && digest->sent % RM_DIGEST_TREE_LEAF_SIZE == 0) {
+        leaf = digest->gathering = rm_digest_leaf_new(digest);
+    }
+    digest->sent += buffer->len;
+
+    if(!leaf) {
+        rm_util_thread_pool_push(hashpipe, buffer);
+        return;
+    }
+
+    g_queue_push_tail(&leaf->buffers, buffer);
+    leaf->len += buffer->len;
+    if(leaf->len == RM_DIGEST_TREE_LEAF_SIZE) {
+        /* the placeholder must be created before the leaf is handed over */
+        RmBuffer *placeholder = rm_buffer_new_leaf(hasher->buf_sem, leaf);
+        placeholder->digest = digest;
+        placeholder->user_data = NULL;
+        digest->gathering = NULL;
+
+        rm_util_thread_pool_push(hasher->leaf_pool, leaf);
+        rm_util_thread_pool_push(hashpipe, placeholder);
+    }
+}
+
+static void rm_hasher_count_read(RmHasher *hasher, gsize bytes, gboolean direct) {
+    g_mutex_lock(&hasher->lock);
+    {
+        if(direct) {
+            hasher->bytes_read_direct += bytes;
+        } else if(!hasher->drop_cache) {
+            hasher->bytes_read_cached += bytes;
+        }
+    }
+    g_mutex_unlock(&hasher->lock);
+}
+
+/* Check if the increment [start_offset, start_offset + bytes_to_read) of fd
+ * should be mmap()ed; *end is set to the end of the increment */
+static gboolean rm_hasher_fd_use_mmap(RmHasher *hasher, int fd, RmOff start_offset,
+                                      RmOff bytes_to_read, RmOff *end) {
+    if(hasher->mmap_threshold == 0 || hasher->drop_cache) {
+        return FALSE;
+    }
+
+    RmStat stat_buf;
+    if(rm_sys_fstat(fd, &stat_buf) == -1 || !S_ISREG(stat_buf.st_mode) ||
+       (RmOff)stat_buf.st_size < hasher->mmap_threshold) {
+        return FALSE;
+    }
+
+    *end = (bytes_to_read == 0) ? (RmOff)stat_buf.st_size : start_offset + bytes_to_read;
+
+    /* if the file is shorter than expected, let the normal read path
+     * complain about it */
+    return start_offset < *end && *end <= (RmOff)stat_buf.st_size;
+}
+
+/* Maps [start_offset, end) of fd and sends it to the hasher threadpool in
+ * slices which point into the mapping (no copy).  Returns FALSE if the
+ * region could not be mapped, in which case nothing was sent. */
+static gboolean rm_hasher_mmap_read(RmHasher *hasher, GThreadPool *hashpipe,
+                                    RmDigest *digest, int fd, RmOff start_offset,
+                                    RmOff end, gsize *bytes_actually_read) {
+    RmOff map_offset = start_offset - start_offset % hasher->page_size;
+    gsize map_len = end - map_offset;
+
+    gpointer addr = mmap(NULL, map_len, PROT_READ, MAP_SHARED, fd, map_offset);
+    if(addr == MAP_FAILED) {
+        rm_log_debug_line("mmap failed (%s); reading normally", g_strerror(errno));
+        return FALSE;
+    }
+
+    RmBufferMapping *mapping = rm_buffer_mapping_new(addr, map_len, digest);
+    if(!mapping) {
+        munmap(addr, map_len);
+        return FALSE;
+    }
+
+    /* Give the kernel some hints; readahead starts right away */
+    madvise(addr, map_len, MADV_SEQUENTIAL);
+    madvise(addr, map_len, MADV_WILLNEED);
+    for(gsize offset = start_offset - map_offset; offset < map_len;
+        offset += RM_HASHER_MMAP_SLICE) {
+        gsize len = MIN(RM_HASHER_MMAP_SLICE, map_len - offset);
+        RmBuffer *buffer = rm_buffer_new_mapped(hasher->buf_sem, mapping, offset, len);
+        buffer->digest = digest;
+        buffer->user_data = NULL;
+        rm_hasher_send(hasher, hashpipe, buffer);
+    }
+
+    /* the last buffer to be hashed unmaps it */
+    rm_buffer_mapping_unref(mapping);
+
+    *bytes_actually_read += end - start_offset;
+    return TRUE;
+}
+
 static gboolean rm_hasher_symlink_read(RmHasher *hasher, GThreadPool *hashpipe,
                                        RmDigest *digest, char *path,
                                        gsize *bytes_actually_read) {
@@ -155,11 +465,48 @@ static gboolean rm_hasher_symlink_read(RmHasher *hasher, GThreadPool *hashpipe,
     buffer->len = len;
     buffer->digest = digest;
     buffer->user_data = NULL;
-    rm_util_thread_pool_push(hashpipe, buffer);
+    rm_hasher_send(hasher, hashpipe, buffer);
 
     return TRUE;
 }
 
+/* Send len zero bytes for digest without reading them (a hole of a sparse
+ * file), in buffers of at most max_chunk (<= RM_BUFFER_ZEROS_LEN) bytes.
+ * Whole leaves of zeros are hashed in advance if the digest type allows
+ * (see rm_digest_leaf_new_zeros()), everything else goes through the normal
+ * path but without copying. */
+static void rm_hasher_send_zeros(RmHasher *hasher, GThreadPool *hashpipe,
+                                 RmDigest *digest, RmOff len, gsize max_chunk) {
+    gboolean leaves = (hasher->leaf_pool && rm_digest_has_leaves(digest->type));
+    while(len > 0) {
+        if(leaves && len >= RM_DIGEST_TREE_LEAF_SIZE && !digest->gathering &&
+           digest->sent % RM_DIGEST_TREE_LEAF_SIZE == 0) {
+            RmDigestLeaf *leaf = rm_digest_leaf_new_zeros(digest);
+            if(leaf) {
+                RmBuffer *placeholder = rm_buffer_new_leaf(hasher->buf_sem, leaf);
+                placeholder->digest = digest;
+                placeholder->user_data = NULL;
+                digest->sent += RM_DIGEST_TREE_LEAF_SIZE;
+                rm_util_thread_pool_push(hashpipe, placeholder);
+                len -= RM_DIGEST_TREE_LEAF_SIZE;
+                continue;
+            }
+        }
+
+        gsize chunk = MIN(len, max_chunk);
+        if(leaves) {
+            /* don't straddle leaf boundaries (refer rm_hasher_send()) */
+            chunk = MIN(chunk, RM_DIGEST_TREE_LEAF_SIZE - digest->sent % RM_DIGEST_TREE_LEAF_SIZE);
+        }
+
+        RmBuffer *buffer = rm_buffer_new_zeros(hasher->buf_sem, chunk);
+        buffer->digest = digest;
+        buffer->user_data = NULL;
+        rm_hasher_send(hasher, hashpipe, buffer);
+        len -= chunk;
+    }
+}
+
 /* Reads data from file and sends to hasher threadpool;
  * returns true if no errors encountered;
  * increments *bytes_read by the actual bytes read */
@@ -186,11 +533,14 @@ static gboolean rm_hasher_buffered_read(RmHasher *hasher, GThreadPool *hashpipe,
 
     gboolean success = FALSE;
     gsize bytes_remaining = bytes_to_read;
+    RmOff dropped = start_offset;
 
     while(TRUE) {
         RmBuffer *buffer = rm_buffer_new(hasher->buf_sem, hasher->buf_size);
         gsize want_bytes = MIN(bytes_remaining, hasher->buf_size);
         gsize bytes_read = fread(buffer->data, 1, want_bytes, fd);
+        rm_hasher_drop_behind(hasher, fileno(fd), &dropped,
+                              start_offset + *bytes_actually_read + bytes_read, FALSE);
 
         if(ferror(fd) != 0) {
             rm_log_perror("fread(3) failed");
@@ -204,7 +554,7 @@ static gboolean rm_hasher_buffered_read(RmHasher *hasher, GThreadPool *hashpipe,
         buffer->len = bytes_read;
         buffer->digest = digest;
         buffer->user_data = NULL;
-        rm_util_thread_pool_push(hashpipe, buffer);
+        rm_hasher_send(hasher, hashpipe, buffer);
 
         if(read_to_eof && feof(fd)) {
             success = TRUE;
@@ -223,27 +573,41 @@ static gboolean rm_hasher_buffered_read(RmHasher *hasher, GThreadPool *hashpipe,
             break;
         }
     }
+    rm_hasher_drop_behind(hasher, fileno(fd), &dropped,
+                          start_offset + *bytes_actually_read, TRUE);
     fclose(fd);
+    rm_hasher_count_read(hasher, *bytes_actually_read, FALSE);
     return success;
 }
 
 /* Reads data from file and sends to hasher threadpool
  * returns true if no errors encountered;
- * increments *bytes_read by the actual bytes read */
+ * increments *bytes_read by the actual bytes read.
+ * If *direct then fd was opened with O_DIRECT; it is cleared if the
+ * filesystem refuses direct reads.
+ * If sparse (refer rm_hasher_fd_is_sparse()) then holes are not read but sent
+ * as zeros; they don't count towards *bytes_read. */
 
 static gboolean rm_hasher_unbuffered_read(RmHasher *hasher, GThreadPool *hashpipe,
-                                          RmDigest *digest, char *path,
+                                          RmDigest *digest, int fd, const char *path,
                                           gint64 start_offset, gint64 bytes_to_read,
+                                          gboolean sparse, gboolean *direct,
                                           gsize *bytes_actually_read) {
     gint32 bytes_read = 0;
     guint64 file_offset = start_offset;
 
     gboolean read_to_eof = (bytes_to_read == 0);
 
-    int fd = rm_sys_open(path, O_RDONLY);
-    if(fd == -1) {
-        rm_log_info("open(2) failed for %s: %s\n", path, g_strerror(errno));
-        return FALSE;
+    /* the current or next data region of a sparse file; holes before
+     * data_start are skipped and data_end is where to look again */
+    RmOff data_start = 0, data_end = 0;
+
+    /* paranoid digests are compared buffer by buffer (refer rm_buffer_equal()),
+     * so a hole may only be skipped in buffers that start and end where a
+     * dense read would put them; the rest of it is read as usual */
+    gboolean whole_buffers = (digest->type == RM_DIGEST_PARANOID);
+    if(whole_buffers && hasher->buf_size > RM_BUFFER_ZEROS_LEN) {
+        sparse = FALSE;
     }
 
     /* preadv() is beneficial for large files since it can cut the
@@ -258,7 +622,9 @@ static gboolean rm_hasher_unbuffered_read(RmHasher *hasher, GThreadPool *hashpip
      */
 
     /* Give the kernel scheduler some hints */
-    rm_hasher_request_readahead(fd, start_offset, bytes_to_read);
+    if(!*direct) {
+        rm_hasher_request_readahead(fd, start_offset, bytes_to_read);
+    }
 
     guint16 n_preadv_buffers = N_PREADV_BUFFERS;
     if(bytes_to_read > 0) {
@@ -274,16 +640,51 @@ static gboolean rm_hasher_unbuffered_read(RmHasher *hasher, GThreadPool *hashpip
 
     gboolean success = FALSE;
     gsize bytes_remaining = bytes_to_read;
+    RmOff dropped = start_offset;
 
     while(TRUE) {
+        if(sparse && file_offset >= data_end) {
+            sparse = rm_hasher_next_data(fd, file_offset, &data_start, &data_end);
+        }
+
+        RmOff hole = (sparse && data_start > file_offset) ? data_start - file_offset : 0;
+        if(hole > 0 && !read_to_eof) {
+            hole = MIN(hole, bytes_remaining);
+        }
+        if(whole_buffers) {
+            /* file_offset is on a buffer boundary; preadv() always fills
+             * whole buffers except at EOF */
+            hole -= hole % hasher->buf_size;
+        }
+
+        if(hole > 0) {
+            if(!read_to_eof) {
+                bytes_remaining -= hole;
+            }
+            rm_hasher_send_zeros(hasher, hashpipe, digest, hole,
+                                 whole_buffers ? hasher->buf_size : RM_BUFFER_ZEROS_LEN);
+            file_offset += hole;
+            if(!read_to_eof && bytes_remaining == 0) {
+                success = TRUE;
+                break;
+            }
+            /* at EOF the preadv() below reads nothing and finishes */
+        }
+
         /* allocate buffers for preadv */
         for(int i = 0; i < n_preadv_buffers; ++i) {
-            buffers[i] = rm_buffer_new(hasher->buf_sem, hasher->buf_size);
+            buffers[i] = rm_hasher_buffer_new(hasher, *direct);
             readvec[i].iov_base = buffers[i]->data;
             readvec[i].iov_len = hasher->buf_size;
         }
 
         bytes_read = rm_sys_preadv(fd, readvec, n_preadv_buffers, file_offset);
+        if(bytes_read == -1 && errno == EINVAL && *direct) {
+            /* filesystem accepted O_DIRECT on open but refuses to read;
+             * our (aligned) buffers work just as well for normal reads */
+            *direct = rm_hasher_fd_set_direct(fd, FALSE);
+            bytes_read = rm_sys_preadv(fd, readvec, n_preadv_buffers, file_offset);
+        }
 
         if(bytes_read == -1) {
             /* error occurred */
@@ -303,6 +704,10 @@ static gboolean rm_hasher_unbuffered_read(RmHasher *hasher, GThreadPool *hashpip
         *bytes_actually_read += bytes_read;
         bytes_remaining -= bytes_read;
 
+        if(!*direct) {
+            rm_hasher_drop_behind(hasher, fd, &dropped, file_offset, FALSE);
+        }
+
         /* send buffers */
         for(int i = 0; i < n_preadv_buffers; ++i) {
             RmBuffer *buffer = buffers[i];
@@ -313,7 +718,7 @@ static gboolean rm_hasher_unbuffered_read(RmHasher *hasher, GThreadPool *hashpip
                 /* Send it to the hasher */
                 buffer->digest = digest;
                 buffer->user_data = NULL;
-                rm_util_thread_pool_push(hashpipe, buffer);
+                rm_hasher_send(hasher, hashpipe, buffer);
             } else {
                 rm_buffer_free(hasher->buf_sem,  buffer);
             }
@@ -335,11 +740,691 @@ static gboolean rm_hasher_unbuffered_read(RmHasher *hasher, GThreadPool *hashpip
     }
 
     g_slice_free1(sizeof(*buffers) * n_preadv_buffers, buffers);
-    rm_sys_close(fd);
+
+    if(!*direct) {
+        rm_hasher_drop_behind(hasher, fd, &dropped, file_offset, TRUE);
+    }
 
     return success;
 }
 
+#if HAVE_IO_URING
+
+/* Minimal io_uring reader built directly on the kernel interface (no liburing).
+ * Each reader thread gets its own ring (see rm_hasher_ring_get()) so that
+ * several reads per file can be in flight at once; completed buffers are handed
+ * to the hashpipe in file order as soon as they arrive.
+ */
+
+/* marks a request whose completion has not been reaped yet */
+#define RM_HASHER_RING_PENDING G_MININT32
+
+typedef struct RmHasherRing {
+    int fd;
+
+    /* submission queue (shared with kernel) */
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+
+    /* completion queue (shared with kernel) */
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    /* sqes that have been prepared but not yet consumed by the kernel */
+    unsigned n_unsubmitted;
+
+    /* mappings, kept for munmap() */
+    gpointer ring_ptr;
+    gsize ring_len;
+    gsize sqes_len;
+} RmHasherRing;
+
+static void rm_hasher_ring_free(RmHasherRing *ring) {
+    if(ring->sqes) {
+        munmap(ring->sqes, ring->sqes_len);
+    }
+    if(ring->ring_ptr) {
+        munmap(ring->ring_ptr, ring->ring_len);
+    }
+    close(ring->fd);
+    g_slice_free(RmHasherRing, ring);
+}
+
+static RmHasherRing *rm_hasher_ring_new(unsigned entries) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    int fd = syscall(__NR_io_uring_setup, entries, &params);
+    if(fd < 0) {
+        /* ENOSYS on old kernels, EPERM if disabled via sysctl */
+        return NULL;
+    }
+
+    /* We use IORING_OP_READ (linux 5.6, same release as IORING_FEAT_RW_CUR_POS)
+     * and expect sq and cq to share one mapping (linux 5.4) */
+    if(!(params.features & IORING_FEAT_SINGLE_MMAP) ||
+       !(params.features & IORING_FEAT_RW_CUR_POS)) {
+        close(fd);
+        return NULL;
+    }
+
+    RmHasherRing *ring = g_slice_new0(RmHasherRing);
+    ring->fd = fd;
+    ring->ring_len = MAX(params.sq_off.array + params.sq_entries * sizeof(unsigned),
+                         params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe));
+    ring->ring_ptr = mmap(NULL, ring->ring_len, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if(ring->ring_ptr == MAP_FAILED) {
+        ring->ring_ptr = NULL;
+        rm_hasher_ring_free(ring);
+        return NULL;
+    }
+
+    ring->sqes_len = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if(ring->sqes == MAP_FAILED) {
+        ring->sqes = NULL;
+        rm_hasher_ring_free(ring);
+        return NULL;
+    }
+
+    char *base = ring->ring_ptr;
+    ring->sq_head = (unsigned *)(base + params.sq_off.head);
+    ring->sq_tail = (unsigned *)(base + params.sq_off.tail);
+    ring->sq_mask = (unsigned *)(base + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(base + params.sq_off.array);
+    ring->cq_head = (unsigned *)(base + params.cq_off.head);
+    ring->cq_tail = (unsigned *)(base + params.cq_off.tail);
+    ring->cq_mask = (unsigned *)(base + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(base + params.cq_off.cqes);
+
+    return ring;
+}
+
+/* one ring per reader thread; freed when the thread exits */
+static GPrivate rm_hasher_ring_key = G_PRIVATE_INIT((GDestroyNotify)rm_hasher_ring_free);
+
+static RmHasherRing *rm_hasher_ring_get(void) {
+    RmHasherRing *ring = g_private_get(&rm_hasher_ring_key);
+    if(!ring) {
+        ring = rm_hasher_ring_new(RM_HASHER_RING_ENTRIES);
+        g_private_set(&rm_hasher_ring_key, ring);
+    }
+    return ring;
+}
+
+static gboolean rm_hasher_ring_is_supported(void) {
+    RmHasherRing *ring = rm_hasher_ring_new(1);
+    if(ring) {
+        rm_hasher_ring_free(ring);
+        return TRUE;
+    }
+    return FALSE;
+}
+
+/* get a cleared sqe; fill it in and then queue it via rm_hasher_ring_push() */
+static struct io_uring_sqe *rm_hasher_ring_next_sqe(RmHasherRing *ring,
+                                                    guint8 opcode,
+                                                    int fd,
+                                                    guint64 user_data) {
+    unsigned index = *ring->sq_tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->user_data = user_data;
+    return sqe;
+}
+
+static void rm_hasher_ring_push(RmHasherRing *ring) {
+    unsigned tail = *ring->sq_tail;
+    unsigned index = tail & *ring->sq_mask;
+    ring->sq_array[index] = index;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ring->n_unsubmitted++;
+}
+
+static void rm_hasher_ring_prep_read(RmHasherRing *ring, int fd, guint8 *data,
+                                     guint32 len, guint64 offset, guint64 user_data) {
+    struct io_uring_sqe *sqe =
+        rm_hasher_ring_next_sqe(ring, IORING_OP_READ, fd, user_data);
+    sqe->addr = (guint64)(uintptr_t)data;
+    sqe->len = len;
+    sqe->off = offset;
+    rm_hasher_ring_push(ring);
+}
+
+/* submit any prepared sqes and wait for at least wait_nr completions */
+static gboolean rm_hasher_ring_submit_and_wait(RmHasherRing *ring, guint wait_nr) {
+    while(TRUE) {
+        int submitted = syscall(__NR_io_uring_enter, ring->fd, ring->n_unsubmitted,
+                                wait_nr, IORING_ENTER_GETEVENTS, NULL, 0);
+        if(submitted >= 0) {
+            ring->n_unsubmitted -= MIN((unsigned)submitted, ring->n_unsubmitted);
+            return TRUE;
+        }
+        if(errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            return FALSE;
+        }
+    }
+}
+
+/* store the result of each available completion in results[user_data], which
+ * has room for n_results; returns number of completions stored.  Completions
+ * with user_data out of range are not ours and are dropped. */
+static guint rm_hasher_ring_reap(RmHasherRing *ring, gint32 *results, guint n_results) {
+    guint reaped = 0;
+    unsigned head = *ring->cq_head;
+    unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    for(; head != tail; head++) {
+        struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+        if(cqe->user_data < n_results) {
+            results[cqe->user_data] = cqe->res;
+            reaped++;
+        } else {
+            rm_log_warning_line("io_uring: dropping stray completion %" LLU,
+                                (RmOff)cqe->user_data);
+        }
+    }
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    return reaped;
+}
+
+/* submit prepared sqes and wait until n_expected of them have completed */
+static gboolean rm_hasher_ring_run(RmHasherRing *ring, guint n_expected,
+                                   gint32 *results, guint n_results) {
+    while(n_expected > 0) {
+        if(!rm_hasher_ring_submit_and_wait(ring, n_expected)) {
+            return FALSE;
+        }
+        n_expected -= MIN(n_expected, rm_hasher_ring_reap(ring, results, n_results));
+    }
+    return TRUE;
+}
+
+/* After io_uring_enter() failed: give the kernel up to a second to complete
+ * the n_owned requests it already took, then replace this thread's ring, which
+ * cancels anything left.  Returns the number of requests still not completed. */
+static guint rm_hasher_ring_abandon(RmHasherRing *ring, guint n_owned, gint32 *results,
+                                    guint n_results) {
+    gint64 deadline = g_get_monotonic_time() + G_USEC_PER_SEC;
+    while(n_owned > 0 && g_get_monotonic_time() < deadline) {
+        /* completions may be posted as task work, which runs on any syscall */
+        g_usleep(1000);
+        n_owned -= MIN(n_owned, rm_hasher_ring_reap(ring, results, n_results));
+    }
+
+    /* frees ring via rm_hasher_ring_free(); next read gets a new one */
+    g_private_replace(&rm_hasher_ring_key, NULL);
+    return n_owned;
+}
+
+/* rm_hasher_ring_abandon() after rm_hasher_ring_run() failed for the last
+ * n_requests sqes pushed, whose results were preset to RM_HASHER_RING_PENDING.
+ * Their user_data are pushed[0..n_requests) in push order, or just
+ * 0..n_requests if pushed is NULL.  Requests the kernel never saw are set to
+ * -ECANCELED; returns the number still pending. */
+static guint rm_hasher_ring_fail(RmHasherRing *ring, guint n_requests, const guint *pushed,
+                                 gint32 *results, guint n_results) {
+    /* the unsubmitted ones are the newest */
+    for(guint i = n_requests - MIN(ring->n_unsubmitted, n_requests); i < n_requests; ++i) {
+        results[pushed ? pushed[i] : i] = -ECANCELED;
+    }
+
+    guint n_owned = 0;
+    for(guint i = 0; i < n_requests; ++i) {
+        n_owned += (results[pushed ? pushed[i] : i] == RM_HASHER_RING_PENDING);
+    }
+    return rm_hasher_ring_abandon(ring, n_owned, results, n_results);
+}
+
+/* io_uring equivalent of rm_hasher_unbuffered_read() */
+static gboolean rm_hasher_ring_read(RmHasher *hasher, RmHasherRing *ring,
+                                    GThreadPool *hashpipe, RmDigest *digest, int fd,
+                                    const char *path, gint64 start_offset,
+                                    gint64 bytes_to_read, gboolean *direct,
+                                    gsize *bytes_actually_read) {
+    gboolean read_to_eof = (bytes_to_read == 0);
+
+    /* Give the kernel scheduler some hints */
+    if(!*direct) {
+        rm_hasher_request_readahead(fd, start_offset, bytes_to_read);
+    }
+
+    guint depth = RM_HASHER_RING_DEPTH;
+    if(!read_to_eof) {
+        depth = MIN(depth, DIVIDE_CEIL(bytes_to_read, hasher->buf_size));
+    }
+
+    /* in-flight reads, indexed by (sequence number % depth) */
+    RmBuffer *slots[RM_HASHER_RING_DEPTH];
+    guint32 wanted[RM_HASHER_RING_DEPTH];
+    guint64 offsets[RM_HASHER_RING_DEPTH];
+    gint32 results[RM_HASHER_RING_DEPTH];
+
+    guint64 next_submit = 0;
+    guint64 next_send = 0;
+    guint n_in_flight = 0;
+
+    guint64 submit_offset = start_offset;
+    gsize bytes_unsubmitted = bytes_to_read;
+    RmOff dropped = start_offset;
+
+    gboolean hit_eof = FALSE;
+    gboolean failed = FALSE;
+
+    while(TRUE) {
+        /* top up the submission queue; a slot is only free again once its
+         * buffer went to the hasher, not as soon as its read completed */
+        while(!hit_eof && !failed && next_submit - next_send < depth &&
+              (read_to_eof || bytes_unsubmitted > 0)) {
+            guint slot = next_submit % depth;
+            guint32 want = read_to_eof ? hasher->buf_size
+                                       : MIN(hasher->buf_size, bytes_unsubmitted);
+
+            slots[slot] = rm_hasher_buffer_new(hasher, *direct);
+            wanted[slot] = want;
+            offsets[slot] = submit_offset;
+            results[slot] = RM_HASHER_RING_PENDING;
+            /* O_DIRECT needs whole blocks; over-reads are ignored below */
+            rm_hasher_ring_prep_read(
+                ring, fd, slots[slot]->data,
+                *direct ? ALIGN_UP(want, RM_HASHER_DIRECT_ALIGN) : want,
+                submit_offset, slot);
+
+            submit_offset += want;
+            if(!read_to_eof) {
+                bytes_unsubmitted -= want;
+            }
+            next_submit++;
+            n_in_flight++;
+        }
+
+        if(n_in_flight == 0) {
+            break;
+        }
+
+        if(!rm_hasher_ring_submit_and_wait(ring, 1)) {
+            rm_log_perror("io_uring_enter failed");
+
+            /* the kernel never saw the reads which are still unsubmitted;
+             * they are the newest ones */
+            for(guint64 seq = next_submit - ring->n_unsubmitted; seq < next_submit; seq++) {
+                results[seq % depth] = -ECANCELED;
+            }
+
+            guint n_lost = rm_hasher_ring_abandon(ring, n_in_flight - ring->n_unsubmitted,
+                                                  results, RM_HASHER_RING_DEPTH);
+
+            /* buffers of reads which never completed may still be written to
+             * by the kernel, so they cannot be released */
+            for(; next_send < next_submit; next_send++) {
+                guint slot = next_send % depth;
+                if(results[slot] != RM_HASHER_RING_PENDING) {
+                    rm_buffer_free(hasher->buf_sem, slots[slot]);
+                }
+            }
+            if(n_lost > 0) {
+                rm_log_error_line("io_uring: %u read buffers lost for %s", n_lost, path);
+            }
+            return FALSE;
+        }
+        n_in_flight -= rm_hasher_ring_reap(ring, results, RM_HASHER_RING_DEPTH);
+
+        /* send completed buffers to the hasher, in file order */
+        for(; next_send < next_submit &&
+              results[next_send % depth] != RM_HASHER_RING_PENDING;
+            next_send++) {
+            guint slot = next_send % depth;
+            RmBuffer *buffer = slots[slot];
+
+            if(results[slot] == -EINVAL && slots[slot]->pool && !failed && !hit_eof) {
+                /* filesystem refuses O_DIRECT reads; retry this one (and any
+                 * which follow) as a normal read */
+                *direct = rm_hasher_fd_set_direct(fd, FALSE);
+                if(!*direct) {
+                    results[slot] = RM_HASHER_RING_PENDING;
+                    rm_hasher_ring_prep_read(ring, fd, buffer->data, wanted[slot],
+                                             offsets[slot], slot);
+                    n_in_flight++;
+                    break;
+                }
+            }
+
+            if(results[slot] < 0 && !failed && !hit_eof) {
+                errno = -results[slot];
+                rm_log_perror("io_uring read failed");
+                failed = TRUE;
+            }
+
+            gint32 len = MIN(results[slot], (gint32)wanted[slot]);
+            if(failed || hit_eof || len <= 0) {
+                rm_buffer_free(hasher->buf_sem, buffer);
+            } else {
+                buffer->len = len;
+                buffer->digest = digest;
+                buffer->user_data = NULL;
+                *bytes_actually_read += buffer->len;
+                rm_hasher_send(hasher, hashpipe, buffer);
+            }
+
+            if(results[slot] < (gint32)wanted[slot]) {
+                /* short read means we reached the end of file */
+                hit_eof = TRUE;
+            }
+        }
+
+        if(!*direct) {
+            rm_hasher_drop_behind(hasher, fd, &dropped,
+                                  start_offset + *bytes_actually_read, FALSE);
+        }
+    }
+
+    if(!*direct) {
+        rm_hasher_drop_behind(hasher, fd, &dropped, start_offset + *bytes_actually_read,
+                              TRUE);
+    }
+
+    if(failed) {
+        return FALSE;
+    } else if(!read_to_eof && *bytes_actually_read < (gsize)bytes_to_read) {
+        rm_log_error_line(_("Something went wrong reading %s; expected %li bytes, "
+                            "got %li; ignoring"),
+                          path, (long int)bytes_to_read,
+                          (long int)*bytes_actually_read);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+#endif
+
+//////////////////////////////////////
+//  Batched Reads                   //
+//////////////////////////////////////
+
+typedef struct RmHasherBatchItem {
+    char *path;
+    guint64 start_offset;
+    gsize bytes_to_read;
+
+    /* the following are set by rm_hasher_batch_read() */
+
+    /* TRUE if the read was attempted as part of the batch */
+    gboolean prefetched;
+    gboolean success;
+    gsize bytes_read;
+
+    /* buffers holding the data; NULL'ed once handed to the hashpipe */
+    guint n_buffers;
+    RmBuffer **buffers;
+} RmHasherBatchItem;
+
+struct _RmHasherBatch {
+    RmHasher *hasher;
+
+    /* array of RmHasherBatchItem */
+    GArray *items;
+
+    /* total number of buffers needed for the batch */
+    guint n_buffers;
+};
+
+gboolean rm_hasher_batch_is_supported(RmHasher *hasher) {
+    /* batched reads go through the page cache, so O_DIRECT files are read singly */
+    return hasher->use_io_uring && !hasher->use_direct_io;
+}
+
+RmHasherBatch *rm_hasher_batch_new(RmHasher *hasher) {
+    RmHasherBatch *self = g_slice_new0(RmHasherBatch);
+    self->hasher = hasher;
+    self->items = g_array_new(FALSE, TRUE, sizeof(RmHasherBatchItem));
+    return self;
+}
+
+void rm_hasher_batch_free(RmHasherBatch *batch) {
+    for(guint i = 0; i < batch->items->len; ++i) {
+        RmHasherBatchItem *item = &g_array_index(batch->items, RmHasherBatchItem, i);
+        if(item->buffers) {
+            for(guint j = 0; j < item->n_buffers; ++j) {
+                if(item->buffers[j]) {
+                    rm_buffer_free(batch->hasher->buf_sem, item->buffers[j]);
+                }
+            }
+            g_slice_free1(sizeof(RmBuffer *) * item->n_buffers, item->buffers);
+        }
+        g_free(item->path);
+    }
+    g_array_free(batch->items, TRUE);
+    g_slice_free(RmHasherBatch, batch);
+}
+
+gint rm_hasher_batch_add(RmHasherBatch *batch, const char *path, guint64 start_offset,
+                         gsize bytes_to_read) {
+    RmHasher *hasher = batch->hasher;
+    if(!rm_hasher_batch_is_supported(hasher) || bytes_to_read == 0) {
+        return -1;
+    }
+
+    guint n_buffers = DIVIDE_CEIL(bytes_to_read, hasher->buf_size);
+    if(batch->n_buffers + n_buffers > RM_HASHER_BATCH_MAX_BUFFERS) {
+        return -1;
+    }
+    batch->n_buffers += n_buffers;
+
+    RmHasherBatchItem item;
+    memset(&item, 0, sizeof(item));
+    item.path = g_strdup(path);
+    item.start_offset = start_offset;
+    item.bytes_to_read = bytes_to_read;
+    item.n_buffers = n_buffers;
+    g_array_append_val(batch->items, item);
+
+    return batch->items->len - 1;
+}
+
+#if HAVE_IO_URING
+
+/* Open, read and close all batch items using one io_uring submission per stage,
+ * rather than three syscalls per file */
+static void rm_hasher_batch_ring_read(RmHasherBatch *batch, RmHasherRing *ring) {
+    RmHasher *hasher = batch->hasher;
+    RmHasherBatchItem *items = (RmHasherBatchItem *)batch->items->data;
+    guint n_items = batch->items->len;
+
+    /* results are indexed by item for open and by buffer for reads */
+    gint32 results[RM_HASHER_BATCH_MAX_BUFFERS];
+    int fds[RM_HASHER_BATCH_MAX_BUFFERS];
+
+    /* stage 1: open all files */
+    for(guint i = 0; i < n_items; ++i) {
+        struct io_uring_sqe *sqe =
+            rm_hasher_ring_next_sqe(ring, IORING_OP_OPENAT, AT_FDCWD, i);
+        sqe->addr = (guint64)(uintptr_t)items[i].path;
+        sqe->open_flags = O_RDONLY
+#ifdef O_LARGEFILE
+                          | O_LARGEFILE
+#endif
+            ;
+        rm_hasher_ring_push(ring);
+        results[i] = RM_HASHER_RING_PENDING;
+    }
+
+    if(!rm_hasher_ring_run(ring, n_items, results, n_items)) {
+        /* nothing prefetched; items will be read the conventional way */
+        rm_log_perror("io_uring_enter failed");
+        guint n_lost = rm_hasher_ring_fail(ring, n_items, NULL, results, n_items);
+        for(guint i = 0; i < n_items; ++i) {
+            if(results[i] >= 0) {
+                rm_sys_close(results[i]);
+            }
+        }
+        if(n_lost > 0) {
+            rm_log_error_line("io_uring: %u batched opens did not finish", n_lost);
+        }
+        return;
+    }
+
+    /* stage 2: read all files */
+    guint n_reads = 0;
+    for(guint i = 0; i < n_items; ++i) {
+        RmHasherBatchItem *item = &items[i];
+        fds[i] = results[i];
+        item->prefetched = TRUE;
+
+        if(fds[i] < 0) {
+            rm_log_info("open(2) failed for %s: %s\n", item->path,
+                        g_strerror(-fds[i]));
+            continue;
+        }
+
+        item->buffers = g_slice_alloc0(sizeof(RmBuffer *) * item->n_buffers);
+        for(guint j = 0; j < item->n_buffers; ++j) {
+            gsize offset = j * hasher->buf_size;
+            RmBuffer *buffer = rm_buffer_new(hasher->buf_sem, hasher->buf_size);
+            item->buffers[j] = buffer;
+            results[n_reads] = RM_HASHER_RING_PENDING;
+            rm_hasher_ring_prep_read(ring, fds[i], buffer->data,
+                                     MIN(hasher->buf_size, item->bytes_to_read - offset),
+                                     item->start_offset + offset, n_reads++);
+        }
+    }
+
+    if(!rm_hasher_ring_run(ring, n_reads, results, n_reads)) {
+        /* read everything the conventional way instead */
+        rm_log_perror("io_uring_enter failed");
+        guint n_lost = rm_hasher_ring_fail(ring, n_reads, NULL, results, n_reads);
+
+        guint read_index = 0;
+        for(guint i = 0; i < n_items; ++i) {
+            RmHasherBatchItem *item = &items[i];
+            if(fds[i] < 0) {
+                continue;
+            }
+
+            /* buffers of reads which never completed may still be written to
+             * by the kernel, so they cannot be released */
+            for(guint j = 0; j < item->n_buffers; ++j) {
+                if(results[read_index++] != RM_HASHER_RING_PENDING) {
+                    rm_buffer_free(hasher->buf_sem, item->buffers[j]);
+                }
+            }
+            g_slice_free1(sizeof(RmBuffer *) * item->n_buffers, item->buffers);
+            item->buffers = NULL;
+            item->prefetched = FALSE;
+
+            /* reads still in flight hold their own reference to the file */
+            rm_sys_close(fds[i]);
+        }
+        if(n_lost > 0) {
+            rm_log_error_line("io_uring: %u batched read buffers lost", n_lost);
+        }
+        return;
+    }
+
+    /* stage 3: close all files (dropping what we read from the page cache first
+     * if asked to; the hard link makes sure the close happens regardless).
+     * close_results are indexed by item for CLOSE and by n_items + item for
+     * FADVISE. */
+    gint32 close_results[2 * RM_HASHER_BATCH_MAX_BUFFERS];
+    guint pushed[2 * RM_HASHER_BATCH_MAX_BUFFERS];
+    guint n_closing = 0;
+    for(guint i = 0; i < n_items; ++i) {
+        if(fds[i] < 0) {
+            continue;
+        }
+        if(hasher->drop_cache) {
+            struct io_uring_sqe *sqe =
+                rm_hasher_ring_next_sqe(ring, IORING_OP_FADVISE, fds[i], n_items + i);
+            sqe->off = items[i].start_offset;
+            sqe->len = items[i].bytes_to_read;
+            sqe->fadvise_advice = POSIX_FADV_DONTNEED;
+            sqe->flags = IOSQE_IO_HARDLINK;
+            rm_hasher_ring_push(ring);
+            close_results[n_items + i] = RM_HASHER_RING_PENDING;
+            pushed[n_closing++] = n_items + i;
+        }
+        rm_hasher_ring_next_sqe(ring, IORING_OP_CLOSE, fds[i], i);
+        rm_hasher_ring_push(ring);
+        close_results[i] = RM_HASHER_RING_PENDING;
+        pushed[n_closing++] = i;
+    }
+
+    if(!rm_hasher_ring_run(ring, n_closing, close_results, 2 * n_items)) {
+        /* the reads are complete, so carry on with them */
+        rm_log_perror("io_uring_enter failed");
+        rm_hasher_ring_fail(ring, n_closing, pushed, close_results, 2 * n_items);
+        for(guint i = 0; i < n_items; ++i) {
+            /* a pending CLOSE may still happen, so leave those alone */
+            if(fds[i] >= 0 && close_results[i] == -ECANCELED) {
+                rm_sys_close(fds[i]);
+            }
+        }
+    }
+
+    /* collect read results in file order */
+    guint read_index = 0;
+    for(guint i = 0; i < n_items; ++i) {
+        RmHasherBatchItem *item = &items[i];
+        if(fds[i] < 0) {
+            continue;
+        }
+
+        gboolean hit_eof = FALSE;
+        item->success = TRUE;
+        for(guint j = 0; j < item->n_buffers; ++j) {
+            gint32 result = results[read_index++];
+            RmBuffer *buffer = item->buffers[j];
+            gsize want = MIN(hasher->buf_size, item->bytes_to_read - j * hasher->buf_size);
+
+            if(result < 0 && item->success && !hit_eof) {
+                errno = -result;
+                rm_log_perror("io_uring read failed");
+                item->success = FALSE;
+            }
+
+            buffer->len = (item->success && !hit_eof) ? MAX(result, 0) : 0;
+            item->bytes_read += buffer->len;
+
+            if(result < (gint32)want) {
+                /* short read means we reached the end of file */
+                hit_eof = TRUE;
+            }
+        }
+
+        if(item->success && item->bytes_read < item->bytes_to_read) {
+            rm_log_error_line(_("Something went wrong reading %s; expected %li bytes, "
+                                "got %li; ignoring"),
+                              item->path, (long int)item->bytes_to_read,
+                              (long int)item->bytes_read);
+            item->success = FALSE;
+        }
+
+        rm_hasher_count_read(hasher, item->bytes_read, FALSE);
+    }
+}
+
+#endif
+
+void rm_hasher_batch_read(RmHasherBatch *batch) {
+#if HAVE_IO_URING
+    RmHasherRing *ring = NULL;
+    if(batch->items->len > 0 && batch->hasher->use_io_uring &&
+       (ring = rm_hasher_ring_get()) != NULL) {
+        rm_hasher_batch_ring_read(batch, ring);
+    }
+#else
+    (void)batch;
+#endif
+}
+
 //////////////////////////////////////
 //  RmHasher                        //
 //////////////////////////////////////
@@ -374,10 +1459,11 @@ RmHasher *rm_hasher_new(RmDigestType digest_type,
     if(digest_type != RM_DIGEST_PARANOID) {
         int max_buffers = num_threads * 64;
         if(!use_buffered_read) {
-            /*  preadv() uses N_PREADV_BUFFERS in parallel.
+            /*  preadv() uses N_PREADV_BUFFERS in parallel, io_uring keeps
+             *  up to RM_HASHER_RING_DEPTH reads in flight.
              *  Need at least this many for one operation.
              *  */
-            max_buffers *= N_PREADV_BUFFERS;
+            max_buffers *= MAX(N_PREADV_BUFFERS, RM_HASHER_RING_DEPTH);
         }
 
         self->buf_sem = rm_semaphore_new(max_buffers);
@@ -386,7 +1472,9 @@ RmHasher *rm_hasher_new(RmDigestType digest_type,
     }
 
     self->use_buffered_read = use_buffered_read;
+    rm_hasher_set_use_io_uring(self, TRUE);
     self->buf_size = buf_size;
+    self->page_size = sysconf(_SC_PAGESIZE);
     self->cache_quota_bytes = cache_quota_bytes;
 
     if(joiner) {
@@ -407,6 +1495,15 @@ RmHasher *rm_hasher_new(RmDigestType digest_type,
     self->hashpipe_pool = g_async_queue_new_full((GDestroyNotify)rm_hasher_hashpipe_free);
     g_assert(num_threads > 0);
     self->unalloc_hashpipes = num_threads;
+
+    /* Leaves can be hashed by any thread.  A gathered leaf
+     * holds up to RM_DIGEST_TREE_LEAF_SIZE / buf_size buffers, which must stay
+     * well below what buf_sem allows per thread. */
+    if(rm_digest_has_leaves(digest_type) && !use_buffered_read &&
+       buf_size * 64 >= RM_DIGEST_TREE_LEAF_SIZE) {
+        self->leaf_pool =
+            rm_util_thread_pool_new((GFunc)rm_hasher_leaf_worker, self, num_threads);
+    }
     return self;
 }
 
@@ -427,6 +1524,10 @@ void rm_hasher_free(RmHasher *hasher, gboolean wait) {
 
     g_async_queue_unref(hasher->hashpipe_pool);
 
+    if(hasher->leaf_pool) {
+        g_thread_pool_free(hasher->leaf_pool, FALSE, TRUE);
+    }
+
     g_cond_clear(&hasher->cond);
     g_mutex_clear(&hasher->lock);
 
@@ -434,9 +1535,76 @@ void rm_hasher_free(RmHasher *hasher, gboolean wait) {
         rm_semaphore_destroy(hasher->buf_sem);
     }
 
+    if(hasher->direct_pool) {
+        /* buffers still held by paranoid digests keep the pool alive */
+        rm_buffer_pool_unref(hasher->direct_pool);
+    }
+
     g_slice_free(RmHasher, hasher);
 }
 
+gboolean rm_hasher_set_use_direct_io(RmHasher *hasher, gboolean use_direct_io) {
+    hasher->drop_cache = use_direct_io && HAVE_POSIX_FADVISE;
+
+#ifdef O_DIRECT
+    hasher->use_direct_io = use_direct_io && !hasher->use_buffered_read &&
+                            hasher->buf_size % RM_HASHER_DIRECT_ALIGN == 0;
+#else
+    hasher->use_direct_io = FALSE;
+#endif
+
+    if(hasher->use_direct_io && !hasher->direct_pool) {
+        hasher->direct_pool =
+            rm_buffer_pool_new(hasher->buf_size, RM_HASHER_DIRECT_ALIGN);
+    }
+    return hasher->use_direct_io;
+}
+
+RmOff rm_hasher_set_mmap_threshold(RmHasher *hasher, RmOff threshold) {
+    /* paranoid digests hold on to their buffers, which would pin the mappings;
+     * mapped pages can't be dropped from the page cache behind the reader */
+    if(hasher->use_buffered_read || hasher->digest_type == RM_DIGEST_PARANOID ||
+       hasher->drop_cache) {
+        threshold = 0;
+    }
+    hasher->mmap_threshold = threshold;
+    return threshold;
+}
+
+int rm_hasher_open(RmHasher *hasher, const char *path) {
+#ifdef O_DIRECT
+    if(hasher->use_direct_io) {
+        int fd = rm_sys_open(path, O_RDONLY | O_DIRECT);
+        if(fd != -1 || errno != EINVAL) {
+            return fd;
+        }
+        /* filesystem does not support O_DIRECT; read this file normally */
+    }
+#endif
+    return rm_sys_open(path, O_RDONLY);
+}
+
+void rm_hasher_get_read_stats(RmHasher *hasher, guint64 *bytes_direct,
+                              guint64 *bytes_cached) {
+    g_mutex_lock(&hasher->lock);
+    {
+        *bytes_direct = hasher->bytes_read_direct;
+        *bytes_cached = hasher->bytes_read_cached;
+    }
+    g_mutex_unlock(&hasher->lock);
+}
+
+gboolean rm_hasher_set_use_io_uring(RmHasher *hasher, gboolean use_io_uring) {
+#if HAVE_IO_URING
+    hasher->use_io_uring =
+        use_io_uring && !hasher->use_buffered_read && rm_hasher_ring_is_supported();
+#else
+    (void)use_io_uring;
+    hasher->use_io_uring = FALSE;
+#endif
+    return hasher->use_io_uring;
+}
+
 RmHasherTask *rm_hasher_task_new(RmHasher *hasher, RmDigest *digest,
                                  gpointer task_user_data) {
     g_mutex_lock(&hasher->lock);
@@ -471,6 +1639,42 @@ RmHasherTask *rm_hasher_task_new(RmHasher *hasher, RmDigest *digest,
     return self;
 }
 
+/* Reads from an already opened fd; path is only used for messages */
+static gboolean rm_hasher_fd_read(RmHasherTask *task, int fd, const char *path,
+                                  guint64 start_offset, gsize bytes_to_read,
+                                  gsize *bytes_read) {
+    RmHasher *hasher = task->hasher;
+    gboolean direct = rm_hasher_fd_is_direct(hasher, fd, start_offset);
+    gboolean success = FALSE;
+    RmOff end = 0;
+#if HAVE_IO_URING
+    RmHasherRing *ring = NULL;
+#endif
+
+    /* only rm_hasher_unbuffered_read() skips the holes of sparse files */
+    gboolean sparse = rm_hasher_fd_is_sparse(fd);
+
+    if(!sparse && !direct &&
+       rm_hasher_fd_use_mmap(hasher, fd, start_offset, bytes_to_read, &end) &&
+       rm_hasher_mmap_read(hasher, task->hashpipe, task->digest, fd, start_offset, end,
+                           bytes_read)) {
+        success = TRUE;
+#if HAVE_IO_URING
+    } else if(!sparse && hasher->use_io_uring && (ring = rm_hasher_ring_get()) != NULL) {
+        success = rm_hasher_ring_read(hasher, ring, task->hashpipe, task->digest, fd,
+                                      path, start_offset, bytes_to_read, &direct,
+                                      bytes_read);
+#endif
+    } else {
+        success = rm_hasher_unbuffered_read(hasher, task->hashpipe, task->digest, fd,
+                                            path, start_offset, bytes_to_read, sparse,
+                                            &direct, bytes_read);
+    }
+
+    rm_hasher_count_read(hasher, *bytes_read, direct);
+    return success;
+}
+
 gboolean rm_hasher_task_hash(RmHasherTask *task, char *path, guint64 start_offset,
                              gsize bytes_to_read, gboolean is_symlink,
                              gsize *bytes_read_out) {
@@ -484,9 +1688,14 @@ gboolean rm_hasher_task_hash(RmHasherTask *task, char *path, guint64 start_offse
         success = rm_hasher_buffered_read(task->hasher, task->hashpipe, task->digest,
                                           path, start_offset, bytes_to_read, &bytes_read);
     } else {
-        success =
-            rm_hasher_unbuffered_read(task->hasher, task->hashpipe, task->digest, path,
-                                      start_offset, bytes_to_read, &bytes_read);
+        int fd = rm_hasher_open(task->hasher, path);
+        if(fd == -1) {
+            rm_log_info("open(2) failed for %s: %s\n", path, g_strerror(errno));
+        } else {
+            success = rm_hasher_fd_read(task, fd, path, start_offset, bytes_to_read,
+                                        &bytes_read);
+            rm_sys_close(fd);
+        }
     }
 
     if(bytes_read_out != NULL) {
@@ -497,10 +1706,60 @@ gboolean rm_hasher_task_hash(RmHasherTask *task, char *path, guint64 start_offse
     return success;
 }
 
+gboolean rm_hasher_task_hash_fd(RmHasherTask *task, int fd, guint64 start_offset,
+                                gsize bytes_to_read, gsize *bytes_read_out) {
+    gsize bytes_read = 0;
+
+    char name[32];
+    g_snprintf(name, sizeof(name), "<fd %d>", fd);
+
+    gboolean success =
+        rm_hasher_fd_read(task, fd, name, start_offset, bytes_to_read, &bytes_read);
+
+    if(bytes_read_out != NULL) {
+        *bytes_read_out = bytes_read;
+    }
+
+    return success;
+}
+
+gboolean rm_hasher_task_hash_batched(RmHasherTask *task, RmHasherBatch *batch,
+                                     guint index, gsize *bytes_read_out) {
+    g_assert(index < batch->items->len);
+    RmHasherBatchItem *item = &g_array_index(batch->items, RmHasherBatchItem, index);
+
+    if(!item->prefetched) {
+        return rm_hasher_task_hash(task, item->path, item->start_offset,
+                                   item->bytes_to_read, FALSE, bytes_read_out);
+    }
+
+    for(guint i = 0; item->buffers && i < item->n_buffers; ++i) {
+        RmBuffer *buffer = item->buffers[i];
+        if(item->success && buffer->len > 0) {
+            buffer->digest = task->digest;
+            buffer->user_data = NULL;
+            rm_hasher_send(task->hasher, task->hashpipe, buffer);
+        } else {
+            rm_buffer_free(task->hasher->buf_sem, buffer);
+        }
+        item->buffers[i] = NULL;
+    }
+
+    if(bytes_read_out != NULL) {
+        *bytes_read_out = item->bytes_read;
+    }
+
+    return item->success;
+}
+
 RmDigest *rm_hasher_task_finish(RmHasherTask *task) {
     /* get a dummy buffer to use to signal the hasher thread that this increment is
      * finished */
     RmHasher *hasher = task->hasher;
+
+    /* a partial leaf is hashed in place */
+    rm_hasher_leaf_flush(task->digest, task->hashpipe);
+
     RmBuffer *finisher = rm_buffer_new(hasher->buf_sem, hasher->buf_size);
     finisher->digest = task->digest;
     finisher->len = 0;
@@ -44,7 +44,10 @@
  * File checksum calculation is done in one or more background threads,
  * so that file reading can proceed uninterrupted.  This should give
  * faster performance than conventional (single-threaded) checksum
- * calculating utilities
+ * calculating utilities.  Each file normally goes through a single hashing
+ * thread, since most checksums must be fed in order; the exception are
+ * tree hashes like blake3, whose leaves are spread over all threads (see
+ * rm_digest_has_leaves()).
  *
  *
  **/
@@ -66,6 +69,15 @@ typedef struct _RmHasher RmHasher;
  **/
 typedef struct _RmHasherTask RmHasherTask;
 
+/**
+ * @struct RmHasherBatch
+ * RmHasherBatch is an opaque data structure for reading the start of many
+ * (small) files in one go.  Files are added via rm_hasher_batch_add(), read
+ * together by rm_hasher_batch_read() and then hashed individually via
+ * rm_hasher_task_hash_batched().
+ **/
+typedef struct _RmHasherBatch RmHasherBatch;
+
 /**
  * @brief RmHasherCallback function prototype for rm_hasher_task_finish()
  *
@@ -106,6 +118,56 @@ RmHasher *rm_hasher_new(RmDigestType digest_type,
                         RmHasherCallback joiner,
                         gpointer session_user_data);
 
+/**
+ * @brief Enable or disable reading via io_uring.
+ *
+ * io_uring is enabled by default for unbuffered reads if the kernel supports it;
+ * if it is unavailable (or the build lacks HAVE_IO_URING) preadv() is used.
+ *
+ * @retval TRUE if io_uring will be used.
+ **/
+gboolean rm_hasher_set_use_io_uring(RmHasher *hasher, gboolean use_io_uring);
+
+/**
+ * @brief Bypass the page cache while reading files.
+ *
+ * Files are opened via rm_hasher_open() with O_DIRECT and read into aligned
+ * buffers.  Files on filesystems which refuse O_DIRECT (and unaligned reads)
+ * fall back to normal reads; the data they read is then dropped from the
+ * page cache via POSIX_FADV_DONTNEED behind the read cursor.
+ *
+ * @retval TRUE if O_DIRECT will be tried; FALSE if only dropping is possible
+ * (buffered reads, or buf_size not a multiple of the block size).
+ **/
+gboolean rm_hasher_set_use_direct_io(RmHasher *hasher, gboolean use_direct_io);
+
+/**
+ * @brief mmap() increments of files of at least threshold bytes instead of
+ * reading them, and hash the mapped pages directly (no copy to read buffers).
+ *
+ * Not used for paranoid digests, buffered reads or with rm_hasher_set_use_direct_io(),
+ * which must be called first.
+ *
+ * @param threshold  Minimum file size; pass 0 to disable (the default).
+ * @retval the threshold in effect; 0 if mmap() won't be used.
+ **/
+RmOff rm_hasher_set_mmap_threshold(RmHasher *hasher, RmOff threshold);
+
+/**
+ * @brief Open a file for reading, with O_DIRECT if enabled and supported.
+ *
+ * @retval the file descriptor, or -1 with errno set.
+ **/
+int rm_hasher_open(RmHasher *hasher, const char *path);
+
+/**
+ * @brief Get the number of bytes read bypassing the page cache (bytes_direct)
+ * and the number of bytes read into the page cache and left there (bytes_cached).
+ **/
+void rm_hasher_get_read_stats(RmHasher *hasher,
+                              guint64 *bytes_direct,
+                              guint64 *bytes_cached);
+
 /**
  * @brief Free a hashing object
  *
@@ -145,6 +207,77 @@ gboolean rm_hasher_task_hash(RmHasherTask *task,
                              gboolean is_symlink,
                              gsize *bytes_read_out);
 
+/**
+ * @brief Like rm_hasher_task_hash() but read from an already opened file.
+ *
+ * Always reads unbuffered (preadv or io_uring); the caller keeps ownership of fd,
+ * which should have been opened via rm_hasher_open().
+ *
+ * @param task  An existing RmHasherTask
+ * @param fd  A file descriptor opened for reading
+ * @param start_offset  Where to start reading the file (number of bytes from start)
+ * @param bytes_to_read  How many bytes to read (pass 0 to read whole file)
+ * @param bytes_read_out Out parameter for the number of bytes physically read.
+ * @retval FALSE if read errors occurred
+ **/
+gboolean rm_hasher_task_hash_fd(RmHasherTask *task,
+                                int fd,
+                                guint64 start_offset,
+                                size_t bytes_to_read,
+                                gsize *bytes_read_out);
+
+/**
+ * @brief Check whether rm_hasher_batch_add() can accept any reads; needs
+ * io_uring (refer rm_hasher_set_use_io_uring()) and no O_DIRECT.
+ **/
+gboolean rm_hasher_batch_is_supported(RmHasher *hasher);
+
+/**
+ * @brief Allocate a new (empty) read batch
+ **/
+RmHasherBatch *rm_hasher_batch_new(RmHasher *hasher);
+
+/**
+ * @brief Free a read batch, including any data which was not hashed.
+ **/
+void rm_hasher_batch_free(RmHasherBatch *batch);
+
+/**
+ * @brief Add a file read to a batch
+ *
+ * @param path  The file path to read from (will be copied)
+ * @param start_offset  Where to start reading the file
+ * @param bytes_to_read  How many bytes to read
+ * @retval index of the read within the batch, or -1 if the read can't be batched
+ * (batch is full, or the hasher can't batch reads)
+ **/
+gint rm_hasher_batch_add(RmHasherBatch *batch,
+                         const char *path,
+                         guint64 start_offset,
+                         gsize bytes_to_read);
+
+/**
+ * @brief Open, read and close all files in a batch.
+ *
+ * With io_uring each of the three steps is a single submission for the whole
+ * batch.  Otherwise this is a no-op and each file is read individually by
+ * rm_hasher_task_hash_batched().
+ **/
+void rm_hasher_batch_read(RmHasherBatch *batch);
+
+/**
+ * @brief Send one file's data from a batch for hashing
+ *
+ * Equivalent to rm_hasher_task_hash() with the path and offsets passed to
+ * rm_hasher_batch_add().
+ *
+ * @retval FALSE if read errors occurred
+ **/
+gboolean rm_hasher_task_hash_batched(RmHasherTask *task,
+                                     RmHasherBatch *batch,
+                                     guint index,
+                                     gsize *bytes_read_out);
+
 /**
  * @brief Finalise a hashing task
  *
@@ -23,6 +23,7 @@
  *
  */
 
+#include "arena.h"
 #include "md-scheduler.h"
 
 /* How many milliseconds to sleep if we encounter an empty file queue.
@@ -35,6 +36,22 @@
 #define MDS_EMPTYQUEUE_SLEEP_US (50 * 1000) /* 0.05 second */
 #endif
 
+/* Weight of the newest read in the device throughput model; older reads fade
+ * out by (1 - weight) per read so the model follows e.g. a change from small
+ * scattered files to large ones */
+#define MDS_MODEL_WEIGHT (0.05)
+
+/* Number of reads before the throughput model is trusted */
+#define MDS_MODEL_MIN_READS (16)
+
+/* The model counts in MiB, which keeps its sums well conditioned */
+#define MDS_MODEL_UNIT (1024 * 1024)
+
+/* Reads are weighted by their inverse squared duration, so that the timing
+ * noise of large reads does not drown out the seek time; this floor (in
+ * seconds) keeps page cache hits from getting all the weight */
+#define MDS_MODEL_MIN_TIME (1e-4)
+
 ///////////////////////////////////////
 //            Structures             //
 ///////////////////////////////////////
@@ -45,6 +62,10 @@ struct _RmMDS {
     /* The function called for each task */
     RmMDSFunc func;
 
+    /* If set, called instead of func with up to batch_size tasks at a time */
+    RmMDSBatchFunc batch_func;
+    guint batch_size;
+
     /* Threadpool for device workers */
     GThreadPool *pool;
 
@@ -79,8 +100,20 @@ struct _RmMDS {
 
     /* pointer to user data to be passed to func */
     gpointer user_data;
+
+    /* RmMDSTaskNodes of all devices come from here */
+    RmArena task_arena;
 };
 
+/* A task together with its link in the device's task lists, so that queueing
+ * a task needs no allocation of its own.  The lists are only ever relinked
+ * (sorted, concatenated), never freed by GLib. */
+typedef struct RmMDSTaskNode {
+    /* must come first; a RmMDSTask * is also a RmMDSTaskNode * */
+    RmMDSTask task;
+    GSList link;
+} RmMDSTaskNode;
+
 struct _RmMDSDevice {
     /* Structure containing data associated with one Device worker thread */
 
@@ -100,6 +133,7 @@ struct _RmMDSDevice {
      *  self->sorted_tasks
      *  self->unsorted_tasks
      *  self->ref_count
+     *  self->model
      */
     GMutex lock;
     GCond cond;
@@ -112,6 +146,17 @@ struct _RmMDSDevice {
 
     /* is disk rotational? */
     gboolean is_rotational;
+
+    /* Throughput model, refer rm_mds_device_record_read() */
+    struct {
+        /* weighted sums over reads of seeked (s), MiB read (x) and seconds (y) */
+        gdouble s, xx, sx, sy, xy;
+        guint reads;
+
+        /* last fit; both 0 if not enough reads yet */
+        gdouble seek_time;
+        gdouble bandwidth;
+    } model;
 };
 
 //////////////////////////////////////////////
@@ -119,17 +164,20 @@ struct _RmMDSDevice {
 //////////////////////////////////////////////
 
 /* RmMDSTask */
-static RmMDSTask *rm_mds_task_new(const dev_t dev, const guint64 offset,
+static RmMDSTask *rm_mds_task_new(RmMDS *mds, const dev_t dev, const guint64 offset,
                                   const gpointer task_data) {
-    RmMDSTask *self = g_slice_new0(RmMDSTask);
+    RmMDSTaskNode *node = rm_arena_alloc0(&mds->task_arena);
+    node->link.data = &node->task;
+
+    RmMDSTask *self = &node->task;
     self->dev = dev;
     self->offset = offset;
     self->task_data = task_data;
     return self;
 }
 
-static void rm_mds_task_free(RmMDSTask *task) {
-    g_slice_free(RmMDSTask, task);
+static void rm_mds_task_free(RmMDS *mds, RmMDSTask *task) {
+    rm_arena_free(&mds->task_arena, task);
 }
 
 /* RmMDSDevice */
@@ -158,6 +206,11 @@ static RmMDSDevice *rm_mds_device_new(RmMDS *mds, const dev_t disk) {
 /** @brief  Free mem allocated to an RmMDSDevice
  **/
 static void rm_mds_device_free(RmMDSDevice *self) {
+    if(self->model.bandwidth > 0) {
+        rm_log_debug_line("Disk #%" LLU " model after %u reads: %.2f ms per seek, %.1f MiB/s",
+                          (RmOff)self->disk, self->model.reads,
+                          self->model.seek_time * 1000, self->model.bandwidth);
+    }
     g_mutex_clear(&self->lock);
     g_cond_clear(&self->cond);
     g_slice_free(RmMDSDevice, self);
@@ -171,9 +224,11 @@ static void rm_mds_device_free(RmMDSDevice *self) {
  **/
 
 static void rm_mds_push_task_impl(RmMDSDevice *device, RmMDSTask *task) {
+    GSList *link = &((RmMDSTaskNode *)task)->link;
     g_mutex_lock(&device->lock);
     {
-        device->unsorted_tasks = g_slist_prepend(device->unsorted_tasks, task);
+        link->next = device->unsorted_tasks;
+        device->unsorted_tasks = link;
         g_cond_signal(&device->cond);
     }
     g_mutex_unlock(&device->lock);
@@ -187,6 +242,47 @@ static gint rm_mds_compare(const RmMDSTask *a, const RmMDSTask *b,
     return result;
 }
 
+/** @brief Mutex-protected pop from device->sorted_tasks; unlike
+ * rm_util_slist_pop() this leaves the link alone since it belongs to the task
+ **/
+static RmMDSTask *rm_mds_pop_task(RmMDSDevice *device) {
+    RmMDSTask *task = NULL;
+    g_mutex_lock(&device->lock);
+    {
+        if(device->sorted_tasks) {
+            task = device->sorted_tasks->data;
+            device->sorted_tasks = device->sorted_tasks->next;
+        }
+    }
+    g_mutex_unlock(&device->lock);
+    return task;
+}
+
+/** @brief process one pass of device->sorted_tasks via mds->batch_func
+ * @retval number of tasks processed
+ **/
+static gint rm_mds_factory_batched(RmMDSDevice *device, RmMDS *mds) {
+    gint processed = 0;
+    gpointer task_data[mds->batch_size];
+    RmMDSTask *task = NULL;
+
+    while(processed < mds->pass_quota) {
+        guint n_tasks = 0;
+        while(n_tasks < mds->batch_size && processed + (gint)n_tasks < mds->pass_quota &&
+              (task = rm_mds_pop_task(device))) {
+            task_data[n_tasks++] = task->task_data;
+            rm_mds_task_free(mds, task);
+        }
+
+        if(n_tasks == 0) {
+            break;
+        }
+
+        processed += mds->batch_func(task_data, n_tasks, mds->user_data);
+    }
+    return processed;
+}
+
 /** @brief RmMDSDevice worker thread
  **/
 static void rm_mds_factory(RmMDSDevice *device, RmMDS *mds) {
@@ -221,14 +317,18 @@ static void rm_mds_factory(RmMDSDevice *device, RmMDS *mds) {
     g_mutex_unlock(&device->lock);
 
     /* process tasks from device->sorted_tasks */
-    RmMDSTask *task = NULL;
-    while(processed < mds->pass_quota &&
-          (task = rm_util_slist_pop(&device->sorted_tasks, &device->lock))) {
-        if(mds->func(task->task_data, mds->user_data)) {
-            /* task succeeded; update counters */
-            ++processed;
+    if(mds->batch_func) {
+        processed = rm_mds_factory_batched(device, mds);
+    } else {
+        RmMDSTask *task = NULL;
+        while(processed < mds->pass_quota &&
+              (task = rm_mds_pop_task(device))) {
+            if(mds->func(task->task_data, mds->user_data)) {
+                /* task succeeded; update counters */
+                ++processed;
+            }
+            rm_mds_task_free(mds, task);
         }
-        rm_mds_task_free(task);
     }
 
     if(rm_mds_device_ref(device, 0) > 0) {
@@ -325,6 +425,8 @@ RmMDS *rm_mds_new(const gint max_threads, RmMountTable *mount_table, bool fake_d
     self->disks = g_hash_table_new(g_direct_hash, g_direct_equal);
     self->running = FALSE;
 
+    rm_arena_init(&self->task_arena, sizeof(RmMDSTaskNode));
+
     return self;
 }
 
@@ -341,6 +443,16 @@ void rm_mds_configure(RmMDS *self,
     self->threads_per_disk = threads_per_disk;
     self->pass_quota = (pass_quota > 0) ? pass_quota : G_MAXINT;
     self->prioritiser = prioritiser;
+    self->batch_func = NULL;
+    self->batch_size = 0;
+}
+
+void rm_mds_configure_batch(RmMDS *self, const RmMDSBatchFunc func, const guint batch_size) {
+    g_assert(self);
+    g_assert(self->running == FALSE);
+    g_assert(batch_size > 0);
+    self->batch_func = func;
+    self->batch_size = batch_size;
 }
 
 void rm_mds_finish(RmMDS *mds) {
@@ -364,6 +476,7 @@ void rm_mds_free(RmMDS *mds, gboolean free_mount_table) {
     rm_mds_finish(mds);
 
     g_hash_table_destroy(mds->disks);
+    rm_arena_clear(&mds->task_arena);
 
     if(free_mount_table && mds->mount_table) {
         rm_mounts_table_destroy(mds->mount_table);
@@ -401,13 +514,82 @@ gboolean rm_mds_device_is_rotational(RmMDSDevice *device) {
     return device->is_rotational;
 }
 
+/* Least squares fit of y = seek_time * s + x / bandwidth to the weighted sums */
+static void rm_mds_device_model_fit(RmMDSDevice *device) {
+    gdouble det = device->model.s * device->model.xx - device->model.sx * device->model.sx;
+    if(device->model.reads < MDS_MODEL_MIN_READS ||
+       det <= 1e-9 * device->model.s * device->model.xx) {
+        /* not enough reads, or all of the same size and kind */
+        return;
+    }
+
+    gdouble seek_time =
+        (device->model.sy * device->model.xx - device->model.sx * device->model.xy) / det;
+    gdouble time_per_mib =
+        (device->model.s * device->model.xy - device->model.sx * device->model.sy) / det;
+    if(time_per_mib <= 0) {
+        /* page cache hits or noise; keep the previous fit */
+        return;
+    }
+
+    device->model.seek_time = MAX(seek_time, 0);
+    device->model.bandwidth = 1.0 / time_per_mib;
+}
+
+void rm_mds_device_record_read(RmMDSDevice *device, guint64 bytes, gint64 usec,
+                               gboolean seeked) {
+    if(!device || bytes == 0 || usec < 0) {
+        return;
+    }
+
+    gdouble s = seeked ? 1 : 0;
+    gdouble x = (gdouble)bytes / MDS_MODEL_UNIT;
+    gdouble y = (gdouble)usec / G_USEC_PER_SEC;
+    gdouble w = 1 / ((y + MDS_MODEL_MIN_TIME) * (y + MDS_MODEL_MIN_TIME));
+    gdouble keep = 1 - MDS_MODEL_WEIGHT;
+
+    g_mutex_lock(&device->lock);
+    {
+        device->model.s = keep * device->model.s + w * s;
+        device->model.xx = keep * device->model.xx + w * x * x;
+        device->model.sx = keep * device->model.sx + w * s * x;
+        device->model.sy = keep * device->model.sy + w * s * y;
+        device->model.xy = keep * device->model.xy + w * x * y;
+        device->model.reads++;
+        rm_mds_device_model_fit(device);
+    }
+    g_mutex_unlock(&device->lock);
+}
+
+RmOff rm_mds_device_seek_bytes(RmMDSDevice *device) {
+    RmOff result = 0;
+    if(device) {
+        g_mutex_lock(&device->lock);
+        {
+            if(device->model.bandwidth > 0) {
+                result = device->model.seek_time * device->model.bandwidth * MDS_MODEL_UNIT;
+                result = MAX(result, 1);
+            }
+        }
+        g_mutex_unlock(&device->lock);
+    }
+    return result;
+}
+
 void rm_mds_push_task(RmMDSDevice *device, dev_t dev, gint64 offset, const char *path,
                       const gpointer task_data) {
     if(device->is_rotational && offset == -1) {
         offset = rm_offset_get_from_path(path, 0, NULL);
     }
 
-    RmMDSTask *task = rm_mds_task_new(dev, offset, task_data);
+    RmMDSTask *task = rm_mds_task_new(device->mds, dev, offset, task_data);
+    rm_mds_push_task_impl(device, task);
+}
+
+void rm_mds_push_task_prio(RmMDSDevice *device, dev_t dev, gint64 offset,
+                           gdouble priority, const gpointer task_data) {
+    RmMDSTask *task = rm_mds_task_new(device->mds, dev, offset, task_data);
+    task->priority = priority;
     rm_mds_push_task_impl(device, task);
 }
 
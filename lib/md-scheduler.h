@@ -92,6 +92,10 @@ typedef struct RmMDSTask {
     dev_t dev;
     guint64 offset;
     gpointer task_data;
+
+    /* for the prioritiser; fixed when the task is pushed (refer
+     * rm_mds_push_task_prio()) */
+    gdouble priority;
 } RmMDSTask;
 
 /**
@@ -109,6 +113,21 @@ typedef struct RmMDSTask {
  **/
 typedef gint (*RmMDSFunc)(RmMDSTask *task, gpointer session_user_data);
 
+/**
+ * @brief RmMDSBatchFunc function prototype, called for several tasks at once
+ *
+ * @param task_data Array of user data passed via rm_mds_push_...(), in
+ * prioritised order
+ * @param n_tasks Number of entries in task_data
+ * @param session_user_data User data passed to rm_mds_configure()
+ * @retval amount to decrement device worker's per-pass quota
+ *
+ * Useful where tasks are cheap individually but benefit from submitting
+ * their IO together.
+ **/
+typedef gint (*RmMDSBatchFunc)(gpointer *task_data, guint n_tasks,
+                               gpointer session_user_data);
+
 /**
  * @brief RmMDSTask task prioritisation function prototype
  *
@@ -152,6 +171,16 @@ void rm_mds_configure(RmMDS *self,
                       const gint threads_per_disk,
                       RmMDSSortFunc prioritiser);
 
+/**
+ * @brief Process tasks in batches rather than one by one.
+ *
+ * Must be called after rm_mds_configure(), which resets batching.
+ *
+ * @param func The callback function called for each batch of tasks
+ * @param batch_size Maximum number of tasks per batch
+ **/
+void rm_mds_configure_batch(RmMDS *self, const RmMDSBatchFunc func, const guint batch_size);
+
 /**
  * @brief start a paused MDS scheduler
  **/
@@ -186,6 +215,28 @@ RmMDSDevice *rm_mds_device_get(RmMDS *mds, const char *path, dev_t dev);
  * */
 gboolean rm_mds_device_is_rotational(RmMDSDevice *device);
 
+/**
+ * @brief feed a completed read into the device's throughput model
+ *
+ * The model fits the seek time and sequential bandwidth of the device to the
+ * reads done so far, weighting recent reads higher.
+ *
+ * @param device Pointer to the RmMDSDevice (may be NULL)
+ * @param bytes Number of bytes read
+ * @param usec Time taken by the read, including open(2) if any
+ * @param seeked FALSE if the read continued where the previous one stopped
+ **/
+void rm_mds_device_record_read(RmMDSDevice *device, guint64 bytes, gint64 usec,
+                               gboolean seeked);
+
+/**
+ * @brief how many bytes the device can read sequentially in the time of one seek
+ *
+ * @retval the measured seek time times the measured bandwidth (at least 1), or
+ * 0 if rm_mds_device_record_read() did not collect enough reads yet
+ **/
+RmOff rm_mds_device_seek_bytes(RmMDSDevice *device);
+
 /**
  * @brief increase or decrease MDS reference count for an RmMDSDevice
  *
@@ -212,6 +263,19 @@ void rm_mds_push_task(RmMDSDevice *device,
                       const char *path,
                       const gpointer task_data);
 
+/**
+ * @brief Like rm_mds_push_task(), but also sets the task's priority.
+ *
+ * The prioritiser runs with the device queue locked, so it should not look
+ * at state that other threads change.  Instead the caller can work out a
+ * priority when pushing, under whatever lock that state needs.
+ **/
+void rm_mds_push_task_prio(RmMDSDevice *device,
+                           dev_t dev,
+                           gint64 offset,
+                           gdouble priority,
+                           const gpointer task_data);
+
 /**
  * @brief prioritiser function for basic elevator algorithm
  **/
@@ -291,7 +291,7 @@ static RmFile *rm_parrot_try_next(RmParrot *polly) {
             file->actual_file_size = json_object_get_int_member(object, "size");
         }
 
-        file->n_children = (size_t)json_object_get_int_member(object, "n_children");
+        file->n_children = (guint32)json_object_get_int_member(object, "n_children");
     }
 
     // If the file is a symbolic link and we remove it,
@@ -98,6 +98,7 @@ void rm_session_init(RmSession *session, RmCfg *cfg) {
     session->timer = g_timer_new();
 
     session->cfg = cfg;
+    rm_arena_init(&session->file_arena, sizeof(RmFile));
     session->tables = rm_file_tables_new(session);
     session->formats = rm_fmt_open(session);
     session->pattern_cache = g_ptr_array_new_full(0, (GDestroyNotify)g_regex_unref);
@@ -142,8 +143,17 @@ void rm_session_clear(RmSession *session) {
     g_free(cfg->joined_argv);
     g_free(cfg->full_argv0_path);
     g_free(cfg->iwd);
+    g_free(cfg->paranoid_spill_dir);
 
     rm_trie_destroy(&cfg->file_trie);
+
+    RmArenaStats arena_stats;
+    rm_arena_stats(&session->file_arena, &arena_stats);
+    rm_log_debug_line("Files: %" LLU " allocated from %" LLU " arena slabs (%" LLU
+                      " bytes)%s",
+                      arena_stats.n_blocks, arena_stats.n_slabs, arena_stats.slab_bytes,
+                      session->fast_exit ? "; released in one go" : "");
+    rm_arena_clear(&session->file_arena);
 }
 
 volatile int rm_session_abort_count = 0;
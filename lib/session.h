@@ -31,6 +31,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "arena.h"      // RmArena
 #include "config.h"     // INLINE
 #include "treemerge.h"  // RmTreeMerger
 
@@ -80,6 +81,9 @@ typedef struct RmSession {
     /* Cache of already compiled GRegex patterns */
     GPtrArray *pattern_cache;
 
+    /* All RmFiles of the session come from here (refer rm_file_new()) */
+    RmArena file_arena;
+
     /* Counters for printing useful statistics */
     volatile gint total_files;
     volatile gint ignored_files;
@@ -100,6 +104,13 @@ typedef struct RmSession {
     RmOff original_bytes;
     RmOff shred_bytes_read;
 
+    /* bytes read with O_DIRECT / read into the page cache and left there */
+    RmOff shred_bytes_read_direct;
+    RmOff shred_bytes_read_cached;
+
+    /* seconds spent in the shredder */
+    gdouble shred_elapsed;
+
     GTimer *timer_since_proc_start;
 
     /* flag indicating if rmlint was aborted early */
@@ -134,6 +145,10 @@ typedef struct RmSession {
     /* true once traverse finished running */
     bool traverse_finished;
 
+    /* true once all output is written; rm_session_clear() then releases
+     * file_arena as a whole instead of destroying each RmFile */
+    bool fast_exit;
+
     /*  When run with --equal this holds the exit code for rmlint
      *  (the exit code is determined by the _equal formatter) */
     int equal_exit_code;
@@ -28,9 +28,12 @@
 #include <string.h>
 #include <unistd.h>
 
+#include <sys/statvfs.h>
 #include <sys/uio.h>
 
+#include "arena.h"
 #include "checksum.h"
+#include "fd-cache.h"
 #include "hasher.h"
 
 #include "formats.h"
@@ -55,6 +58,11 @@
  * Generation 3: Same size and same hash of first ~150MB
  * ... and so on until the end of the file is reached.
  *
+ * With --sample-pages, large files get an extra generation between 0 and 1:
+ * Same size and same hash of N pages spread evenly over the file (refer
+ * rm_shred_sample()).  This splits groups of e.g. disk images that share a
+ * long header before a single byte of the interior would otherwise be read.
+ *
  * The default step size can be configured below.
  *
  *
@@ -245,7 +253,8 @@
  * to catch up.  Two strategies are used to speed this up:
  *
  * (a) Pre-matching of candidate digests.  During reading/hashing, as each
- * buffer (4096 bytes) is read in, it can be checked against a "twin candidate".
+ * buffer (4096 bytes) is read in, it can be checked against "twin candidates"
+ * (up to RM_PARANOID_MAX_CANDIDATES of them in one pass over the buffer).
  * We can send twin candidates to the hash pipe at any time via
  * rm_digest_send_match_candidate().  If the correct twin candidate has been
  * sent, then when the increment is finished the matching has already been done,
@@ -255,6 +264,12 @@
  * hashtable lookup to quickly identify potential matches.  This saves time in
  * the case of RmShredGroups with large number of child groups and where the
  * pre-matching strategy failed.
+ *
+ * With --paranoid-spill-dir the buffers are moved to a mmap()ed scratch file as
+ * they arrive, so that only their RmBuffer structs stay on the heap.  The
+ * memory manager then hands out bytes of scratch file instead of bytes of
+ * memory (see rm_shred_spill_budget()), which lets far more groups be active
+ * at once.
  * */
 
 /*
@@ -268,9 +283,26 @@
 // TO COMPARE PROGRESSIVE HASHES          //
 ////////////////////////////////////////////
 
+/* The read sizes below scale with the device's "seek bytes", the number of
+ * bytes it can read sequentially in the time of one seek.  The md-scheduler
+ * measures these from the increments read so far (refer
+ * rm_mds_device_record_read()); until it has enough reads the fixed defaults
+ * are used, which were tuned for a rotational disk with ~1 MiB seek bytes. */
+
 /* how many pages can we read in (seek_time)/(CHEAP)? (use for initial read) */
 #define SHRED_BALANCED_PAGES (4)
 
+/* (seek_time)/(CHEAP) for measured devices */
+#define SHRED_BALANCED_SEEK_FRACTION (64)
+
+/* Max. increment, in seek bytes, for measured devices */
+#define SHRED_MAX_READ_SEEKS (256)
+
+/* Bounds of the max. increment for measured devices; the upper one because
+ * rm_shred_get_read_size() returns a gint32 */
+#define SHRED_MIN_MAX_READ_BYTES (16 * 1024 * 1024)
+#define SHRED_MAX_READ_BYTES (1024 * 1024 * 1024)
+
 /* How large a single page is (typically 4096 bytes but not always)*/
 #define SHRED_PAGE_SIZE (sysconf(_SC_PAGESIZE))
 
@@ -291,17 +323,75 @@
  * */
 #define SHRED_PREMATCH_THRESHOLD (0)
 
-/* empirical estimate of mem usage per file (excluding read buffers and
- * paranoid digests) */
-#define SHRED_AVERAGE_MEM_PER_FILE (100)
+/* Max number of files to open and read together when their first
+ * increment is due (refer rm_shred_process_batch) */
+#define SHRED_BATCH_FILES (32)
+
+/* estimate of mem usage per file (excluding read buffers and paranoid
+ * digests): the RmFile, its node in the path trie and the node's basename and
+ * slot in its parent's table of children */
+#define SHRED_AVERAGE_MEM_PER_FILE (sizeof(RmFile) + sizeof(RmNode) + 64)
 
 /* Maximum number of bytes before worth_waiting becomes false */
 #define SHRED_TOO_MANY_BYTES_TO_WAIT (64 * 1024 * 1024)
 
+/* Same for measured devices, in seek bytes */
+#define SHRED_WAIT_MAX_SEEKS (64)
+
+/* Waiting for the hash result only saves seeks; below this many seek bytes
+ * the device seeks too cheaply to make it worth idling the reader */
+#define SHRED_WAIT_MIN_SEEK_BYTES (512 * 1024)
+
+/* Upper limit for --sample-pages */
+#define SHRED_MAX_SAMPLES (256)
+
+/* Only sample files with at least this many bytes per sample; smaller files
+ * get read in order sooner than the seeks between samples would pay off */
+#define SHRED_SAMPLE_MIN_BYTES (1024 * 1024)
+
+/* Digest for the sampled pages; it only serves to split groups, so a fast
+ * non-cryptographic hash does */
+#define SHRED_SAMPLE_DIGEST (RM_DIGEST_XXH3_128)
+
+/* Max. percentage of the free space in --paranoid-spill-dir to use */
+#define SHRED_SPILL_DISK_PERCENT (75)
+
+/* How many bytes of each file --verify compares at once */
+#define SHRED_VERIFY_BLOCK_SIZE (1024 * 1024)
+
+/* Max number of files that --verify compares against the original at once */
+#define SHRED_VERIFY_FILES (32)
+
+/* Number of progress counter slabs which threads share round-robin */
+#define SHRED_COUNTER_SLABS (32)
+
+/* How often (in microseconds) the counter slabs get summed up for the
+ * progress formatters */
+#define SHRED_PROGRESS_INTERVAL (25 * 1000)
+
+/* Max number of threads that post-process finished groups */
+#define SHRED_MAX_RESULT_THREADS (8)
+
+/* Number of independently locked tables that hold the children of a
+ * RmShredGroup, so that threads sifting files out of a big group don't
+ * queue on a single lock */
+#define SHRED_CHILD_SHARDS (16)
+
 ///////////////////////////////////////////////////////////////////////
 //    INTERNAL STRUCTURES, WITH THEIR INITIALISERS AND DESTROYERS    //
 ///////////////////////////////////////////////////////////////////////
 
+/* Changes to the session's progress counters made by the threads using a
+ * slab; only modified by relaxed atomic adds and summed up by
+ * rm_shred_update_progress(). Aligned so that slabs don't share a cache line.
+ */
+typedef struct RmShredCounters {
+    gint64 files;
+    gint64 bytes;
+    gint64 filtered_files;
+    gint64 bytes_read;
+} __attribute__((aligned(64))) RmShredCounters;
+
 /////////* The main extra data for the duplicate finder *///////////
 
 typedef struct RmShredTag {
@@ -310,18 +400,62 @@ typedef struct RmShredTag {
     gint64 paranoid_mem_alloc; /* how much memory to allocate for paranoid checks */
     gint32 active_groups; /* how many shred groups active (only used with paranoid) */
     RmHasher *hasher;
+    /* open fds of files which are partially hashed; NULL if not used */
+    RmFdCache *fd_cache;
+    /* files of at least this size are mmap()ed by the hasher; 0 if none */
+    RmOff mmap_threshold;
+    /* all RmShredGroups of this run come from here */
+    RmArena group_arena;
+    /* threadpool for post-processing finished groups (refer
+     * rm_shred_result_factory) */
     GThreadPool *result_pool;
-    /* threadpool for progress counters to avoid blocking delays in
-     * rm_shred_adjust_counters */
-    GThreadPool *counter_pool;
+    /* single thread which outputs the post-processed groups in the order
+     * they were finished (refer rm_shred_output_factory) */
+    GThreadPool *output_pool;
+    /* progress counters; refer rm_shred_adjust_counters() */
+    RmShredCounters counters[SHRED_COUNTER_SLABS];
+
+    /* session counters before the shredder started */
+    RmShredCounters counter_base;
+
+    /* thread which periodically sums up the counters for the progress
+     * formatters until progress_done is set */
+    GThread *progress_thread;
+    GMutex progress_lock;
+    GCond progress_cond;
+    bool progress_done;
+
     gint32 page_size;
     bool mem_refusing;
 
+    /* set by rm_shred_update_progress() once --time-budget or --read-budget
+     * is used up; atomic */
+    gint over_budget;
+
+    /* protects the fields below up to (not including) the output_pool ones */
     GMutex lock;
 
     gint32 remaining_files;
     gint64 remaining_bytes;
 
+    /* bytes read by --verify */
+    gint64 verified_bytes;
+
+    /* files left unfinished since the budget ran out */
+    gint64 parked_files;
+
+    /* sequence number of the next group pushed to result_pool */
+    guint result_seq;
+
+    /* longest queues seen in front of result_pool and output_pool */
+    guint max_result_queue;
+    guint max_output_queue;
+
+    /* only used by output_pool: sequence number of the next group to output
+     * and results which overtook it, by sequence number */
+    guint output_seq;
+    GHashTable *early_results;
+
     bool after_preprocess : 1;
 
 } RmShredTag;
@@ -333,6 +467,27 @@ typedef struct RmShredTag {
 #define NEEDS_NEW(group) \
     (group->session->cfg->min_mtime)
 
+/* A finished RmShredGroup on its way through result_pool and output_pool */
+typedef struct RmShredResult {
+    /* order in which the group was finished */
+    guint seq;
+
+    /* the finished group */
+    struct RmShredGroup *group;
+
+    /* groups to output, set by rm_shred_result_factory(); may hold several
+     * groups if post-processing split the group */
+    GQueue groups;
+} RmShredResult;
+
+/* One of the SHRED_CHILD_SHARDS tables of children of a RmShredGroup */
+typedef struct RmShredShard {
+    GMutex lock;
+
+    /* digest -> child RmShredGroup; created on first use */
+    GHashTable *table;
+} RmShredShard;
+
 
 typedef struct RmShredGroup {
     /* holding queue for files; they are held here until the group first meets
@@ -342,8 +497,12 @@ typedef struct RmShredGroup {
     GQueue *held_files;
 
     /* link(s) to next generation of RmShredGroups(s) which have this RmShredGroup as
-     * parent*/
-    GHashTable *children;
+     * parent, spread over SHRED_CHILD_SHARDS shards by digest hash; allocated
+     * once by the first sifted file (refer rm_shred_group_find_child()) */
+    RmShredShard *children;
+
+    /* number of children; atomic */
+    gint n_children;
 
     /* RmShredGroup of the same size files but with lower RmFile->hash_offset;
      * getsset to null when parent dies
@@ -378,6 +537,18 @@ typedef struct RmShredGroup {
     /* set if group has been greenlighted by paranoid mem manager */
     bool is_active : 1;
 
+    /* set if digest is a sparse fingerprint (refer rm_shred_sample()) rather
+     * than a hash of the files up to hash_offset */
+    bool is_sampled : 1;
+
+    /* set if files were parked in held_files because the read budget ran
+     * out (refer rm_shred_park_file()); the group is then output as unfinished */
+    bool is_unfinished : 1;
+
+    /* number of pages to sample for the next generation; 0 if the next
+     * generation reads the files in order */
+    guint n_samples;
+
     /* if whole group has same basename, pointer to first file, else null */
     RmFile *unique_basename;
 
@@ -397,7 +568,7 @@ typedef struct RmShredGroup {
     /* file hash_offset for next increment */
     RmOff next_offset;
 
-    /* Factor of SHRED_BALANCED_PAGES to read next time */
+    /* Factor of rm_shred_balanced_bytes() to read next time */
     gint64 offset_factor;
 
     /* allocated memory for paranoid hashing */
@@ -422,6 +593,18 @@ typedef struct RmSignal {
     gboolean done;
 } RmSignal;
 
+/* One page read by rm_shred_sample() */
+typedef struct RmShredSample {
+    /* logical offset in file */
+    RmOff offset;
+
+    /* physical offset on disk; 0 if unknown */
+    RmOff physical;
+
+    /* where the page goes */
+    unsigned char *buf;
+} RmShredSample;
+
 static RmSignal *rm_signal_new(void) {
     RmSignal *self = g_slice_new(RmSignal);
     g_mutex_init(&self->lock);
@@ -456,7 +639,7 @@ static void rm_signal_done(RmSignal *signal) {
 
 /* allocate and initialise new RmShredGroup; uses file's digest type if available */
 static RmShredGroup *rm_shred_group_new(RmFile *file) {
-    RmShredGroup *self = g_slice_new0(RmShredGroup);
+    RmShredGroup *self = rm_arena_alloc0(&file->session->shredder->group_arena);
 
     if(file->digest) {
         self->digest_type = file->digest->type;
@@ -467,7 +650,12 @@ static RmShredGroup *rm_shred_group_new(RmFile *file) {
     self->parent = file->shred_group;
     self->session = file->session;
 
-    if(self->parent) {
+    if(self->parent && self->parent->n_samples > 0) {
+        /* sampling did not advance hash_offset; start over with the small reads */
+        self->is_sampled = TRUE;
+        self->digest_type = self->parent->digest_type;
+        self->offset_factor = self->parent->offset_factor;
+    } else if(self->parent) {
         self->offset_factor = MIN(self->parent->offset_factor * 8, SHRED_MAX_READ_FACTOR);
     } else {
         self->offset_factor = 1;
@@ -489,6 +677,38 @@ static RmShredGroup *rm_shred_group_new(RmFile *file) {
 // MANAGEMENT ALGORITHMS        //
 //////////////////////////////////
 
+/* Smallest increment that is cost-effective to read from file's device */
+static RmOff rm_shred_balanced_bytes(RmFile *file, RmShredTag *tag) {
+    RmOff seek_bytes = rm_mds_device_seek_bytes(file->disk);
+    if(seek_bytes == 0) {
+        return tag->page_size * SHRED_BALANCED_PAGES;
+    }
+    return MAX(seek_bytes / SHRED_BALANCED_SEEK_FRACTION, (RmOff)tag->page_size);
+}
+
+/* Largest increment worth reading from file's device before comparing hashes */
+static RmOff rm_shred_max_read_bytes(RmFile *file) {
+    RmOff seek_bytes = rm_mds_device_seek_bytes(file->disk);
+    if(seek_bytes == 0) {
+        /* offset_factor is capped by SHRED_MAX_READ_FACTOR instead */
+        return SHRED_MAX_READ_BYTES;
+    }
+    return CLAMP(seek_bytes * SHRED_MAX_READ_SEEKS, (RmOff)SHRED_MIN_MAX_READ_BYTES,
+                 (RmOff)SHRED_MAX_READ_BYTES);
+}
+
+/* Check if a worker should wait for the hash of a bytes_to_read increment
+ * rather than seek elsewhere in the meantime */
+static gboolean rm_shred_worth_waiting(RmFile *file, RmOff bytes_to_read) {
+    RmOff seek_bytes = rm_mds_device_seek_bytes(file->disk);
+    if(seek_bytes == 0) {
+        return rm_mds_device_is_rotational(file->disk) &&
+               bytes_to_read < SHRED_TOO_MANY_BYTES_TO_WAIT;
+    }
+    return seek_bytes >= SHRED_WAIT_MIN_SEEK_BYTES &&
+           bytes_to_read < seek_bytes * SHRED_WAIT_MAX_SEEKS;
+}
+
 /* Compute optimal size for next hash increment call this with group locked */
 static gint32 rm_shred_get_read_size(RmFile *file, RmShredTag *tag) {
     g_assert(file);
@@ -499,8 +719,9 @@ static gint32 rm_shred_get_read_size(RmFile *file, RmShredTag *tag) {
 
     /* calculate next_offset property of the RmShredGroup */
     g_assert(tag);
-    RmOff balanced_bytes = tag->page_size * SHRED_BALANCED_PAGES;
-    RmOff target_bytes = balanced_bytes * group->offset_factor;
+    RmOff balanced_bytes = rm_shred_balanced_bytes(file, tag);
+    RmOff target_bytes =
+        MIN(balanced_bytes * group->offset_factor, rm_shred_max_read_bytes(file));
     if(group->next_offset == 2) {
         file->fadvise_requested = 1;
     }
@@ -561,6 +782,22 @@ static void rm_shred_mem_return(RmShredGroup *group) {
     }
 }
 
+/* How many bytes of paranoid data may be held when spilling to a scratch file;
+ * mem_avail bounds the heap used for the RmBuffer structs that stay behind */
+static gint64 rm_shred_spill_budget(RmCfg *cfg, gint64 mem_avail) {
+    gint64 per_buffer = sizeof(RmBuffer) + sizeof(GSList);
+    gint64 budget = mem_avail / per_buffer * (gint64)cfg->read_buf_len;
+
+    struct statvfs fs_stat;
+    if(statvfs(cfg->paranoid_spill_dir, &fs_stat) == 0) {
+        gint64 disk_avail = (gint64)fs_stat.f_bavail * (gint64)fs_stat.f_frsize;
+        budget = MIN(budget, disk_avail / 100 * SHRED_SPILL_DISK_PERCENT);
+    }
+
+    /* once the scratch file is full buffers stay in memory again */
+    return MAX(budget, mem_avail);
+}
+
 /* what is the maximum number of files that a group may end up with (including
  * parent, grandparent etc group files that haven't been hashed yet)?
  */
@@ -647,41 +884,122 @@ static bool rm_shred_check_paranoid_mem_alloc(RmShredGroup *group,
 //       Progress Reporting      //
 ///////////////////////////////////
 
-typedef struct RmCounterBuffer {
-    int files;
-    gint64 bytes;
-} RmCounterBuffer;
+/* slab number + 1 of the calling thread; 0 if it has none yet */
+static GPrivate rm_shred_counter_slab = G_PRIVATE_INIT(NULL);
+static gint rm_shred_counter_threads = 0;
 
-static RmCounterBuffer *rm_counter_buffer_new(int files, gint64 bytes) {
-    RmCounterBuffer *self = g_slice_new(RmCounterBuffer);
-    self->files = files;
-    self->bytes = bytes;
-    return self;
+static RmShredCounters *rm_shred_counters(RmShredTag *tag) {
+    guint slab = GPOINTER_TO_UINT(g_private_get(&rm_shred_counter_slab));
+    if(slab == 0) {
+        slab = g_atomic_int_add(&rm_shred_counter_threads, 1) % SHRED_COUNTER_SLABS + 1;
+        g_private_set(&rm_shred_counter_slab, GUINT_TO_POINTER(slab));
+    }
+    return &tag->counters[slab - 1];
 }
 
-static void rm_shred_adjust_counters(RmShredTag *tag, int files, gint64 bytes) {
-    g_thread_pool_push(tag->counter_pool, rm_counter_buffer_new(files, bytes), NULL);
+#define RM_SHRED_COUNTER_ADD(counter, value) \
+    __atomic_fetch_add(&(counter), (value), __ATOMIC_RELAXED)
+
+/* Sum up the counter slabs into the session's progress counters and tell
+ * the formatters */
+static void rm_shred_update_progress(RmShredTag *tag) {
+    RmShredCounters sum = tag->counter_base;
+    for(int i = 0; i < SHRED_COUNTER_SLABS; i++) {
+        RmShredCounters *slab = &tag->counters[i];
+        sum.files += __atomic_load_n(&slab->files, __ATOMIC_RELAXED);
+        sum.bytes += __atomic_load_n(&slab->bytes, __ATOMIC_RELAXED);
+        sum.filtered_files += __atomic_load_n(&slab->filtered_files, __ATOMIC_RELAXED);
+        sum.bytes_read += __atomic_load_n(&slab->bytes_read, __ATOMIC_RELAXED);
+    }
+
+    RmSession *session = tag->session;
+    g_mutex_lock(&tag->progress_lock);
+    {
+        session->shred_files_remaining = sum.files;
+        session->shred_bytes_remaining = sum.bytes;
+        session->total_filtered_files = sum.filtered_files;
+        session->shred_bytes_read = sum.bytes_read;
+        rm_fmt_set_state(session->formats, (tag->after_preprocess)
+                                               ? RM_PROGRESS_STATE_SHREDDER
+                                               : RM_PROGRESS_STATE_PREPROCESS);
+
+        RmCfg *cfg = session->cfg;
+        if(!g_atomic_int_get(&tag->over_budget) &&
+           ((cfg->time_budget > 0 &&
+             g_timer_elapsed(session->timer_since_proc_start, NULL) >= cfg->time_budget) ||
+            (cfg->read_budget > 0 && session->shred_bytes_read >= cfg->read_budget))) {
+            rm_log_info_line(_("Budget used up; finishing the files being read"));
+            g_atomic_int_set(&tag->over_budget, 1);
+        }
+
+        /* fake interrupt option for debugging/testing: */
+        if(tag->after_preprocess && session->cfg->fake_abort &&
+           session->shred_bytes_remaining * 10 < session->shred_bytes_total * 9) {
+            rm_session_abort();
+            /* prevent multiple aborts */
+            session->shred_bytes_total = 0;
+        }
+    }
+    g_mutex_unlock(&tag->progress_lock);
+}
+
+static gpointer rm_shred_progress_thread(RmShredTag *tag) {
+    g_mutex_lock(&tag->progress_lock);
+    while(!tag->progress_done) {
+        g_cond_wait_until(&tag->progress_cond, &tag->progress_lock,
+                          g_get_monotonic_time() + SHRED_PROGRESS_INTERVAL);
+        g_mutex_unlock(&tag->progress_lock);
+        rm_shred_update_progress(tag);
+        g_mutex_lock(&tag->progress_lock);
+    }
+    g_mutex_unlock(&tag->progress_lock);
+    return NULL;
 }
 
-static void rm_shred_counter_factory(RmCounterBuffer *buffer, RmShredTag *tag) {
+static void rm_shred_start_progress(RmShredTag *tag) {
     RmSession *session = tag->session;
-    session->shred_files_remaining += buffer->files;
-    if(buffer->files < 0) {
-        session->total_filtered_files += buffer->files;
+    tag->counter_base.files = session->shred_files_remaining;
+    tag->counter_base.bytes = session->shred_bytes_remaining;
+    tag->counter_base.filtered_files = session->total_filtered_files;
+    tag->counter_base.bytes_read = session->shred_bytes_read;
+
+    g_mutex_init(&tag->progress_lock);
+    g_cond_init(&tag->progress_cond);
+    tag->progress_thread =
+        g_thread_new("rm_shred_progress", (GThreadFunc)rm_shred_progress_thread, tag);
+}
+
+/* stop the progress thread; the session's counters are final afterwards */
+static void rm_shred_stop_progress(RmShredTag *tag) {
+    g_mutex_lock(&tag->progress_lock);
+    {
+        tag->progress_done = true;
+        g_cond_signal(&tag->progress_cond);
     }
-    session->shred_bytes_remaining += buffer->bytes;
-    rm_fmt_set_state(session->formats, (tag->after_preprocess)
-                                           ? RM_PROGRESS_STATE_SHREDDER
-                                           : RM_PROGRESS_STATE_PREPROCESS);
+    g_mutex_unlock(&tag->progress_lock);
+    g_thread_join(tag->progress_thread);
+
+    rm_shred_update_progress(tag);
+    g_mutex_clear(&tag->progress_lock);
+    g_cond_clear(&tag->progress_cond);
+}
 
-    /* fake interrupt option for debugging/testing: */
-    if(tag->after_preprocess && session->cfg->fake_abort &&
-       session->shred_bytes_remaining * 10 < session->shred_bytes_total * 9) {
-        rm_session_abort();
-        /* prevent multiple aborts */
-        session->shred_bytes_total = 0;
+static void rm_shred_adjust_counters(RmShredTag *tag, int files, gint64 bytes) {
+    RmShredCounters *counters = rm_shred_counters(tag);
+    RM_SHRED_COUNTER_ADD(counters->files, files);
+    RM_SHRED_COUNTER_ADD(counters->bytes, bytes);
+    if(files < 0) {
+        RM_SHRED_COUNTER_ADD(counters->filtered_files, files);
+    }
+
+    if(tag->session->cfg->fake_abort) {
+        /* don't let the run finish between two progress updates */
+        rm_shred_update_progress(tag);
     }
-    g_slice_free(RmCounterBuffer, buffer);
+}
+
+static void rm_shred_count_read(RmShredTag *tag, gint64 bytes) {
+    RM_SHRED_COUNTER_ADD(rm_shred_counters(tag)->bytes_read, bytes);
 }
 
 static void rm_shred_write_group_to_xattr(const RmSession *session, GQueue *group) {
@@ -716,13 +1034,47 @@ static void rm_shred_discard_file(RmFile *file, bool free_file) {
         rm_shred_adjust_counters(tag, -1, -(gint64)(file->file_size - file->hash_offset));
     }
 
+    /* file won't be read again */
+    rm_fd_cache_forget(tag->fd_cache, file);
+
     if(free_file) {
         /* toss the file (and any embedded hardlinks)*/
         rm_file_destroy(file);
     }
 }
 
-/* Push file to scheduler queue.
+/* Rough value of reading file next: what its group may reclaim per byte that
+ * file still needs read.  Groups which are nearly confirmed, and large groups,
+ * come first, so that an interrupted run has found the bigger wins.
+ * Caller must hold file->shred_group's lock (if any); the result is kept as
+ * the scheduler task's priority. */
+static gdouble rm_shred_savings(const RmFile *file) {
+    const RmShredGroup *group = file->shred_group;
+    RmOff remaining = MAX(file->file_size - file->hash_offset, 1);
+    gsize num_files = group ? group->num_files : 1;
+    return (gdouble)num_files * file->file_size / remaining;
+}
+
+/* Savings-first prioritiser for the scheduler (refer rm_shred_savings()).
+ * Non-rotational devices are read in order of savings only; on rotational
+ * ones the files are grouped into tiers whose savings differ by a factor of
+ * two, and each tier is read in elevator order to keep seeks down. */
+static gint rm_shred_savings_cmp(const RmMDSTask *task_a, const RmMDSTask *task_b) {
+    const RmFile *file_a = task_a->task_data;
+    gdouble savings_a = task_a->priority;
+    gdouble savings_b = task_b->priority;
+
+    /* both tasks are queued on the same device */
+    if(file_a->disk && rm_mds_device_is_rotational(file_a->disk)) {
+        savings_a = g_bit_storage((gulong)savings_a);
+        savings_b = g_bit_storage((gulong)savings_b);
+    }
+
+    gint result = SIGN_DIFF(savings_b, savings_a);
+    return result ? result : rm_mds_elevator_cmp(task_a, task_b);
+}
+
+/* Push file to scheduler queue; caller must hold file->shred_group's lock.
  * */
 static void rm_shred_push_queue(RmFile *file) {
     if(file->hash_offset == 0) {
@@ -736,7 +1088,8 @@ static void rm_shred_push_queue(RmFile *file) {
             file->disk_offset = file->inode;
         }
     }
-    rm_mds_push_task(file->disk, file->dev, file->disk_offset, NULL, file);
+    rm_mds_push_task_prio(file->disk, file->dev, file->disk_offset,
+                          rm_shred_savings(file), file);
 }
 
 //////////////////////////////////
@@ -744,6 +1097,27 @@ static void rm_shred_push_queue(RmFile *file) {
 //    AND SIFTING ALGORITHM     //
 //////////////////////////////////
 
+/* Let go of the children of a finished group; they are orphaned and may be
+ * finalised right away */
+static void rm_shred_group_free_children(RmShredGroup *self) {
+    if(!self->children) {
+        return;
+    }
+
+    for(int i = 0; i < SHRED_CHILD_SHARDS; i++) {
+        RmShredShard *shard = &self->children[i];
+        if(shard->table) {
+            /* note: calls GDestroyNotify function rm_shred_group_make_orphan()
+             * for each RmShredGroup member of the shard: */
+            g_hash_table_unref(shard->table);
+        }
+        g_mutex_clear(&shard->lock);
+    }
+    g_free(self->children);
+    self->children = NULL;
+    self->n_children = 0;
+}
+
 /* Free RmShredGroup and any dormant files still in its queue
  */
 static void rm_shred_group_free(RmShredGroup *self, bool force_free) {
@@ -774,17 +1148,13 @@ static void rm_shred_group_free(RmShredGroup *self, bool force_free) {
         self->digest = NULL;
     }
 
-    if(self->children) {
-        /* note: calls GDestroyNotify function rm_shred_group_make_orphan()
-         * for each RmShredGroup member of self->children: */
-        g_hash_table_unref(self->children);
-    }
+    rm_shred_group_free_children(self);
 
     g_assert(!self->in_progress_digests);
 
     g_mutex_clear(&self->lock);
 
-    g_slice_free(RmShredGroup, self);
+    rm_arena_free(&self->session->shredder->group_arena, self);
 }
 
 static gboolean rm_shred_group_qualifies(RmShredGroup *group) {
@@ -796,8 +1166,26 @@ static gboolean rm_shred_group_qualifies(RmShredGroup *group) {
            /* we have at least one file from non-pref path, or we don't care */
            && (group->n_new > 0 || !NEEDS_NEW(group))
            /* we have at least one file newer than cfg->min_mtime, or we don't care */
-           && (!group->unique_basename || !group->session->cfg->unmatched_basenames);
-    /* we have more than one unique basename, or we don't care */
+           && (!group->unique_basename || !group->session->cfg->unmatched_basenames)
+           /* we have more than one unique basename, or we don't care */
+           && !group->is_unfinished;
+    /* the files were not read to the end */
+}
+
+/* Hand group over to the result_pool for post-processing and output */
+static void rm_shred_push_result(RmShredGroup *group) {
+    RmShredTag *tag = group->session->shredder;
+    RmShredResult *result = g_slice_new0(RmShredResult);
+    result->group = group;
+
+    g_mutex_lock(&tag->lock);
+    {
+        result->seq = tag->result_seq++;
+        rm_util_thread_pool_push(tag->result_pool, result);
+        tag->max_result_queue =
+            MAX(tag->max_result_queue, g_thread_pool_unprocessed(tag->result_pool));
+    }
+    g_mutex_unlock(&tag->lock);
 }
 
 /* call unlocked; should be no contention issues since group is finished */
@@ -809,16 +1197,33 @@ static void rm_shred_group_finalise(RmShredGroup *self) {
     case RM_SHRED_GROUP_DORMANT:
         /* Group didn't need hashing, either because it didn't meet criteria,
          * or possible because all files were pre-matched */
+        if(self->is_sampled) {
+            /* the fingerprint is no checksum of the files; don't output it */
+            rm_digest_free(self->digest);
+            self->digest = NULL;
+        }
         if(rm_shred_group_qualifies(self)) {
             /* upgrade status */
             self->status = RM_SHRED_GROUP_FINISHING;
         }
-        rm_util_thread_pool_push(self->session->shredder->result_pool, self);
+        rm_shred_push_result(self);
         break;
     case RM_SHRED_GROUP_START_HASHING:
     case RM_SHRED_GROUP_HASHING:
-        /* intermediate increment group no longer required; force free */
-        rm_shred_group_free(self, TRUE);
+        if(self->is_unfinished) {
+            /* output the parked files as unfinished; the children must not
+             * be orphaned by the output thread (refer rm_shred_run()) */
+            rm_shred_group_free_children(self);
+            if(self->is_sampled) {
+                rm_digest_free(self->digest);
+                self->digest = NULL;
+            }
+            self->status = RM_SHRED_GROUP_DORMANT;
+            rm_shred_push_result(self);
+        } else {
+            /* intermediate increment group no longer required; force free */
+            rm_shred_group_free(self, TRUE);
+        }
         break;
     case RM_SHRED_GROUP_FINISHING:
         /* free any paranoid buffers held in group->digest (should not be needed for
@@ -828,7 +1233,7 @@ static void rm_shred_group_finalise(RmShredGroup *self) {
         }
         /* send it to finisher (which takes responsibility for calling
          * rm_shred_group_free())*/
-        rm_util_thread_pool_push(self->session->shredder->result_pool, self);
+        rm_shred_push_result(self);
         break;
     case RM_SHRED_GROUP_FINISHED:
     default:
@@ -850,7 +1255,7 @@ static void rm_shred_group_update_status(RmShredGroup *group) {
     }
 }
 
-/* Only called by rm_shred_group_free (via GDestroyNotify of group->children).
+/* Only called by rm_shred_group_free (via GDestroyNotify of the children tables).
  * Call with group->lock unlocked.
  */
 static void rm_shred_group_make_orphan(RmShredGroup *self) {
@@ -951,6 +1356,73 @@ static RmFile *rm_shred_group_push_file(RmShredGroup *shred_group, RmFile *file,
     return result;
 }
 
+/* Find the child of group which file's digest matches, or create it.
+ * Only paranoid groups have in_progress_digests; they must be locked by the
+ * caller so that the list doesn't change underneath.
+ */
+static RmShredGroup *rm_shred_group_find_child(RmShredGroup *group, RmFile *file) {
+    if(g_once_init_enter(&group->children)) {
+        RmShredShard *shards = g_new0(RmShredShard, SHRED_CHILD_SHARDS);
+        for(int i = 0; i < SHRED_CHILD_SHARDS; i++) {
+            g_mutex_init(&shards[i].lock);
+        }
+        g_once_init_leave(&group->children, shards);
+    }
+
+    RmShredShard *shard =
+        &group->children[rm_digest_hash(file->digest) % SHRED_CHILD_SHARDS];
+
+    RmShredGroup *child = NULL;
+    g_mutex_lock(&shard->lock);
+    {
+        if(shard->table == NULL) {
+            shard->table =
+                g_hash_table_new_full((GHashFunc)rm_digest_hash,
+                                      (GEqualFunc)rm_digest_equal,
+                                      NULL,
+                                      (GDestroyNotify)rm_shred_group_make_orphan);
+        }
+
+        child = g_hash_table_lookup(shard->table, file->digest);
+        if(!child) {
+            child = rm_shred_group_new(file);
+            g_hash_table_insert(shard->table, child->digest, child);
+            g_atomic_int_inc(&group->n_children);
+
+            /* signal any pending (paranoid) digests that there is a new match
+             * candidate digest */
+            g_list_foreach(group->in_progress_digests,
+                           (GFunc)rm_digest_send_match_candidate, child->digest);
+        }
+    }
+    g_mutex_unlock(&shard->lock);
+
+    return child;
+}
+
+/* Call func(child, user_data) for each child of group; for paranoid groups
+ * call with group->lock held (refer rm_shred_group_find_child()) */
+static void rm_shred_group_foreach_child(RmShredGroup *group, GFunc func,
+                                         gpointer user_data) {
+    if(g_atomic_int_get(&group->n_children) == 0) {
+        return;
+    }
+
+    for(int i = 0; i < SHRED_CHILD_SHARDS; i++) {
+        RmShredShard *shard = &group->children[i];
+        g_mutex_lock(&shard->lock);
+        if(shard->table) {
+            GHashTableIter iter;
+            gpointer child = NULL;
+            g_hash_table_iter_init(&iter, shard->table);
+            while(g_hash_table_iter_next(&iter, NULL, &child)) {
+                func(child, user_data);
+            }
+        }
+        g_mutex_unlock(&shard->lock);
+    }
+}
+
 /* After partial hashing of RmFile, add it back into the sieve for further
  * hashing if required.  If waiting option is set, then try to return the
  * RmFile to the calling routine so it can continue with the next hashing
@@ -966,52 +1438,40 @@ static RmFile *rm_shred_sift(RmFile *file) {
     RmShredGroup *current_group = file->shred_group;
     g_assert(current_group);
 
-    g_mutex_lock(&current_group->lock);
-    {
-        current_group->num_pending--;
-        if(current_group->in_progress_digests) {
-            /* remove this file from current_group's pending digests list */
-            current_group->in_progress_digests =
-                g_list_remove(current_group->in_progress_digests, file->digest);
+    /* paranoid groups sift under the group lock so that in_progress_digests
+     * learn of every new child; other groups take it only for the counters
+     * below. Since file is still pending, current_group and its children
+     * stay alive meanwhile. */
+    gboolean locked = (current_group->digest_type == RM_DIGEST_PARANOID);
+    if(locked) {
+        g_mutex_lock(&current_group->lock);
+        /* remove this file from current_group's pending digests list */
+        current_group->in_progress_digests =
+            g_list_remove(current_group->in_progress_digests, file->digest);
+    }
+
+    if(file->status == RM_FILE_STATE_IGNORE) {
+        /* reading/hashing failed somewhere */
+        if(file->digest) {
+            rm_digest_free(file->digest);
         }
+        rm_shred_discard_file(file, true);
 
-        if(file->status == RM_FILE_STATE_IGNORE) {
-            /* reading/hashing failed somewhere */
-            if(file->digest) {
-                rm_digest_free(file->digest);
-            }
-            rm_shred_discard_file(file, true);
+    } else {
+        g_assert(file->digest);
 
-        } else {
-            g_assert(file->digest);
-
-            /* check is child group hashtable has been created yet */
-            if(current_group->children == NULL) {
-                current_group->children =
-                    g_hash_table_new_full((GHashFunc)rm_digest_hash,
-                                          (GEqualFunc)rm_digest_equal,
-                                          NULL,
-                                          (GDestroyNotify)rm_shred_group_make_orphan);
-            }
+        /* check if there is already a descendent of current_group which
+         * matches snap... if yes then move this file into it; if not then
+         * create a new group ... */
+        RmShredGroup *child_group = rm_shred_group_find_child(current_group, file);
+        result = rm_shred_group_push_file(child_group, file, FALSE);
+    }
 
-            /* check if there is already a descendent of current_group which
-             * matches snap... if yes then move this file into it; if not then
-             * create a new group ... */
-            RmShredGroup *child_group =
-                g_hash_table_lookup(current_group->children, file->digest);
-            if(!child_group) {
-                child_group = rm_shred_group_new(file);
-                g_hash_table_insert(current_group->children, child_group->digest,
-                                    child_group);
-
-                /* signal any pending (paranoid) digests that there is a new match
-                 * candidate digest */
-                g_list_foreach(current_group->in_progress_digests,
-                               (GFunc)rm_digest_send_match_candidate,
-                               child_group->digest);
-            }
-            result = rm_shred_group_push_file(child_group, file, FALSE);
-        }
+    if(!locked) {
+        g_mutex_lock(&current_group->lock);
+    }
+    {
+        current_group->num_pending--;
 
         /* is current shred group needed any longer? */
         current_group_finished =
@@ -1026,6 +1486,38 @@ static RmFile *rm_shred_sift(RmFile *file) {
     return result;
 }
 
+/* Instead of reading its next increment, keep file in its current group and
+ * output it as unfinished (refer rm_shred_group_finalise()); used once the
+ * budget is used up.  Like rm_shred_sift(), this ends file's pending state. */
+static void rm_shred_park_file(RmFile *file, RmShredTag *tag) {
+    RmShredGroup *group = file->shred_group;
+    gboolean group_finished = FALSE;
+
+    file->shredder_waiting = FALSE;
+    rm_shred_discard_file(file, false);
+
+    g_mutex_lock(&tag->lock);
+    { tag->parked_files++; }
+    g_mutex_unlock(&tag->lock);
+
+    g_mutex_lock(&group->lock);
+    {
+        if(!group->held_files) {
+            group->held_files = g_queue_new();
+        }
+        g_queue_push_tail(group->held_files, file);
+        group->is_unfinished = TRUE;
+
+        group->num_pending--;
+        group_finished = !group->parent && group->num_pending == 0;
+    }
+    g_mutex_unlock(&group->lock);
+
+    if(group_finished) {
+        rm_shred_group_finalise(group);
+    }
+}
+
 /* Hasher callback when file increment hashing is completed. */
 static void rm_shred_hash_callback(
     _UNUSED RmHasher *hasher,
@@ -1039,6 +1531,12 @@ static void rm_shred_hash_callback(
     g_assert(file->digest == digest);
     g_assert(file->hash_offset == file->shred_group->next_offset);
 
+    if(digest->truncated) {
+        RM_DEFINE_PATH(file);
+        rm_log_warning_line(_("%s shrank while being read; ignoring it"), file_path);
+        file->status = RM_FILE_STATE_IGNORE;
+    }
+
     if(file->shredder_waiting) {
         /* MDS scheduler is waiting for result */
         rm_signal_done(file->signal);
@@ -1063,6 +1561,20 @@ static void rm_shred_hash_callback(
  *    files via rm_shred_device_preprocess.
  * */
 
+/* Number of pages to sample from a size group's files before they are read in
+ * order; file is the first of the group */
+static guint rm_shred_sample_count(RmCfg *cfg, RmFile *file) {
+    if(cfg->sample_pages < 2 || file->is_symlink) {
+        return 0;
+    }
+
+    guint n_samples = MIN(cfg->sample_pages, SHRED_MAX_SAMPLES);
+    if(file->file_size - file->hash_offset < (RmOff)n_samples * SHRED_SAMPLE_MIN_BYTES) {
+        return 0;
+    }
+    return n_samples;
+}
+
 /* Called for each file; find appropriate RmShredGroup (ie files with same size) and
  * push the file to it.
  * */
@@ -1084,6 +1596,7 @@ static void rm_shred_file_preprocess(RmFile *file, RmShredGroup **group) {
         /* create RmShredGroup using first file in size group as template*/
         *group = rm_shred_group_new(file);
         (*group)->digest_type = cfg->checksum_type;
+        (*group)->n_samples = rm_shred_sample_count(cfg, file);
     }
 
     RM_DEFINE_PATH(file);
@@ -1136,7 +1649,94 @@ static gint rm_shred_cmp_ext_cksum(RmFile *a, RmFile *b) {
     return strcmp(a->ext_cksum, b->ext_cksum);
 }
 
-static void rm_shred_process_group(GSList *files, _UNUSED RmShredTag *main) {
+/* move guest and anything already clustered with it into host's cluster */
+static void rm_shred_cluster_merge(RmFile *host, RmFile *guest) {
+    if(!guest->cluster) {
+        rm_file_cluster_add(host, guest);
+        return;
+    }
+
+    GQueue *cluster = guest->cluster;
+    for(guint n = cluster->length; n > 0; n--) {
+        RmFile *member = g_queue_peek_head(cluster);
+        rm_file_cluster_remove(member);
+        rm_file_cluster_add(host, member);
+    }
+}
+
+/* extent map of file if it is on a reflink capable filesystem, else NULL */
+static char *rm_shred_extent_map(RmFile *file, RmMountTable *mounts) {
+    if(file->is_symlink) {
+        return NULL;
+    }
+
+    RM_DEFINE_PATH(file);
+
+    /* also registers btrfs subvolumes that are not mountpoints */
+    rm_mounts_get_disk_id(mounts, file->dev, file_path);
+    if(!rm_mounts_can_reflink(mounts, file->dev, file->dev)) {
+        return NULL;
+    }
+
+    int fd = rm_sys_open(file_path, O_RDONLY);
+    if(fd == -1) {
+        return NULL;
+    }
+    char *map = rm_offset_get_extent_map(fd);
+    rm_sys_close(fd);
+    return map;
+}
+
+/* cluster files that share all their extents (eg after a dedupe run) like
+ * hardlinks, so that only one of them gets read; returns the files that
+ * were not clustered into another one */
+static GSList *rm_shred_cluster_reflinks(GSList *files, RmMountTable *mounts) {
+    /* extent map -> first file seen with it */
+    GHashTable *hosts = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+    for(GSList *prev = NULL, *iter = files, *next = NULL; iter; iter = next) {
+        next = iter->next;
+        RmFile *file = iter->data;
+
+        char *map = rm_shred_extent_map(file, mounts);
+        RmFile *host = map ? g_hash_table_lookup(hosts, map) : NULL;
+
+        if(!host) {
+            if(map) {
+                g_hash_table_insert(hosts, map, file);
+            }
+            prev = iter;
+            continue;
+        }
+
+        g_free(map);
+        if(!rm_mounts_can_reflink(mounts, host->dev, file->dev)) {
+            /* same physical offsets on another filesystem */
+            prev = iter;
+            continue;
+        }
+
+#if _RM_SHRED_DEBUG
+        RM_DEFINE_PATH(file);
+        RM_DEFINE_PATH(host);
+        rm_log_debug_line("reflink cluster %s <-- %s", host_path, file_path);
+#endif
+        rm_shred_cluster_merge(host, file);
+
+        /* delete iter from GSList */
+        g_slist_free1(iter);
+        if(prev) {
+            prev->next = next;
+        } else {
+            files = next;
+        }
+    }
+
+    g_hash_table_unref(hosts);
+    return files;
+}
+
+static void rm_shred_process_group(GSList *files, RmShredTag *main) {
     g_assert(files);
     g_assert(files->data);
 
@@ -1172,6 +1772,12 @@ static void rm_shred_process_group(GSList *files, _UNUSED RmShredTag *main) {
         }
     }
 
+    /* cluster reflinks; not needed if all files are matched by ext_cksum */
+    RmSession *session = main->session;
+    if(session->cfg->cluster_reflinks && session->mounts && !all_have_ext_cksums) {
+        files = rm_shred_cluster_reflinks(files, session->mounts);
+    }
+
     /* push files to shred group */
     RmShredGroup *group = NULL;
     RmFile *file = NULL;
@@ -1238,6 +1844,8 @@ int rm_shred_cmp_orig_criteria(RmFile *a, RmFile *b, RmSession *session) {
  */
 void rm_shred_group_find_original(RmSession *session, GQueue *files,
                                   RmShredGroupStatus status) {
+    RmOff unique_bytes = 0;
+
     /* iterate over group, identifying "tagged" originals */
     for(GList *iter = files->head; iter; iter = iter->next) {
         RmFile *file = iter->data;
@@ -1260,10 +1868,17 @@ void rm_shred_group_find_original(RmSession *session, GQueue *files,
             }
         } else {
             file->lint_type = RM_LINT_TYPE_UNIQUE_FILE;
-            session->unique_bytes += file->actual_file_size;
+            unique_bytes += file->actual_file_size;
         }
     }
 
+    if(unique_bytes > 0) {
+        /* several result threads may get here at once */
+        rm_fmt_lock_state(session->formats);
+        { session->unique_bytes += unique_bytes; }
+        rm_fmt_unlock_state(session->formats);
+    }
+
     /* sort the group (order probably changed since initial preprocessing sort) */
     g_queue_sort(files, (GCompareDataFunc)rm_shred_cmp_orig_criteria, session);
 
@@ -1310,8 +1925,7 @@ void rm_shred_forward_to_output(RmSession *session, GQueue *group) {
     }
 }
 
-/* only called by rm_shred_result_factory() which is single-thread threadpool
- * so no lock required for session->dup_counter or session->total_lint_size */
+/* called from the result threads; caller must hold rm_fmt_lock_state() */
 static void rm_shred_dupe_totals(RmFile *file, RmSession *session) {
     if(!file->is_original) {
         session->dup_counter++;
@@ -1436,16 +2050,163 @@ static void rm_shred_tag_hardlink_rejects(RmShredGroup *group, _UNUSED RmShredTa
     }
 }
 
+/* first byte of file that went into its checksum (see rm_file_new()) */
+static RmOff rm_shred_verify_start(RmCfg *cfg, RmFile *file) {
+    if(file->actual_file_size == 0) {
+        return 0;
+    } else if(cfg->use_absolute_start_offset) {
+        return cfg->skip_start_offset;
+    } else {
+        return cfg->skip_start_factor * file->actual_file_size;
+    }
+}
+
+static int rm_shred_open_rdonly(RmFile *file) {
+    RM_DEFINE_PATH(file);
+    int fd = rm_sys_open(file_path, O_RDONLY);
+    if(fd == -1) {
+        rm_log_info("open(2) failed for %s: %s\n", file_path, g_strerror(errno));
+    }
+    return fd;
+}
+
+static bool rm_shred_pread(int fd, unsigned char *buf, gsize len, RmOff offset) {
+    while(len > 0) {
+        gssize n = pread(fd, buf, len, offset);
+        if(n == -1 && errno == EINTR) {
+            continue;
+        }
+        if(n <= 0) {
+            return false;
+        }
+        buf += n;
+        len -= n;
+        offset += n;
+    }
+    return true;
+}
+
+/* --verify: compare the files of a finished group byte by byte with its highest
+ * ranked file, streaming through up to SHRED_VERIFY_FILES files at a time, and
+ * split off the ones which differ or can't be read.  The rejects get verified
+ * amongst themselves when they are post-processed in turn.
+ */
+static RmShredGroup *rm_shred_verify_rejects(RmShredGroup *group, RmShredTag *tag) {
+    RmCfg *cfg = tag->session->cfg;
+    if(!cfg->verify || group->status != RM_SHRED_GROUP_FINISHING ||
+       group->digest_type == RM_DIGEST_PARANOID) {
+        /* nothing to do, or compared byte by byte already */
+        return NULL;
+    }
+
+    RmFile *headfile = group->held_files->head->data;
+    if(headfile->is_symlink) {
+        /* the link targets were hashed, not the file contents */
+        return NULL;
+    }
+
+    RmOff head_start = rm_shred_verify_start(cfg, headfile);
+    RmOff len = headfile->file_size - head_start;
+    int head_fd = rm_shred_open_rdonly(headfile);
+
+    unsigned char *head_buf = g_malloc(SHRED_VERIFY_BLOCK_SIZE);
+    unsigned char *buf = g_malloc(SHRED_VERIFY_BLOCK_SIZE);
+    RmShredGroup *rejects = NULL;
+    gint64 verified_bytes = 0;
+
+    for(GList *iter = group->held_files->head->next; iter;) {
+        RmFile *files[SHRED_VERIFY_FILES];
+        RmOff starts[SHRED_VERIFY_FILES];
+        int fds[SHRED_VERIFY_FILES];
+        int n_files = 0;
+
+        for(; iter && n_files < SHRED_VERIFY_FILES; iter = iter->next) {
+            RmFile *file = iter->data;
+            if(file->dev == headfile->dev && file->inode == headfile->inode) {
+                /* hardlink of headfile */
+                continue;
+            }
+            files[n_files] = file;
+            starts[n_files] = rm_shred_verify_start(cfg, file);
+            fds[n_files] = -1;
+            if(head_fd != -1 && file->file_size - starts[n_files] == len) {
+                fds[n_files] = rm_shred_open_rdonly(file);
+            }
+            n_files++;
+        }
+
+        /* a closed fd marks a reject */
+        bool pending = true;
+        for(RmOff offset = 0; offset < len && pending && !rm_session_was_aborted();
+            offset += SHRED_VERIFY_BLOCK_SIZE) {
+            gsize block = MIN(len - offset, SHRED_VERIFY_BLOCK_SIZE);
+            bool head_ok = rm_shred_pread(head_fd, head_buf, block, head_start + offset);
+            verified_bytes += block;
+
+            pending = false;
+            for(int i = 0; i < n_files; i++) {
+                if(fds[i] == -1) {
+                    continue;
+                }
+
+                bool match =
+                    head_ok && rm_shred_pread(fds[i], buf, block, starts[i] + offset);
+                verified_bytes += block;
+
+                if(match && memcmp(head_buf, buf, block) != 0) {
+                    RmFile *file = files[i];
+                    RM_DEFINE_PATH(headfile);
+                    RM_DEFINE_PATH(file);
+                    rm_log_warning_line(_("%s and %s have the same checksum but differ"),
+                                        headfile_path, file_path);
+                    match = false;
+                }
+
+                if(match) {
+                    pending = true;
+                } else {
+                    close(fds[i]);
+                    fds[i] = -1;
+                }
+            }
+        }
+
+        for(int i = 0; i < n_files; i++) {
+            if(fds[i] != -1) {
+                close(fds[i]);
+                continue;
+            }
+            if(!rejects) {
+                rejects = rm_shred_create_rejects(group, files[i]);
+            }
+            rm_shred_group_transfer(files[i], group, rejects);
+        }
+    }
+
+    if(head_fd != -1) {
+        close(head_fd);
+    }
+    g_free(head_buf);
+    g_free(buf);
+
+    g_mutex_lock(&tag->lock);
+    tag->verified_bytes += verified_bytes;
+    g_mutex_unlock(&tag->lock);
+    return rejects;
+}
+
 /* post-process a group:
  * decide which file(s) are originals
+ * maybe split out files which differ after all (--verify option)
  * maybe split out mtime rejects (--mtime-window option)
  * maybe split out basename twins (--unmatched-basename option)
+ * and append the group(s) to output to out.
  */
-static void rm_shred_group_postprocess(RmShredGroup *group, RmShredTag *tag) {
+static void rm_shred_group_postprocess(RmShredGroup *group, RmShredTag *tag,
+                                       GQueue *out) {
     if(!group) {
         return;
     }
-    RmCfg *cfg = tag->session->cfg;
 
     g_assert(group->held_files);
 
@@ -1454,8 +2215,9 @@ static void rm_shred_group_postprocess(RmShredGroup *group, RmShredTag *tag) {
      * This is done here.
      * */
     rm_shred_group_find_original(tag->session, group->held_files, group->status);
-    rm_shred_group_postprocess(rm_shred_basename_rejects(group, tag), tag);
-    rm_shred_group_postprocess(rm_shred_mtime_rejects(group, tag), tag);
+    rm_shred_group_postprocess(rm_shred_verify_rejects(group, tag), tag, out);
+    rm_shred_group_postprocess(rm_shred_basename_rejects(group, tag), tag, out);
+    rm_shred_group_postprocess(rm_shred_mtime_rejects(group, tag), tag, out);
 
     /* re-check whether what is left of the group still meets all criteria */
     group->status = (rm_shred_group_qualifies(group)) ? RM_SHRED_GROUP_FINISHING
@@ -1478,37 +2240,72 @@ static void rm_shred_group_postprocess(RmShredGroup *group, RmShredTag *tag) {
         rm_fmt_unlock_state(tag->session->formats);
     }
 
-    gboolean treemerge = cfg->merge_directories && group->status == RM_SHRED_GROUP_FINISHING;
     for(GList *iter = group->held_files->head; iter; iter = iter->next) {
         /* link file to its (shared) digest */
         RmFile *file = iter->data;
         file->digest = group->digest;
+    }
 
-        /* Cache the files for merging them into directories */
-        if(treemerge) {
-            rm_tm_feed(tag->session->dir_merger, file);
-        }
+    /* before the output module gets the chance to free the files; unfinished
+     * checksums are shared by the whole group, so they would match later */
+    if(!group->is_unfinished) {
+        rm_shred_write_group_to_xattr(tag->session, group->held_files);
     }
 
-    if(!treemerge) {
+    g_queue_push_tail(out, group);
+}
+
+/* Output a post-processed group; only called by the output_pool thread */
+static void rm_shred_group_output(RmShredGroup *group, RmShredTag *tag) {
+    RmSession *session = tag->session;
+
+    if(session->cfg->merge_directories && group->status == RM_SHRED_GROUP_FINISHING) {
+        /* Cache the files for merging them into directories */
+        for(GList *iter = group->held_files->head; iter; iter = iter->next) {
+            rm_tm_feed(session->dir_merger, iter->data);
+        }
+    } else {
         /* Output them directly, do not merge them first. */
-        rm_shred_forward_to_output(tag->session, group->held_files);
+        rm_shred_forward_to_output(session, group->held_files);
     }
 
-    rm_shred_write_group_to_xattr(tag->session, group->held_files);
-
     if(group->status == RM_SHRED_GROUP_FINISHING) {
         group->status = RM_SHRED_GROUP_FINISHED;
     }
 #if _RM_SHRED_DEBUG
-    rm_log_debug_line("Free from rm_shred_group_postprocess");
+    rm_log_debug_line("Free from rm_shred_group_output");
 #endif
 
     /* Do not force free files here, output module might need do that itself. */
     rm_shred_group_free(group, false);
 }
 
-static void rm_shred_result_factory(RmShredGroup *group, RmShredTag *tag) {
+/* Output results in the order their groups were finished, holding back
+ * those which overtook an earlier one in result_pool */
+static void rm_shred_output_factory(RmShredResult *result, RmShredTag *tag) {
+    if(result->seq != tag->output_seq) {
+        g_hash_table_insert(tag->early_results, GUINT_TO_POINTER(result->seq), result);
+        return;
+    }
+
+    while(result) {
+        RmShredGroup *group = NULL;
+        while((group = g_queue_pop_head(&result->groups))) {
+            rm_shred_group_output(group, tag);
+        }
+        g_slice_free(RmShredResult, result);
+
+        tag->output_seq++;
+        result = g_hash_table_lookup(tag->early_results, GUINT_TO_POINTER(tag->output_seq));
+        if(result) {
+            g_hash_table_remove(tag->early_results, GUINT_TO_POINTER(tag->output_seq));
+        }
+    }
+}
+
+/* Post-process a finished group; runs in several threads at once */
+static void rm_shred_result_factory(RmShredResult *result, RmShredTag *tag) {
+    RmShredGroup *group = result->group;
 
     /* maybe create group's digest from external checksums */
     RmFile *headfile = group->held_files->head->data;
@@ -1550,18 +2347,33 @@ static void rm_shred_result_factory(RmShredGroup *group, RmShredTag *tag) {
         }
     }
 
-    rm_shred_group_postprocess(group, tag);
+    rm_shred_group_postprocess(group, tag, &result->groups);
+
+    g_mutex_lock(&tag->lock);
+    {
+        rm_util_thread_pool_push(tag->output_pool, result);
+        tag->max_output_queue =
+            MAX(tag->max_output_queue, g_thread_pool_unprocessed(tag->output_pool));
+    }
+    g_mutex_unlock(&tag->lock);
 }
 
 /////////////////////////////////
 //    ACTUAL IMPLEMENTATION    //
 /////////////////////////////////
 
+static void rm_shred_send_candidate(RmShredGroup *child, RmDigest *digest) {
+    rm_digest_send_match_candidate(digest, child->digest);
+}
+
 static bool rm_shred_reassign_checksum(RmShredTag *main, RmFile *file) {
     RmCfg *cfg = main->session->cfg;
     RmShredGroup *group = file->shred_group;
 
-    if(group->digest_type == RM_DIGEST_PARANOID) {
+    if(group->n_samples > 0) {
+        /* sparse fingerprint, even for paranoid groups */
+        file->digest = rm_digest_new(SHRED_SAMPLE_DIGEST, main->session->hash_seed);
+    } else if(group->digest_type == RM_DIGEST_PARANOID) {
         /* check if memory allocation is ok */
         if(!rm_shred_check_paranoid_mem_alloc(group, 0)) {
             return false;
@@ -1585,14 +2397,8 @@ static bool rm_shred_reassign_checksum(RmShredTag *main, RmFile *file) {
             /* send candidate twin(s) */
             g_mutex_lock(&group->lock);
             {
-                if(group->children) {
-                    GList *children = g_hash_table_get_values(group->children);
-                    while(children) {
-                        RmShredGroup *child = children->data;
-                        rm_digest_send_match_candidate(file->digest, child->digest);
-                        children = g_list_delete_link(children, children);
-                    }
-                }
+                rm_shred_group_foreach_child(group, (GFunc)rm_shred_send_candidate,
+                                             file->digest);
                 /* store a reference so the shred group knows where to send any future
                  * twin candidate digests */
                 group->in_progress_digests =
@@ -1600,17 +2406,73 @@ static bool rm_shred_reassign_checksum(RmShredTag *main, RmFile *file) {
             }
             g_mutex_unlock(&group->lock);
         }
-    } else if(group->digest) {
+    } else if(group->digest && !group->is_sampled) {
         /* pick up the digest-so-far from the RmShredGroup */
         file->digest = rm_digest_copy(group->digest);
     } else {
-        /* this is first generation of RMGroups, so there is no progressive hash yet */
+        /* this is the first increment, so there is no progressive hash yet */
         file->digest = rm_digest_new(cfg->checksum_type,
                                      main->session->hash_seed);
     }
     return true;
 }
 
+static int rm_shred_cmp_sample_physical(const void *a, const void *b) {
+    return SIGN_DIFF(((const RmShredSample *)a)->physical,
+                     ((const RmShredSample *)b)->physical);
+}
+
+/* Hash group->n_samples pages of file, from its start, its end and evenly spaced
+ * in between, into file->digest.  file->hash_offset does not move, since the
+ * following generations still need to read the whole file.  On rotational
+ * disks the pages are read in order of their physical offset, but they are
+ * always hashed in logical order, so that the fingerprint does not depend on
+ * where the file is stored. */
+static void rm_shred_sample(RmFile *file, RmShredTag *tag) {
+    guint n_samples = file->shred_group->n_samples;
+    RmOff page_size = tag->page_size;
+    RmOff start = file->hash_offset;
+    RmOff span = (file->file_size - start - page_size) / (n_samples - 1);
+
+    RmShredSample samples[n_samples];
+    unsigned char *data = g_malloc(n_samples * page_size);
+    for(guint i = 0; i < n_samples; ++i) {
+        samples[i].offset = start + i * span;
+        if(i > 0) {
+            /* page aligned, except for the first page */
+            samples[i].offset -= samples[i].offset % page_size;
+        }
+        samples[i].physical = 0;
+        samples[i].buf = data + i * page_size;
+    }
+
+    gboolean read_ok = FALSE;
+    int fd = rm_shred_open_rdonly(file);
+    if(fd != -1) {
+        if(rm_mds_device_is_rotational(file->disk)) {
+            for(guint i = 0; i < n_samples; ++i) {
+                samples[i].physical =
+                    rm_offset_get_from_fd(fd, samples[i].offset, NULL, NULL);
+            }
+            qsort(samples, n_samples, sizeof(RmShredSample), rm_shred_cmp_sample_physical);
+        }
+
+        read_ok = TRUE;
+        for(guint i = 0; read_ok && i < n_samples; ++i) {
+            read_ok = rm_shred_pread(fd, samples[i].buf, page_size, samples[i].offset);
+        }
+        rm_sys_close(fd);
+    }
+
+    if(read_ok) {
+        rm_digest_update(file->digest, data, n_samples * page_size);
+        rm_shred_count_read(tag, n_samples * page_size);
+    } else {
+        file->status = RM_FILE_STATE_IGNORE;
+    }
+    g_free(data);
+}
+
 /* call with device unlocked */
 static bool rm_shred_can_process(RmFile *file, RmShredTag *main) {
     if(file->digest) {
@@ -1620,13 +2482,14 @@ static bool rm_shred_can_process(RmFile *file, RmShredTag *main) {
     }
 }
 
-/* Callback for RmMDS
- * Return value of 1 tells md-scheduler that we have processed the file and either
- * disposed of it or pushed it back to the scheduler queue.
- * Return value of 0 tells md-scheduler we can't process the file right now, and
- * have pushed it back to the queue.
- * */
-static gint rm_shred_process_file(RmFile *file, RmSession *session) {
+/* Hash increments of file until it is handed over to rm_shred_hash_callback() or
+ * pushed back to the scheduler.  If batch_index >= 0 then the first increment
+ * (batch_bytes long) has already been read as part of batch.
+ * Returns 1 if any processing was done, else 0 (refer rm_shred_process_file).
+ */
+static gint rm_shred_process_file_impl(RmFile *file, RmSession *session,
+                                       RmHasherBatch *batch, gint batch_index,
+                                       RmOff batch_bytes) {
     RmShredTag *tag = session->shredder;
 
     if(rm_session_was_aborted()) {
@@ -1635,32 +2498,107 @@ static gint rm_shred_process_file(RmFile *file, RmSession *session) {
         return 1;
     }
 
+    if(g_atomic_int_get(&tag->over_budget)) {
+        rm_shred_park_file(file, tag);
+        return 1;
+    }
+
     gint result = 0;
-    RM_DEFINE_PATH(file);
+
+    /* symlinks are read via readlink(2), so no point keeping them open */
+    gboolean use_fd_cache = (tag->fd_cache && !file->is_symlink);
+
+    /* batched and cached reads don't need the path */
+    gboolean have_path = (batch_index < 0 && !use_fd_cache);
+    RM_DEFINE_PATH_IF_NEEDED(file, have_path);
+
+    /* whether the next read follows on from the previous one on this device */
+    gboolean sequential = FALSE;
 
     while(file && rm_shred_can_process(file, tag)) {
         result = 1;
+
+        if(g_atomic_int_get(&tag->over_budget)) {
+            /* file came back from rm_shred_sift(); don't start another increment */
+            rm_shred_park_file(file, tag);
+            file = NULL;
+            break;
+        }
+
+        if(file->shred_group->n_samples > 0) {
+            /* sparse sampling generation; hashed right here, so sift it straight
+             * away and let the next generation queue it as usual */
+            rm_shred_sample(file, tag);
+            file->shredder_waiting = FALSE;
+            file = rm_shred_sift(file);
+            continue;
+        }
         /* hash the next increment of the file */
         RmCfg *cfg = session->cfg;
         RmOff bytes_to_read = rm_shred_get_read_size(file, tag);
 
+        if(batch_index >= 0 && bytes_to_read != batch_bytes) {
+            /* read size changed since batching; read it the normal way */
+            batch_index = -1;
+        }
+
+        int fd = -1;
+        if(batch_index < 0 && use_fd_cache) {
+            fd = rm_fd_cache_take(tag->fd_cache, file);
+        }
+
+        if(batch_index < 0 && fd == -1 && !have_path) {
+            rm_file_build_path(file, file_path);
+            have_path = TRUE;
+        }
+
         gboolean shredder_waiting =
             (file->shred_group->next_offset != file->file_size) &&
             (cfg->shred_always_wait ||
-             (!cfg->shred_never_wait && rm_mds_device_is_rotational(file->disk) &&
-              bytes_to_read < SHRED_TOO_MANY_BYTES_TO_WAIT));
+             (!cfg->shred_never_wait && rm_shred_worth_waiting(file, bytes_to_read)));
+
+        /* batched reads share their seeks and mmap()ed reads happen in the
+         * hasher threads, so only time the others for the device model */
+        gboolean timed = (batch_index < 0 && !file->is_symlink &&
+                          (tag->mmap_threshold == 0 || file->file_size < tag->mmap_threshold));
+        gint64 read_start = timed ? g_get_monotonic_time() : 0;
 
         gsize bytes_read = 0;
         RmHasherTask *task = rm_hasher_task_new(tag->hasher, file->digest, file);
-        if(!rm_hasher_task_hash(task, file_path, file->hash_offset, bytes_to_read,
-                                file->is_symlink, &bytes_read)) {
+        gboolean read_ok = FALSE;
+        if(batch_index >= 0) {
+            read_ok = rm_hasher_task_hash_batched(task, batch, batch_index, &bytes_read);
+            batch_index = -1;
+        } else if(use_fd_cache) {
+            if(fd == -1 && (fd = rm_hasher_open(tag->hasher, file_path)) == -1) {
+                rm_log_info("open(2) failed for %s: %s\n", file_path, g_strerror(errno));
+            } else {
+                read_ok = rm_hasher_task_hash_fd(task, fd, file->hash_offset,
+                                                 bytes_to_read, &bytes_read);
+                /* keep fd for the next increment; must be done before
+                 * rm_hasher_task_finish() hands the file to the callback */
+                if(read_ok && file->hash_offset + bytes_to_read < file->file_size) {
+                    rm_fd_cache_put(tag->fd_cache, file, fd);
+                } else {
+                    rm_sys_close(fd);
+                }
+            }
+        } else {
+            read_ok = rm_hasher_task_hash(task, file_path, file->hash_offset,
+                                          bytes_to_read, file->is_symlink, &bytes_read);
+        }
+
+        if(!read_ok) {
             /* rm_hasher_start_increment failed somewhere */
             file->status = RM_FILE_STATE_IGNORE;
             shredder_waiting = FALSE;
+        } else if(timed) {
+            /* a file coming back from rm_shred_sift() continues where it stopped */
+            rm_mds_device_record_read(file->disk, bytes_read,
+                                      g_get_monotonic_time() - read_start, !sequential);
         }
 
-        /* TODO: make this threadsafe: */
-        session->shred_bytes_read += bytes_read;
+        rm_shred_count_read(tag, bytes_read);
 
         /* Update totals for file, device and session*/
         file->hash_offset += bytes_to_read;
@@ -1675,10 +2613,10 @@ static gint rm_shred_process_file(RmFile *file, RmSession *session) {
             shredder_waiting =
                 shredder_waiting &&
                 /* no point waiting if we have no siblings */
-                file->shred_group->children &&
+                g_atomic_int_get(&file->shred_group->n_children) > 0 &&
                 /* no point waiting if paranoid digest with no twin candidates */
                 (file->digest->type != RM_DIGEST_PARANOID ||
-                 ((RmParanoid*)file->digest->state)->twin_candidate);
+                 ((RmParanoid*)file->digest->state)->twin_matches);
         }
         file->signal = shredder_waiting ? rm_signal_new() : NULL;
         file->shredder_waiting = shredder_waiting;
@@ -1693,6 +2631,7 @@ static gint rm_shred_process_file(RmFile *file, RmSession *session) {
             file->signal = NULL;
             /* sift file; if returned then continue processing it */
             file = rm_shred_sift(file);
+            sequential = TRUE;
         } else {
             /* rm_shred_hash_callback will take care of the file */
             file = NULL;
@@ -1700,11 +2639,67 @@ static gint rm_shred_process_file(RmFile *file, RmSession *session) {
     }
     if(file) {
         /* file was not handled by rm_shred_sift so we need to add it back to the queue */
-        rm_mds_push_task(file->disk, file->dev, file->disk_offset, NULL, file);
+        RmShredGroup *group = file->shred_group;
+        g_mutex_lock(&group->lock);
+        {
+            rm_mds_push_task_prio(file->disk, file->dev, file->disk_offset,
+                                  rm_shred_savings(file), file);
+        }
+        g_mutex_unlock(&group->lock);
     }
     return result;
 }
 
+/* Callback for RmMDS
+ * Return value of 1 tells md-scheduler that we have processed the file and either
+ * disposed of it or pushed it back to the scheduler queue.
+ * Return value of 0 tells md-scheduler we can't process the file right now, and
+ * have pushed it back to the queue.
+ * */
+static gint rm_shred_process_file(RmFile *file, RmSession *session) {
+    return rm_shred_process_file_impl(file, session, NULL, -1, 0);
+}
+
+/* Batch callback for RmMDS; files due for their first increment are opened and
+ * read together (refer rm_hasher_batch_read()), which saves most of the syscall
+ * overhead for small files.  Return value is the sum of rm_shred_process_file()
+ * return values. */
+static gint rm_shred_process_batch(RmFile **files, guint n_files, RmSession *session) {
+    RmShredTag *tag = session->shredder;
+    RmHasherBatch *batch = rm_hasher_batch_new(tag->hasher);
+
+    gint batch_indices[n_files];
+    RmOff batch_bytes[n_files];
+
+    for(guint i = 0; i < n_files; ++i) {
+        RmFile *file = files[i];
+        batch_indices[i] = -1;
+        batch_bytes[i] = 0;
+
+        if(file->hash_offset == 0 && !file->is_symlink && !rm_session_was_aborted() &&
+           !g_atomic_int_get(&tag->over_budget) && file->shred_group->n_samples == 0 &&
+           rm_shred_can_process(file, tag)) {
+            /* needed once for the batched OPENAT; rm_shred_process_file_impl()
+             * won't build it again unless it reads beyond the batched bytes */
+            RM_DEFINE_PATH(file);
+            batch_bytes[i] = rm_shred_get_read_size(file, tag);
+            batch_indices[i] =
+                rm_hasher_batch_add(batch, file_path, file->hash_offset, batch_bytes[i]);
+        }
+    }
+
+    rm_hasher_batch_read(batch);
+
+    gint result = 0;
+    for(guint i = 0; i < n_files; ++i) {
+        result += rm_shred_process_file_impl(files[i], session, batch, batch_indices[i],
+                                             batch_bytes[i]);
+    }
+
+    rm_hasher_batch_free(batch);
+    return result;
+}
+
 /* called when treemerge.c found something interesting */
 void rm_shred_output_tm_results(RmFile *file, gpointer data) {
     g_assert(data);
@@ -1721,10 +2716,12 @@ void rm_shred_run(RmSession *session) {
     RmCfg *cfg = session->cfg;
 
     RmShredTag tag;
+    memset(&tag, 0, sizeof(tag));
     tag.active_groups = 0;
     tag.session = session;
     tag.mem_refusing = false;
     session->shredder = &tag;
+    rm_arena_init(&tag.group_arena, sizeof(RmShredGroup));
 
     tag.page_size = SHRED_PAGE_SIZE;
 
@@ -1740,21 +2737,23 @@ void rm_shred_run(RmSession *session) {
                      session,
                      session->cfg->sweep_count,
                      session->cfg->threads_per_disk,
-                     (RmMDSSortFunc)rm_mds_elevator_cmp);
+                     (RmMDSSortFunc)rm_shred_savings_cmp);
 
-    /* Create a pool for progress counting */
-    tag.counter_pool = rm_util_thread_pool_new((GFunc)rm_shred_counter_factory, &tag, 1);
+    /* Start summing up progress counters */
+    rm_shred_start_progress(&tag);
 
-    /* Create a pool for results processing */
-    tag.result_pool = rm_util_thread_pool_new((GFunc)rm_shred_result_factory, &tag, 1);
+    /* Create pools for results processing and output */
+    tag.early_results = g_hash_table_new(NULL, NULL);
+    tag.output_pool = rm_util_thread_pool_new((GFunc)rm_shred_output_factory, &tag, 1);
+    tag.result_pool = rm_util_thread_pool_new(
+        (GFunc)rm_shred_result_factory, &tag,
+        CLAMP(cfg->threads, 1, SHRED_MAX_RESULT_THREADS));
 
     rm_shred_preprocess_input(&tag);
     rm_log_debug_line("Done shred preprocessing");
 
-    /* wait for counters to catch up */
-    while(g_thread_pool_unprocessed(tag.counter_pool) > 0) {
-        g_usleep(10);
-    }
+    /* bring counters up to date */
+    rm_shred_update_progress(&tag);
     rm_log_debug_line("Byte and file counters up to date");
 
     tag.after_preprocess = TRUE;
@@ -1769,6 +2768,11 @@ void rm_shred_run(RmSession *session) {
         /* allocate any spare mem for paranoid hashing */
         tag.paranoid_mem_alloc = (gint64)cfg->total_mem - (gint64)mem_used;
         tag.paranoid_mem_alloc = MAX(0, tag.paranoid_mem_alloc);
+        if(cfg->paranoid_spill_dir &&
+           rm_digest_paranoid_spill_open(cfg->paranoid_spill_dir)) {
+            tag.paranoid_mem_alloc = rm_shred_spill_budget(cfg, tag.paranoid_mem_alloc);
+            rm_log_debug_line("Spilling paranoid data to %s", cfg->paranoid_spill_dir);
+        }
         rm_log_debug_line("Paranoid Mem: %" LLU, tag.paranoid_mem_alloc);
         /* paranoid memory manager takes care of memory load; */
         read_buffer_mem = 0;
@@ -1785,26 +2789,99 @@ void rm_shred_run(RmSession *session) {
                                (RmHasherCallback)rm_shred_hash_callback,
                                &tag);
 
+    /* buffered reads go through stdio, which we can't keep open cheaply */
+    tag.fd_cache = NULL;
+    if(!cfg->use_buffered_read) {
+        tag.fd_cache = rm_fd_cache_new(rm_fd_cache_default_capacity());
+    }
+
+    if(cfg->use_direct_io) {
+        if(rm_hasher_set_use_direct_io(tag.hasher, TRUE)) {
+            rm_log_debug_line("Reading files with O_DIRECT");
+        } else {
+            rm_log_debug_line("O_DIRECT not usable; dropping read data from page cache");
+        }
+    }
+
+    tag.mmap_threshold = rm_hasher_set_mmap_threshold(tag.hasher, cfg->mmap_threshold);
+    if(tag.mmap_threshold > 0) {
+        rm_log_debug_line("Hashing files >= %" LLU " bytes via mmap", tag.mmap_threshold);
+    }
+
+    if(rm_hasher_set_use_io_uring(tag.hasher, !cfg->no_io_uring)) {
+        rm_log_debug_line("Reading files via io_uring");
+    }
+    if(rm_hasher_batch_is_supported(tag.hasher)) {
+        /* open and read the first increment of small files in batches */
+        rm_mds_configure_batch(session->mds, (RmMDSBatchFunc)rm_shred_process_batch,
+                               SHRED_BATCH_FILES);
+    }
+
     rm_fmt_set_state(session->formats, RM_PROGRESS_STATE_SHREDDER);
 
     session->shred_bytes_total = session->shred_bytes_remaining;
+    GTimer *shred_timer = g_timer_new();
     rm_mds_start(session->mds);
 
     /* should complete shred session and then free: */
     rm_mds_free(session->mds, FALSE);
+
+    guint64 bytes_direct = 0, bytes_cached = 0;
+    rm_hasher_get_read_stats(tag.hasher, &bytes_direct, &bytes_cached);
+    session->shred_bytes_read_direct = bytes_direct;
+    session->shred_bytes_read_cached = bytes_cached;
     rm_hasher_free(tag.hasher, TRUE);
 
+    if(cfg->verify) {
+        rm_log_debug_line("Verified duplicates by reading %" LLU " bytes",
+                          tag.verified_bytes);
+    }
+
+    guint64 spill_size = rm_digest_paranoid_spill_close();
+    if(spill_size > 0) {
+        rm_log_debug_line("Paranoid spill file grew to %" LLU " bytes", spill_size);
+    }
+
+    session->shred_elapsed = g_timer_elapsed(shred_timer, NULL);
+    g_timer_destroy(shred_timer);
+
     session->shredder_finished = TRUE;
     rm_fmt_set_state(session->formats, RM_PROGRESS_STATE_SHREDDER);
 
     /* This should not block, or at least only very short. */
     g_thread_pool_free(tag.result_pool, FALSE, TRUE);
+    g_thread_pool_free(tag.output_pool, FALSE, TRUE);
+    g_assert(g_hash_table_size(tag.early_results) == 0);
+    g_hash_table_unref(tag.early_results);
+    rm_log_debug_line("Finished groups: %u; longest queue for post-processing %u, "
+                      "for output %u",
+                      tag.result_seq, tag.max_result_queue, tag.max_output_queue);
+
+    if(tag.parked_files > 0) {
+        rm_log_warning_line(_("Budget used up: %" LLU " files were not read to the end"),
+                            (RmOff)tag.parked_files);
+    }
+
+    /* all files are done with now */
+    rm_fd_cache_free(tag.fd_cache);
+    tag.fd_cache = NULL;
 
-    rm_log_debug(BLUE "Waiting for progress counters to catch up..." RESET);
-    g_thread_pool_free(tag.counter_pool, FALSE, TRUE);
-    rm_log_debug(BLUE "Done\n" RESET);
+    rm_shred_stop_progress(&tag);
 
     g_mutex_clear(&tag.hash_mem_mtx);
     rm_log_debug_line("Remaining %" LLU " bytes in %" LLU " files",
                       session->shred_bytes_remaining, session->shred_files_remaining);
+
+    RmDigestPoolStats pool_stats;
+    rm_digest_pool_stats(&pool_stats);
+    rm_log_debug_line("Digests: %" LLU " allocated from %" LLU " pool slabs (%" LLU
+                      " bytes)",
+                      pool_stats.n_digests, pool_stats.n_slabs, pool_stats.slab_bytes);
+
+    /* all groups are finished and freed by now */
+    RmArenaStats arena_stats;
+    rm_arena_stats(&tag.group_arena, &arena_stats);
+    rm_log_debug_line("Groups: %" LLU " allocated from %" LLU " arena slabs (%" LLU " bytes)",
+                      arena_stats.n_blocks, arena_stats.n_slabs, arena_stats.slab_bytes);
+    rm_arena_clear(&tag.group_arena);
 }
@@ -389,7 +389,7 @@ static void rm_directory_to_file(RmTreeMerger *merger, const RmDirectory *self,
 
 static RmFile *rm_directory_as_new_file(RmTreeMerger *merger, const RmDirectory *self) {
     /* Masquerades an RmDirectory as RmFile for purpose of output */
-    RmFile *file = g_malloc0(sizeof(RmFile));
+    RmFile *file = rm_arena_alloc0(&merger->session->file_arena);
     rm_directory_to_file(merger, self, file);
     return file;
 }
@@ -1042,8 +1042,10 @@ void rm_tm_destroy(RmTreeMerger *self) {
     /*  Iterate over all files that were not forwarded to the
      *  output module (where they would be freed)
      *  */
-    GList *file_list = g_hash_table_get_values(self->free_map);
-    g_list_free_full(file_list, (GDestroyNotify)rm_file_destroy);
+    if(!self->session->fast_exit) {
+        GList *file_list = g_hash_table_get_values(self->free_map);
+        g_list_free_full(file_list, (GDestroyNotify)rm_file_destroy);
+    }
     g_hash_table_unref(self->free_map);
 
     g_slice_free(RmTreeMerger, self);
@@ -1109,6 +1109,58 @@ RmOff rm_offset_get_from_path(const char *path, RmOff file_offset,
     return result;
 }
 
+/* files with more extents than this are not worth the memory of a map */
+#define RM_OFFSET_MAX_MAP_EXTENTS 4096
+
+/* extents whose fe_physical does not identify the data on its own; for
+ * compressed (encoded) extents it points at the start of the whole extent,
+ * whatever part of it the file references */
+#define RM_OFFSET_UNMAPPABLE                                                 \
+    (FIEMAP_EXTENT_UNKNOWN | FIEMAP_EXTENT_DELALLOC | FIEMAP_EXTENT_ENCODED | \
+     FIEMAP_EXTENT_DATA_ENCRYPTED | FIEMAP_EXTENT_NOT_ALIGNED |               \
+     FIEMAP_EXTENT_DATA_INLINE | FIEMAP_EXTENT_DATA_TAIL)
+
+char *rm_offset_get_extent_map(int fd) {
+    fsync(fd);
+
+    /* with n_extents == 0 the kernel only counts the extents */
+    struct fiemap *fm = rm_offset_get_fiemap(fd, 0, 0);
+    if(fm == NULL) {
+        return NULL;
+    }
+    guint n_extents = fm->fm_mapped_extents;
+    g_free(fm);
+
+    if(n_extents == 0 || n_extents > RM_OFFSET_MAX_MAP_EXTENTS) {
+        return NULL;
+    }
+
+    fm = rm_offset_get_fiemap(fd, n_extents, 0);
+    if(fm == NULL) {
+        return NULL;
+    }
+
+    GString *map = g_string_sized_new(n_extents * 32);
+    bool complete = false;
+    for(guint i = 0; i < fm->fm_mapped_extents; i++) {
+        struct fiemap_extent *ext = &fm->fm_extents[i];
+        if((ext->fe_flags & RM_OFFSET_UNMAPPABLE) || ext->fe_physical == 0) {
+            break;
+        }
+        g_string_append_printf(map, "%" LLU ":%" LLU ":%" LLU ";",
+                               (RmOff)ext->fe_logical, (RmOff)ext->fe_physical,
+                               (RmOff)ext->fe_length);
+        if(ext->fe_flags & FIEMAP_EXTENT_LAST) {
+            /* also fails if the file grew extents between the two calls */
+            complete = true;
+            break;
+        }
+    }
+    g_free(fm);
+
+    return g_string_free(map, !complete);
+}
+
 #else /* Probably FreeBSD */
 
 RmOff rm_offset_get_from_fd(_UNUSED int fd, _UNUSED RmOff file_offset,
@@ -1121,6 +1173,10 @@ RmOff rm_offset_get_from_path(_UNUSED const char *path, _UNUSED RmOff file_offse
     return 0;
 }
 
+char *rm_offset_get_extent_map(_UNUSED int fd) {
+    return NULL;
+}
+
 #endif
 
 static gboolean rm_util_is_path_double(char *path1, char *path2) {
@@ -103,6 +103,14 @@ WARN_UNUSED_RESULT static inline int rm_sys_lstat(const char *path, RmStat *buf)
 #endif
 }
 
+WARN_UNUSED_RESULT static inline int rm_sys_fstat(int fd, RmStat *buf) {
+#if HAVE_STAT64 && !RM_IS_APPLE
+    return fstat64(fd, buf);
+#else
+    return fstat(fd, buf);
+#endif
+}
+
 static inline gdouble rm_sys_stat_mtime_float(RmStat *stat) {
 #if RM_IS_APPLE
     return (gdouble)stat->st_mtimespec.tv_sec + stat->st_mtimespec.tv_nsec / 1000000000.0;
@@ -426,6 +434,18 @@ RmOff rm_offset_get_from_fd(int fd, RmOff file_offset, RmOff *file_offset_next,
 RmOff rm_offset_get_from_path(const char *path, RmOff file_offset,
                               RmOff *file_offset_next);
 
+/**
+ * @brief Describe the complete extent map of fd as a string.
+ *
+ * Two files on the same filesystem with equal descriptions share all their
+ * data blocks, so their contents are identical.
+ *
+ * @return a newly allocated string, or NULL if the map is unavailable or has
+ * extents whose physical location does not identify their data (inline,
+ * delayed, compressed or encrypted extents).
+ */
+char *rm_offset_get_extent_map(int fd);
+
 /**
  * @brief Test if two files have identical fiemaps.
  * @retval see RmOffsetsMatchCode enum definition.
@@ -224,3 +224,31 @@ def test_clone_handler():
     counts = pattern_count(sh_path, ["clone '", "skip_reflink '"])
     assert counts[0] == 0
     assert counts[1] == 1
+
+
+@needs_reflink_fs
+@with_setup(usual_setup_func, usual_teardown_func)
+def test_cluster_reflinks():
+    # large enough to prevent inline extents
+    path_a = create_file('1' * 100000, 'a')
+    path_b = create_file('1' * 100000, 'b')
+    create_file('1' * 100000, 'c')
+    create_file('1' * 99999 + '2', 'd')
+
+    with assert_exit_code(0):
+        run_rmlint(
+            '--dedupe', path_a, path_b,
+            use_default_dir=False,
+            with_json=False,
+            verbosity=""
+        )
+
+    head, *data, footer = run_rmlint('-S a --cluster-reflinks')
+    assert len(data) == 3
+    assert [os.path.basename(f['path']) for f in data] == ['a', 'b', 'c']
+
+    # without a non-reflinked twin the reflinks are still reported
+    os.remove(os.path.join(TESTDIR_NAME, 'c'))
+    head, *data, footer = run_rmlint('-S a --cluster-reflinks')
+    assert len(data) == 2
+    assert [os.path.basename(f['path']) for f in data] == ['a', 'b']
@@ -35,7 +35,7 @@ def streaming_compliance_check(patterns):
         ['glib:', 'md5', 'sha1', 'sha256', 'sha512'],
         'sha3',
         'blake',
-        'xxhash',
+        'xxh',
         'highway'
         ])
 def test_hash_function(*pat):
@@ -44,3 +44,97 @@ def test_hash_function(*pat):
     else:
         streaming_compliance_check(pat[1:])
 
+
+
+@with_setup(usual_setup_func, usual_teardown_func)
+def test_blake3_known_answers():
+    # large enough for several leaves which are hashed in parallel
+    # (increment 65536 lines up with the 1 MiB leaves, 4096 does not
+    # reach the leaf threshold and 20000 straddles leaf boundaries)
+    small = create_file('abc', 'small')
+    big = os.path.join(TESTDIR_NAME, 'big')
+    with open(big, 'wb') as handle:
+        handle.write(bytes(i % 251 for i in range(3 * 1024 * 1024 + 17)))
+
+    expected = {
+        small: '6437b3ac38465133ffb63b75273a8db548c558465d79db03fd359c6cd5bd9d85',
+        big: '26003c63117013de5d02be76e5e32a2f75bfbc075f17180fd5f9f0b4752d2bfe',
+    }
+
+    for increment in (4096, 65536, 20000):
+        for path, checksum in expected.items():
+            output = subprocess.check_output([
+                './rmlint', '--hash', '--increment', str(increment),
+                '--algorithm', 'blake3', path
+            ])
+            assert output.decode('utf-8').split()[0] == checksum
+
+
+@with_setup(usual_setup_func, usual_teardown_func)
+def test_blake2_known_answers():
+    # the compression functions use SSE4.1/AVX2 kernels where the CPU has them
+    import hashlib
+
+    path = os.path.join(TESTDIR_NAME, 'data')
+    data = bytes((i * 7 + i // 251) % 256 for i in range(100003))
+    with open(path, 'wb') as handle:
+        handle.write(data)
+
+    for algo, reference in (('blake2b', hashlib.blake2b), ('blake2s', hashlib.blake2s)):
+        for increment in (4096, 20000):
+            output = subprocess.check_output([
+                './rmlint', '--hash', '--increment', str(increment),
+                '--algorithm', algo, path
+            ])
+            assert output.decode('utf-8').split()[0] == reference(data).hexdigest()
+
+
+@with_setup(usual_setup_func, usual_teardown_func)
+def test_sha_known_answers():
+    # sha1/sha256 use SHA-NI or ARMv8 crypto where present; --no-sse forces
+    # the portable code
+    import hashlib
+
+    path = os.path.join(TESTDIR_NAME, 'data')
+    data = bytes((i * 13 + i // 241) % 256 for i in range(100003))
+    with open(path, 'wb') as handle:
+        handle.write(data)
+
+    for algo in ('sha1', 'sha256'):
+        for extra in ([], ['--no-sse']):
+            for increment in (4096, 20000):
+                output = subprocess.check_output([
+                    './rmlint', '--hash', '--increment', str(increment),
+                    '--algorithm', algo, path
+                ] + extra)
+                checksum = output.decode('utf-8').split()[0]
+                assert checksum == hashlib.new(algo, data).hexdigest()
+
+
+@with_setup(usual_setup_func, usual_teardown_func)
+def test_xxh3_known_answers():
+    # checksums are printed in the canonical form used by xxhsum
+    small = create_file('abc', 'small')
+    big = os.path.join(TESTDIR_NAME, 'big')
+    with open(big, 'wb') as handle:
+        handle.write(bytes(i % 251 for i in range(3 * 1024 * 1024 + 17)))
+
+    expected = {
+        'xxh3': {
+            small: '78af5f94892f3950',
+            big: 'fb45fcd49e8371b7',
+        },
+        'xxh3-128': {
+            small: '06b05ab6733a618578af5f94892f3950',
+            big: 'a8d2aaa87f9b2799fb45fcd49e8371b7',
+        },
+    }
+
+    for algo, checksums in expected.items():
+        for increment in (4096, 20000):
+            for path, checksum in checksums.items():
+                output = subprocess.check_output([
+                    './rmlint', '--hash', '--increment', str(increment),
+                    '--algorithm', algo, path
+                ])
+                assert output.decode('utf-8').split()[0] == checksum
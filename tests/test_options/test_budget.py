@@ -0,0 +1,37 @@
+#!/usr/bin/env python3
+# encoding: utf-8
+from nose import with_setup
+from tests.utils import *
+
+
+def create_pair():
+    create_file('x' * 10000, 'a')
+    create_file('x' * 10000, 'b')
+    create_file('y' * 10000, 'c')
+
+
+@with_setup(usual_setup_func, usual_teardown_func)
+def test_budget_not_reached():
+    create_pair()
+
+    for options in ['--time-budget 3600', '--read-budget 1G']:
+        head, *data, footer = run_rmlint('-S a ' + options)
+        assert len(data) == 2
+        assert data[0]['path'].endswith('a')
+        assert data[1]['path'].endswith('b')
+
+
+@with_setup(usual_setup_func, usual_teardown_func)
+def test_budget_used_up():
+    create_pair()
+
+    # used up before the first read; nothing is confirmed, but the run
+    # still finishes normally
+    head, *data, footer = run_rmlint('--time-budget 0.000001')
+    assert len(data) == 0
+    assert footer['duplicates'] == 0
+
+    # with --write-unfinished the files may show up, but only as unfinished
+    head, *data, footer = run_rmlint('--time-budget 0.000001 -U')
+    assert all(p['type'] == 'unique_file' for p in data)
+    assert footer['duplicates'] == 0
@@ -137,3 +137,26 @@ def test_xattr_detail(extra_opts):
         assert must_read_xattr(path_2) == {}
         assert must_read_xattr(path_3) == {}
         assert must_read_xattr(path_4) == {}
+
+
+@with_setup(usual_setup_func, usual_teardown_func)
+def test_xattr_verify():
+    create_file('abc', 'a')
+    create_file('abc', 'b')
+
+    head, *data, footer = run_rmlint('-S a --xattr-write', force_no_pendantic=True)
+    assert footer['duplicates'] == 1
+
+    # Change the content behind the back of the cached checksum.
+    path = os.path.join(TESTDIR_NAME, 'b')
+    stat = os.stat(path)
+    with open(path, 'w') as handle:
+        handle.write('abd')
+    os.utime(path, ns=(stat.st_atime_ns, stat.st_mtime_ns))
+
+    head, *data, footer = run_rmlint('-S a --xattr-read', force_no_pendantic=True)
+    assert footer['duplicates'] == 1
+
+    head, *data, footer = run_rmlint('-S a --xattr-read --verify', force_no_pendantic=True)
+    assert footer['duplicates'] == 0
+    assert not any(p['type'] == 'duplicate_file' for p in data)
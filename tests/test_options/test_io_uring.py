@@ -0,0 +1,39 @@
+#!/usr/bin/env python3
+# encoding: utf-8
+from nose import with_setup
+from tests.utils import *
+
+import random
+
+# many read buffers per increment, so that several reads are in flight
+SIZE = 3 * 1024 * 1024 + 123
+
+
+def create_data(name, flip_last=False):
+    data = bytearray(random.Random(42).getrandbits(8) for _ in range(SIZE))
+    if flip_last:
+        data[-1] ^= 0xff
+    with open(os.path.join(TESTDIR_NAME, name), 'wb') as handle:
+        handle.write(data)
+
+
+def checksums(options):
+    head, *data, footer = run_rmlint('-S a -a blake2b --read-buffer-len 4096 ' + options)
+    return {os.path.basename(p['path']): p['checksum'] for p in data}
+
+
+@with_setup(usual_setup_func, usual_teardown_func)
+def test_io_uring_matches_preadv():
+    create_data('a')
+    create_data('b')
+    create_data('c', flip_last=True)
+    create_data('d', flip_last=True)
+
+    with_ring = checksums('')
+    assert sorted(with_ring) == ['a', 'b', 'c', 'd']
+    assert with_ring['a'] == with_ring['b']
+    assert with_ring['c'] == with_ring['d']
+    assert with_ring['a'] != with_ring['c']
+
+    assert checksums('--no-io-uring') == with_ring
+    assert checksums('--buffered-read') == with_ring
@@ -0,0 +1,78 @@
+#!/usr/bin/env python3
+# encoding: utf-8
+from nose import with_setup
+from tests.utils import *
+
+# large enough to get sampled with --sample-pages 4
+SIZE = 4 * 1024 * 1024 + 4096
+
+
+def create_variant(name, pos=None):
+    data = ['x'] * SIZE
+    if pos is not None:
+        data[pos] = 'y'
+    create_file(''.join(data), name)
+
+
+@with_setup(usual_setup_func, usual_teardown_func)
+def test_identical():
+    create_variant('a')
+    create_variant('b')
+
+    head, *data, footer = run_rmlint('-S a --sample-pages 4')
+    assert len(data) == 2
+    assert data[0]['path'].endswith('a')
+    assert data[1]['path'].endswith('b')
+
+
+@with_setup(usual_setup_func, usual_teardown_func)
+def test_differ_in_samples():
+    create_variant('a')
+    create_variant('b')
+    create_variant('c', SIZE - 1)
+    create_variant('d', 0)
+
+    head, *data, footer = run_rmlint('-S a --sample-pages 4')
+    assert len(data) == 2
+    assert data[0]['path'].endswith('a')
+    assert data[1]['path'].endswith('b')
+
+
+@with_setup(usual_setup_func, usual_teardown_func)
+def test_differ_between_samples():
+    # the samples match, so the full read has to find this
+    create_variant('a')
+    create_variant('b', 12345)
+
+    for options in ['--sample-pages 4', '--sample-pages 256', '--sample-pages 1']:
+        head, *data, footer = run_rmlint(options)
+        assert len(data) == 0
+
+
+def bytes_read(options):
+    output = run_rmlint(
+        options + ' -o stats', with_json=False, directly_return_output=True
+    ).decode('utf-8')
+
+    units = {'B': 1, 'KB': 1024, 'MB': 1024 ** 2, 'GB': 1024 ** 3}
+    for line in output.splitlines():
+        if line.endswith('bytes of files data actually read'):
+            number, unit = line.split()[:2]
+            return float(number) * units[unit]
+
+    assert False, 'no read stats in output: ' + output
+
+
+@with_setup(usual_setup_func, usual_teardown_func)
+def test_split_by_interior_sample():
+    # inside the second of four sampled pages, for 4K up to 64K pages
+    create_variant('a')
+    create_variant('b', 1398101)
+
+    head, *data, footer = run_rmlint('--sample-pages 4')
+    assert len(data) == 0
+
+    # the samples tell the files apart, so neither is read in full
+    sampled = bytes_read('--sample-pages 4')
+    assert sampled < SIZE / 4
+    assert sampled * 2 < bytes_read('')
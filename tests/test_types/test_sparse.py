@@ -0,0 +1,65 @@
+#!/usr/bin/env python3
+# encoding: utf-8
+from nose import with_setup
+from tests.utils import *
+import os
+
+from parameterized import parameterized
+
+HOLE = 8 * 1024 * 1024
+
+
+def create_sparse(name, head, tail):
+    # head, a hole of HOLE bytes and tail; filesystems without hole
+    # support just store the zeros
+    with open(os.path.join(TESTDIR_NAME, name), 'wb') as handle:
+        handle.write(head)
+        handle.seek(HOLE, os.SEEK_CUR)
+        handle.write(tail)
+
+
+def create_dense(name, head, tail):
+    with open(os.path.join(TESTDIR_NAME, name), 'wb') as handle:
+        handle.write(head)
+        handle.write(bytes(HOLE))
+        handle.write(tail)
+
+
+ALGOS = ['blake2b', 'blake2b-tree', 'blake3', 'xxhash', 'paranoid']
+
+
+@parameterized(ALGOS)
+@with_setup(usual_setup_func, usual_teardown_func)
+def test_sparse_equals_dense(algo):
+    create_sparse('a', b'x' * 5000, b'y' * 3000)
+    create_sparse('b', b'x' * 5000, b'y' * 3000)
+    create_dense('c', b'x' * 5000, b'y' * 3000)
+
+    head, *data, footer = run_rmlint('-S a -a {}'.format(algo))
+    assert len(data) == 3
+    assert [os.path.basename(p['path']) for p in data] == ['a', 'b', 'c']
+
+
+@parameterized(ALGOS)
+@with_setup(usual_setup_func, usual_teardown_func)
+def test_sparse_differ_after_hole(algo):
+    create_sparse('a', b'x' * 5000, b'y' * 3000)
+    create_sparse('b', b'x' * 5000, b'z' * 3000)
+    create_dense('c', b'x' * 5000, b'z' * 3000)
+
+    head, *data, footer = run_rmlint('-S a -a {}'.format(algo))
+    assert len(data) == 2
+    assert [os.path.basename(p['path']) for p in data] == ['b', 'c']
+
+
+@parameterized(ALGOS)
+@with_setup(usual_setup_func, usual_teardown_func)
+def test_sparse_different_hole_layout(algo):
+    # same content, but b's hole starts 20000 zero bytes later, off any
+    # buffer boundary
+    create_sparse('a', b'x' * 5000, bytes(20000) + b'y' * 3000)
+    create_sparse('b', b'x' * 5000 + bytes(20000), b'y' * 3000)
+
+    head, *data, footer = run_rmlint('-S a -a {}'.format(algo))
+    assert len(data) == 2
+    assert [os.path.basename(p['path']) for p in data] == ['a', 'b']
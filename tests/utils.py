@@ -34,9 +34,13 @@ CKSUM_TYPES = [
     'blake2sp',
     'blake2bp',
     'xxhash',
+    'xxh3',
+    'xxh3-128',
     'highway64',
     'highway128',
     'highway256',
+    'blake2b-tree',
+    'blake3',
     #'cumulative',
     #'ext',
     'paranoid',
@@ -239,7 +243,12 @@ def run_rmlint_pedantic(*args, **kwargs):
         '-P',
         '-PP',
         '--limit-mem 1M --algorithm=paranoid',
+        '--limit-mem 1M --algorithm=paranoid --paranoid-spill-dir=/tmp',
         '--buffered-read',
+        '--no-io-uring',
+        '--direct-io',
+        '--mmap-threshold=1',
+        '--verify',
         '--threads=1',
         '--shred-never-wait',
         '--shred-always-wait',